@@ -45,7 +45,7 @@ static void fsemu_alsaaudio_handle_underrun(void)
     if (fsemu_audio_log_buffer_stats() <= 1) {
         // We ran out of data for realz (probably), so add some silence to
         // the buffer to aid in recovery.
-        fsemu_audiobuffer.add_silence = 1;
+        __atomic_store_n(&fsemu_audiobuffer.add_silence, 1, __ATOMIC_RELEASE);
 
         // FIXME: Get definitive information about underrun from ALSA ?
         fsemu_audio_register_underrun();
@@ -107,17 +107,20 @@ static void fsemu_alsaaudio_callback(snd_pcm_sframes_t want_frames)
         // int want = fsemu_audio_frequency() * 50 / 1000 * 4;
         int want = 8192;
         // int want = 0;
-        fsemu_audiobuffer.read = fsemu_audiobuffer.write - want;
-        if (fsemu_audiobuffer.read < fsemu_audiobuffer.data) {
-            fsemu_audiobuffer.read += fsemu_audiobuffer.size;
+        uint8_t volatile *reset = fsemu_audiobuffer_write_acquire() - want;
+        if (reset < fsemu_audiobuffer.data) {
+            reset += fsemu_audiobuffer.size;
         }
+        fsemu_audiobuffer_publish_read(reset);
     }
     // -----------------------------------------------------------------------
 
     int err;
 
+    // The read pointer is owned by this thread, the write pointer is
+    // published by the emulation thread after the data it covers.
     uint8_t volatile *read = fsemu_audiobuffer.read;
-    uint8_t volatile *write = fsemu_audiobuffer.write;
+    uint8_t volatile *write = fsemu_audiobuffer_write_acquire();
 
     int bytes = 0;
     int bytes_written = 0;
@@ -170,7 +173,9 @@ static void fsemu_alsaaudio_callback(snd_pcm_sframes_t want_frames)
         buffered_bytes, now, (void *) read, (void *) write);
 
     last_time = now;
-    fsemu_audiobuffer.read = read;
+    fsemu_audiobuffer_publish_read(read);
+
+    fsemu_audio_update_min_fill(read, write);
 }
 
 static void *fsemu_alsaaudio_thread(void *data)
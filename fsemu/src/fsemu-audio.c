@@ -34,7 +34,10 @@ static struct {
     uintptr_t sent_read;
     uintptr_t sent_write;
     int underruns;
+    int overruns;
     int64_t latency_us;
+    uint32_t fill_histogram[FSEMU_AUDIO_FILL_HISTOGRAM_BINS];
+    int fill_histogram_samples;
     fsemu_audio_frame_stats_t stats[FSEMU_AUDIO_MAX_FRAME_STATS];
 } fsemu_audio;
 
@@ -80,6 +83,10 @@ static void fsemu_audio_init_driver(void)
     // const char *driver = fsemu_config_string("audio_driver");
     // const char *driver = "sdl";
     const char *driver = fsemu_option_const_string(FSEMU_OPTION_AUDIO_DRIVER);
+    if (!driver && fsemu_option_enabled(FSEMU_OPTION_BENCHMARK)) {
+        // Headless benchmark mode, do not open an audio device.
+        driver = "null";
+    }
     if (driver) {
         fsemu_audio_log_info("Want audio driver: %s\n", driver);
     }
@@ -187,10 +194,12 @@ static void fsemu_audio_update_stats(void)
     uintptr_t sent_write = fsemu_audio.sent_write;
     int underruns = fsemu_audio.underruns;
     fsemu_audio.underruns = 0;
+    int overruns = fsemu_audio.overruns;
+    fsemu_audio.overruns = 0;
     fsemu_audio_unlock();
 
     // uint8_t volatile *read = fsemu_audiobuffer.read;
-    uint8_t volatile *write = fsemu_audiobuffer.write;
+    uint8_t volatile *write = fsemu_audiobuffer_write_acquire();
 
     intptr_t buffer_fill;
     if (sent_write >= sent_read) {
@@ -240,6 +249,7 @@ static void fsemu_audio_update_stats(void)
     stats->inflight_bytes = inflight;
     stats->dt = dt;
     stats->underruns = underruns;
+    stats->overruns = overruns;
 
     if (frequency) {
         fsemu_audio.latency_us = (int64_t) total / 4 * 1000000LL / frequency;
@@ -344,6 +354,43 @@ void fsemu_audio_register_underrun(void)
     fsemu_audio_unlock();
 }
 
+void fsemu_audio_register_overrun(void)
+{
+    fsemu_audio_lock();
+    fsemu_audio.overruns += 1;
+    fsemu_audio_unlock();
+}
+
+// Only the audio thread updates the histogram (via
+// fsemu_audio_update_min_fill); readers may see a slightly torn copy, which
+// is fine for display purposes.
+static void fsemu_audio_update_fill_histogram(int bytes)
+{
+    if (fsemu_audio.frequency == 0) {
+        return;
+    }
+    int bin = fsemu_audio_bytes_to_ms(bytes);
+    if (bin >= FSEMU_AUDIO_FILL_HISTOGRAM_BINS) {
+        bin = FSEMU_AUDIO_FILL_HISTOGRAM_BINS - 1;
+    }
+    fsemu_audio.fill_histogram[bin] += 1;
+    // Halve all bins every 1024 callbacks (roughly every ten seconds with
+    // 512-frame callbacks at 48 kHz) so old behavior fades out.
+    if (++fsemu_audio.fill_histogram_samples == 1024) {
+        for (int i = 0; i < FSEMU_AUDIO_FILL_HISTOGRAM_BINS; i++) {
+            fsemu_audio.fill_histogram[i] /= 2;
+        }
+        fsemu_audio.fill_histogram_samples = 0;
+    }
+}
+
+void fsemu_audio_fill_histogram(uint32_t *bins)
+{
+    memcpy(bins,
+           fsemu_audio.fill_histogram,
+           sizeof(fsemu_audio.fill_histogram));
+}
+
 void fsemu_audio_update_min_fill(uint8_t volatile *read,
                                  uint8_t volatile *write)
 {
@@ -362,6 +409,8 @@ void fsemu_audio_update_min_fill(uint8_t volatile *read,
     if (existing_min == 0 || existing_min > bytes) {
         fsemu_audio.stats[frame].min_buffer_bytes = bytes;
     }
+
+    fsemu_audio_update_fill_histogram(bytes);
 }
 
 bool fsemu_audio_muted(void)
@@ -20,6 +20,7 @@ typedef struct {
     int inflight_bytes;
     int dt;
     int underruns;
+    int overruns;
     int avg_latency_us;
     int min_buffer_bytes;
 } fsemu_audio_frame_stats_t;
@@ -74,6 +75,14 @@ int fsemu_audio_bytes_to_ms(int bytes);
 int64_t fsemu_audio_bytes_to_us(int bytes);
 
 void fsemu_audio_register_underrun(void);
+void fsemu_audio_register_overrun(void);
+
+// Histogram of the audio buffer fill level as seen by the audio callback,
+// with one bin per millisecond. The last bin also counts everything above.
+// Older samples decay over time, so this reflects the last few seconds.
+#define FSEMU_AUDIO_FILL_HISTOGRAM_BINS 64
+
+void fsemu_audio_fill_histogram(uint32_t *bins);
 
 #ifdef FSEMU_INTERNAL
 
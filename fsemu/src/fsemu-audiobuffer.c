@@ -10,6 +10,10 @@
 #include <samplerate.h>
 #endif
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #ifndef MIN
 #define MIN(a, b) (((a) < (b)) ? (a) : (b))
 #endif
@@ -63,19 +67,13 @@ void fsemu_audiobuffer_init(void)
 
 void fsemu_audiobuffer_clear(void)
 {
-#if 1
-    for (int i = 0; i < fsemu_audiobuffer.size; i++) {
-        fsemu_audiobuffer.data[i] = 0;
-    }
-#else
     memset((void *) fsemu_audiobuffer.data, 0, fsemu_audiobuffer.size);
-#endif
 }
 
 int fsemu_audiobuffer_fill(void)
 {
-    uint8_t volatile *read = fsemu_audiobuffer.read;
-    uint8_t volatile *write = fsemu_audiobuffer.write;
+    uint8_t volatile *read = fsemu_audiobuffer_read_acquire();
+    uint8_t volatile *write = fsemu_audiobuffer_write_acquire();
     if (write >= read) {
         return write - read;
     }
@@ -125,6 +123,129 @@ static void fsemu_audiobuffer_update_2(const void *data, int size)
 }
 #endif
 
+// ----------------------------------------------------------------------------
+// Sample conversion
+// ----------------------------------------------------------------------------
+
+#ifdef FSEMU_SAMPLERATE
+
+static void fsemu_audiobuffer_s16_to_float(const int16_t *src,
+                                           float *dst,
+                                           int count)
+{
+    int i = 0;
+#ifdef __SSE2__
+    const __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (src + i));
+        // Sign-extend by placing each sample in the upper half and shifting.
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+#endif
+    for (; i < count; i++) {
+        dst[i] = src[i] * (1.0f / 32768.0f);
+    }
+}
+
+static void fsemu_audiobuffer_float_to_s16(const float *src,
+                                           int16_t *dst,
+                                           int count)
+{
+    int i = 0;
+#ifdef __SSE2__
+    const __m128 scale = _mm_set1_ps(32767.0f);
+    const __m128 min = _mm_set1_ps(-32768.0f);
+    const __m128 max = _mm_set1_ps(32767.0f);
+    for (; i + 8 <= count; i += 8) {
+        __m128 a = _mm_mul_ps(_mm_loadu_ps(src + i), scale);
+        __m128 b = _mm_mul_ps(_mm_loadu_ps(src + i + 4), scale);
+        a = _mm_min_ps(_mm_max_ps(a, min), max);
+        b = _mm_min_ps(_mm_max_ps(b, min), max);
+        _mm_storeu_si128(
+            (__m128i *) (dst + i),
+            _mm_packs_epi32(_mm_cvttps_epi32(a), _mm_cvttps_epi32(b)));
+    }
+#endif
+    for (; i < count; i++) {
+        float value = src[i] * 32767.0f;
+        value = MAX(-32768.0f, MIN(32767.0f, value));
+        dst[i] = (int16_t) value;
+    }
+}
+
+#endif  // FSEMU_SAMPLERATE
+
+// ----------------------------------------------------------------------------
+// Producer side
+// ----------------------------------------------------------------------------
+
+// Returns how many of the size bytes can be written without overtaking the
+// consumer. One stereo frame is always left free, so that read == write
+// unambiguously means that the buffer is empty.
+static int fsemu_audiobuffer_reserve(uint8_t volatile *write, int size)
+{
+    uint8_t volatile *read = fsemu_audiobuffer_read_acquire();
+    int fill;
+    if (write >= read) {
+        fill = write - read;
+    } else {
+        fill = fsemu_audiobuffer.size - (read - write);
+    }
+    int available = fsemu_audiobuffer.size - fill - 4;
+    if (size > available) {
+        // Counted once, in the audio stats shown by the performance GUI.
+        fsemu_audio_register_overrun();
+        size = available > 0 ? available & ~3 : 0;
+    }
+    return size;
+}
+
+static void fsemu_audiobuffer_write(const uint8_t *data, int size)
+{
+    uint8_t volatile *write = fsemu_audiobuffer.write;
+    size = fsemu_audiobuffer_reserve(write, size);
+
+    ptrdiff_t available = fsemu_audiobuffer.end - write;
+    if (available < size) {
+        memcpy((void *) write, data, available);
+        write = fsemu_audiobuffer.data;
+        data += available;
+        size -= available;
+    }
+    if (size) {
+        memcpy((void *) write, data, size);
+        write += size;
+    }
+    fsemu_audiobuffer_publish_write(write);
+}
+
+#ifdef FSEMU_SAMPLERATE
+
+static void fsemu_audiobuffer_write_float(const float *data, int samples)
+{
+    uint8_t volatile *write = fsemu_audiobuffer.write;
+    int size = fsemu_audiobuffer_reserve(write, samples * 2);
+
+    ptrdiff_t available = fsemu_audiobuffer.end - write;
+    if (available < size) {
+        fsemu_audiobuffer_float_to_s16(
+            data, (int16_t *) write, available / 2);
+        write = fsemu_audiobuffer.data;
+        data += available / 2;
+        size -= available;
+    }
+    if (size) {
+        fsemu_audiobuffer_float_to_s16(data, (int16_t *) write, size / 2);
+        write += size;
+    }
+    fsemu_audiobuffer_publish_write(write);
+}
+
+#endif  // FSEMU_SAMPLERATE
+
 void fsemu_audiobuffer_update(const void *void_data, int size)
 {
     // Casting to char pointer to be able to do byte pointer arithmetic.
@@ -132,30 +253,20 @@ void fsemu_audiobuffer_update(const void *void_data, int size)
 
     fsemu_audiobuffer_extra.bytes_for_frame += size;
 
-    int add_silence = fsemu_audiobuffer.add_silence;
+    int add_silence = __atomic_exchange_n(
+        &fsemu_audiobuffer.add_silence, 0, __ATOMIC_ACQ_REL);
     if (add_silence) {
-        fsemu_audiobuffer.add_silence = 0;
         fsemu_audiobuffer_write_silence_ms(add_silence);
     }
 
 #ifdef FSEMU_SAMPLERATE
     bool use_samplerate = true;
     if (use_samplerate) {
-        // ptrdiff_t available = fsemu_audiobuffer.end -
-        // fsemu_audiobuffer.write;
-
         int samples = size / 2;
         int frames = samples / 2;
-        // int16_t *intdata = data;
-        // int16_t *intdata_p = intdata;
-        float *floatdata = fsemu_audiobuffer_extra.src_in;
-        // float *floatdata_p = floatdata;
-        /*
-        for (int i = 0; i < samples; i++) {
-            *floatdata_p = *intdata_p / 32
-        }
-        */
-        src_short_to_float_array((const short *) data, floatdata, samples);
+        fsemu_audiobuffer_s16_to_float((const int16_t *) data,
+                                       fsemu_audiobuffer_extra.src_in,
+                                       samples);
 
         SRC_DATA src_data;
         // data_in       : A pointer to the input data samples.
@@ -174,68 +285,13 @@ void fsemu_audiobuffer_update(const void *void_data, int size)
 
         src_process(fsemu_audiobuffer_extra.src_state, &src_data);
 
-        int size_out = src_data.output_frames_gen * 4;
-        // float *floatdata_p = fsemu_audiobuffer_extra.src_out;
-        floatdata = fsemu_audiobuffer_extra.src_out;
-
-        ptrdiff_t available = fsemu_audiobuffer.end - fsemu_audiobuffer.write;
-        if (available < size_out) {
-#if 1
-            for (int i = 0; i < available / 2; i++) {
-                int16_t value = (int16_t)(floatdata[i] * 32767);
-                fsemu_audiobuffer.write[i * 2] = value & 0xff;
-                fsemu_audiobuffer.write[i * 2 + 1] = (value >> 8) & 0xff;
-            }
-#else
-            src_float_to_short_array(
-                floatdata, (short *) fsemu_audiobuffer.write, available / 2);
-#endif
-            fsemu_audiobuffer.write = fsemu_audiobuffer.data;
-            data += available;
-            size_out -= available;
-
-            floatdata += available / 2;
-        }
-        if (size_out) {
-#if 1
-            for (int i = 0; i < size_out / 2; i++) {
-                int16_t value = (int16_t)(floatdata[i] * 32767);
-                fsemu_audiobuffer.write[i * 2] = value & 0xff;
-                fsemu_audiobuffer.write[i * 2 + 1] = (value >> 8) & 0xff;
-            }
-#else
-            src_float_to_short_array(
-                floatdata, (short *) fsemu_audiobuffer.write, size_out / 2);
-#endif
-            fsemu_audiobuffer.write += size_out;
-        }
+        fsemu_audiobuffer_write_float(fsemu_audiobuffer_extra.src_out,
+                                      src_data.output_frames_gen * 2);
         return;
     }
 #endif
 
-    ptrdiff_t available = fsemu_audiobuffer.end - fsemu_audiobuffer.write;
-    if (available < size) {
-#if 1
-        for (int i = 0; i < available; i++) {
-            fsemu_audiobuffer.write[i] = data[i];
-        }
-#else
-        memcpy((void *) fsemu_audiobuffer.write, data, available);
-#endif
-        fsemu_audiobuffer.write = fsemu_audiobuffer.data;
-        data += available;
-        size -= available;
-    }
-    if (size) {
-#if 1
-        for (int i = 0; i < size; i++) {
-            fsemu_audiobuffer.write[i] = data[i];
-        }
-#else
-        memcpy((void *) fsemu_audiobuffer.write, data, size);
-#endif
-        fsemu_audiobuffer.write += size;
-    }
+    fsemu_audiobuffer_write(data, size);
 }
 
 void fsemu_audiobuffer_frame_done(void)
@@ -261,7 +317,7 @@ void fsemu_audiobuffer_write_silence(int size)
     static uint8_t data[512];  // silence
     while (size) {
         int chunk = MIN(size, 512);
-        fsemu_audiobuffer_update(data, size);
+        fsemu_audiobuffer_write(data, chunk);
         size = size - chunk;
     }
 }
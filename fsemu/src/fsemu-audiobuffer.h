@@ -40,18 +40,53 @@ extern volatile uint8_t *volatile fsemu_audiobuffer.read;
 extern volatile uint8_t *volatile fsemu_audiobuffer.write;
 */
 
+// The ring buffer is a single-producer / single-consumer queue. The
+// emulation thread owns write (via fsemu_audiobuffer_update) and the audio
+// driver callback owns read. Each side publishes its own pointer with release
+// semantics and loads the other side's pointer with acquire semantics, so the
+// sample data is always visible before the pointer that covers it. The two
+// pointers are kept on separate cache lines to avoid false sharing between
+// the threads.
+
+#define FSEMU_AUDIOBUFFER_CACHE_LINE 64
+
 typedef struct {
     volatile uint8_t *data;
     int size;
     uint8_t volatile *end;
-    uint8_t volatile *volatile read;
-    uint8_t volatile *volatile write;
-    int volatile underrun;
+    uint8_t volatile *volatile read
+        __attribute__((aligned(FSEMU_AUDIOBUFFER_CACHE_LINE)));
+    uint8_t volatile *volatile write
+        __attribute__((aligned(FSEMU_AUDIOBUFFER_CACHE_LINE)));
+    int volatile underrun
+        __attribute__((aligned(FSEMU_AUDIOBUFFER_CACHE_LINE)));
     int volatile add_silence;
 } fsemu_audiobuffer_t;
 
 extern fsemu_audiobuffer_t fsemu_audiobuffer;
 
+static inline uint8_t volatile *fsemu_audiobuffer_read_acquire(void)
+{
+    return __atomic_load_n(&fsemu_audiobuffer.read, __ATOMIC_ACQUIRE);
+}
+
+static inline uint8_t volatile *fsemu_audiobuffer_write_acquire(void)
+{
+    return __atomic_load_n(&fsemu_audiobuffer.write, __ATOMIC_ACQUIRE);
+}
+
+// Called from the consumer (audio thread) only.
+static inline void fsemu_audiobuffer_publish_read(uint8_t volatile *read)
+{
+    __atomic_store_n(&fsemu_audiobuffer.read, read, __ATOMIC_RELEASE);
+}
+
+// Called from the producer (emulation thread) only.
+static inline void fsemu_audiobuffer_publish_write(uint8_t volatile *write)
+{
+    __atomic_store_n(&fsemu_audiobuffer.write, write, __ATOMIC_RELEASE);
+}
+
 #ifdef __cplusplus
 }
 #endif
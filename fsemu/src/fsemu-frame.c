@@ -5,6 +5,7 @@
 #include "fsemu-audio.h"
 #include "fsemu-control.h"
 #include "fsemu-frameinfo.h"
+#include "fsemu-glib.h"
 #include "fsemu-hud.h"
 #include "fsemu-input.h"
 #include "fsemu-module.h"
@@ -47,8 +48,25 @@ static struct {
 
     double frame_rate_multiplier;
     bool busy_wait;
+
+    // Headless benchmark mode, see fsemu_frame_benchmark_report.
+    bool benchmark;
+    char *benchmark_report;
+    int64_t benchmark_started_at;
+    fsemu_frame_checksum_function_t checksum_function;
 } fsemu_frame;
 
+// Totals for all frames, used for the benchmark report.
+static struct {
+    int64_t emu;
+    int64_t extra;
+    int64_t gui;
+    int64_t overshoot;
+    int64_t render;
+    int64_t sleep;
+    int64_t wait;
+} fsemu_frame_totals;
+
 double fsemu_frame_hz = 0;
 
 // FIXME: Main thread thing? remove?
@@ -119,7 +137,60 @@ bool fsemu_frame_warping(void)
 {
     fsemu_thread_assert_emu();
 
-    return fsemu_frame.warping;
+    // Benchmark mode always runs as fast as possible.
+    return fsemu_frame.warping || fsemu_frame.benchmark;
+}
+
+void fsemu_frame_set_checksum_function(
+    fsemu_frame_checksum_function_t function)
+{
+    fsemu_frame.checksum_function = function;
+}
+
+static void fsemu_frame_benchmark_report(int frames)
+{
+    int64_t wall_us = fsemu_time_us() - fsemu_frame.benchmark_started_at;
+    if (wall_us <= 0) {
+        wall_us = 1;
+    }
+    int checksum = 0;
+    if (fsemu_frame.checksum_function) {
+        checksum = fsemu_frame.checksum_function();
+    }
+
+    const char *path = fsemu_frame.benchmark_report;
+    FILE *f = stdout;
+    if (path) {
+        f = g_fopen(path, "wb");
+        if (f == NULL) {
+            fsemu_frame_log("Could not open %s for writing\n", path);
+            f = stdout;
+        }
+    }
+    // Times are in microseconds. Audio mixing is done as part of the
+    // emulation, so it is included in emulation_us.
+    fprintf(f, "{\n");
+    fprintf(f, "  \"frames\": %d,\n", frames);
+    fprintf(f, "  \"wall_us\": %lld,\n", lld(wall_us));
+    fprintf(f,
+            "  \"fps\": %0.2f,\n",
+            (double) frames * 1000000.0 / (double) wall_us);
+    fprintf(f, "  \"emulation_us\": %lld,\n", lld(fsemu_frame_totals.emu));
+    fprintf(f, "  \"render_us\": %lld,\n", lld(fsemu_frame_totals.render));
+    fprintf(f, "  \"gui_us\": %lld,\n", lld(fsemu_frame_totals.gui));
+    fprintf(f, "  \"extra_us\": %lld,\n", lld(fsemu_frame_totals.extra));
+    fprintf(f, "  \"sleep_us\": %lld,\n", lld(fsemu_frame_totals.sleep));
+    fprintf(f, "  \"wait_us\": %lld,\n", lld(fsemu_frame_totals.wait));
+    fprintf(f,
+            "  \"overshoot_us\": %lld,\n",
+            lld(fsemu_frame_totals.overshoot));
+    fprintf(f, "  \"checksum\": \"%08x\"\n", (unsigned int) checksum);
+    fprintf(f, "}\n");
+    if (f == stdout) {
+        fflush(f);
+    } else {
+        fclose(f);
+    }
 }
 
 int64_t fsemu_frame_epoch(void)
@@ -170,7 +241,9 @@ void fsemu_frame_end(void)
     fsemu_assert(fsemu_frame.initialized);
 
     int64_t now = fsemu_time_us();
-    if (now > fsemu_frame_end_at + 1000) {
+    if (fsemu_frame_warping()) {
+        // The frame end time is not meaningful when not pacing frames.
+    } else if (now > fsemu_frame_end_at + 1000) {
         printf(
             "fsemu_frame_end called %d ms too late "
             "(now=%lld, fsemu_frame_end_at=%lld)\n",
@@ -246,6 +319,14 @@ void fsemu_frame_end(void)
     static int64_t emu_us_total;
     emu_us_total += fsemu_frame_emu_duration;
 
+    fsemu_frame_totals.emu += fsemu_frame_emu_duration;
+    fsemu_frame_totals.extra += fsemu_frame_extra_duration;
+    fsemu_frame_totals.gui += fsemu_frame_gui_duration;
+    fsemu_frame_totals.overshoot += fsemu_frame_overshoot_duration;
+    fsemu_frame_totals.render += fsemu_frame_render_duration;
+    fsemu_frame_totals.sleep += fsemu_frame_sleep_duration;
+    fsemu_frame_totals.wait += fsemu_frame_wait_duration;
+
     static int64_t emu_us_avg_sum;
     static int emu_us_avg_count;
     static int emu_us_avg_max;
@@ -277,6 +358,9 @@ void fsemu_frame_end(void)
             (double) emu_us_total / 1000000.0,
             1000000.0 / ((double) emu_us_avg_sum / emu_us_avg_count),
             1000000.0 / (double) emu_us_avg_max);
+        if (fsemu_frame.benchmark) {
+            fsemu_frame_benchmark_report(fsemu_frame.counter);
+        }
         fsemu_quit_maybe();
     }
 
@@ -1257,6 +1341,21 @@ void fsemu_frame_init(void)
     fsemu_frame.quit_after_n_frames =
         fsemu_option_int_default(FSEMU_OPTION_QUIT_AFTER_N_FRAMES, -1);
 
+    fsemu_frame.benchmark = fsemu_option_enabled(FSEMU_OPTION_BENCHMARK);
+    if (fsemu_frame.benchmark) {
+        if (fsemu_frame.quit_after_n_frames <= 0) {
+            fsemu_frame.quit_after_n_frames = 1000;
+        }
+        fsemu_frame_log("Benchmark mode, running %d frames\n",
+                        fsemu_frame.quit_after_n_frames);
+        const char *report =
+            fsemu_option_const_string(FSEMU_OPTION_BENCHMARK_REPORT);
+        if (report) {
+            fsemu_frame.benchmark_report = strdup(report);
+        }
+        fsemu_frame.benchmark_started_at = fsemu_time_us();
+    }
+
     fsemu_frame.load_state = -1;
     fsemu_frame.save_state = -1;
 
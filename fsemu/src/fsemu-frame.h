@@ -74,6 +74,13 @@ void fsemu_frame_add_render_time(int64_t t);
 void fsemu_frame_add_sleep_time(int64_t t);
 void fsemu_frame_add_extra_time(int64_t t);
 
+typedef int (*fsemu_frame_checksum_function_t)(void);
+
+// Used in benchmark mode to include a final emulation state checksum in the
+// report. Called from the emulation thread.
+void fsemu_frame_set_checksum_function(
+    fsemu_frame_checksum_function_t function);
+
 extern double fsemu_frame_hz;
 // extern bool fsemu_frame_warp;
 
@@ -28,6 +28,10 @@
 
 #define FSEMU_GLVIDEO_N_TEXTURES 1
 
+// Texture height, see the (FIXME) tw/th constants used when uploading.
+#define FSEMU_GLVIDEO_MAX_ROWS 1024
+#define FSEMU_GLVIDEO_ALL_TEXTURES ((1 << FSEMU_GLVIDEO_N_TEXTURES) - 1)
+
 // ----------------------------------------------------------------------------
 
 static struct {
@@ -59,6 +63,20 @@ static struct {
     // vsync (alternating red and green should give a yellow-ish line).
     uint8_t *red_line;
     uint8_t *green_line;
+
+    // One bit per texture for each texture row, set when the texture row
+    // does not contain the current frame buffer row and must be uploaded.
+    // Only meaningful while stale_valid is true; a change of source buffer,
+    // frame type (RTG or chipset), depth or geometry, a frame drop or a
+    // frame without dirty row information invalidates it.
+    uint8_t stale_rows[FSEMU_GLVIDEO_MAX_ROWS];
+    bool stale_valid;
+    uint8_t *stale_buffer;
+    int stale_rtg;
+    int stale_depth;
+    fsemu_rect_t stale_limits;
+    int stale_stride;
+    int stale_frame_number;
 #ifdef VSYNCTHREAD
     fsemu_mutex_t *swap_mutex;
 #endif
@@ -94,6 +112,50 @@ void fsemu_glvideo_set_size_2(int width, int height)
     fsemu_video_set_drawable_size(&fsemu_glvideo.drawable_size);
 }
 
+// Must be called before the frame buffer and size are adjusted to the limits,
+// since dirty_rows is indexed by (full) frame buffer row.
+
+static void fsemu_glvideo_update_stale_rows(fsemu_video_frame_t *frame)
+{
+    // Rows can only be skipped if the textures were updated from the same
+    // buffer and kind of frame with the same geometry, and no frame was
+    // dropped in between (partial slices of a frame share the same frame
+    // number).
+    int rtg = frame->flags & FSEMU_FRAME_FLAG_RTG;
+    bool valid = fsemu_glvideo.stale_valid && frame->dirty_rows &&
+                 frame->buffer == fsemu_glvideo.stale_buffer &&
+                 rtg == fsemu_glvideo.stale_rtg &&
+                 frame->depth == fsemu_glvideo.stale_depth &&
+                 frame->stride == fsemu_glvideo.stale_stride &&
+                 frame->limits.x == fsemu_glvideo.stale_limits.x &&
+                 frame->limits.y == fsemu_glvideo.stale_limits.y &&
+                 frame->limits.w == fsemu_glvideo.stale_limits.w &&
+                 frame->limits.h == fsemu_glvideo.stale_limits.h &&
+                 (frame->number == fsemu_glvideo.stale_frame_number ||
+                  frame->number == fsemu_glvideo.stale_frame_number + 1);
+    if (!valid) {
+        memset(fsemu_glvideo.stale_rows,
+               FSEMU_GLVIDEO_ALL_TEXTURES,
+               sizeof(fsemu_glvideo.stale_rows));
+    } else {
+        int rows = MIN(frame->limits.h, frame->height - frame->limits.y);
+        rows = MIN(rows, FSEMU_GLVIDEO_MAX_ROWS);
+        const uint8_t *dirty = frame->dirty_rows + frame->limits.y;
+        for (int y = 0; y < rows; y++) {
+            if (dirty[y]) {
+                fsemu_glvideo.stale_rows[y] = FSEMU_GLVIDEO_ALL_TEXTURES;
+            }
+        }
+    }
+    fsemu_glvideo.stale_valid = true;
+    fsemu_glvideo.stale_buffer = frame->buffer;
+    fsemu_glvideo.stale_rtg = rtg;
+    fsemu_glvideo.stale_depth = frame->depth;
+    fsemu_glvideo.stale_limits = frame->limits;
+    fsemu_glvideo.stale_stride = frame->stride;
+    fsemu_glvideo.stale_frame_number = frame->number;
+}
+
 static void fsemu_glvideo_handle_frame(fsemu_video_frame_t *frame)
 {
     if (frame->dummy) {
@@ -124,6 +186,8 @@ static void fsemu_glvideo_handle_frame(fsemu_video_frame_t *frame)
 
     );
 #endif
+    fsemu_glvideo_update_stale_rows(frame);
+
     // FIXME: 4
     if (frame->partial) {
         // Need to check frame->height before modifying it
@@ -224,38 +288,54 @@ static void fsemu_glvideo_handle_frame(fsemu_video_frame_t *frame)
 
     // printf("b x=%d y=%d size=%dx%d\n", rect.x, rect.y, rect.w, rect.h);
 
-    glTexSubImage2D(GL_TEXTURE_2D,
-                    0,
-                    rect.x,
-                    rect.y,
-                    rect.w,
-                    rect.h,
-                    fsemu_glvideo.format,
-                    fsemu_glvideo.type,
-                    pixels);
-    // FIXME: fsemu_opengl_log_error_maybe();
-    fsemu_opengl_log_error_maybe();
+    // Upload only runs of rows which this texture does not already have. For
+    // a static screen this is typically nothing at all.
+    int bit = 1 << n;
+    int end = rect.y + rect.h;
+    for (int y1 = rect.y; y1 < end;) {
+        if (y1 < FSEMU_GLVIDEO_MAX_ROWS &&
+            !(fsemu_glvideo.stale_rows[y1] & bit)) {
+            y1++;
+            continue;
+        }
+        int y2 = y1;
+        while (y2 < end && (y2 >= FSEMU_GLVIDEO_MAX_ROWS ||
+                            (fsemu_glvideo.stale_rows[y2] & bit))) {
+            if (y2 < FSEMU_GLVIDEO_MAX_ROWS) {
+                fsemu_glvideo.stale_rows[y2] &= ~bit;
+            }
+            y2++;
+        }
+        uint8_t *run = pixels + (y1 - rect.y) * frame->stride;
 
-    // Duplicate right (and later, bottom) edge to remove bleed effect from
-    // unused pixels in the texture when doing bilinear filtering.
-    if (fsemu_glvideo.fix_bleed && rect.w < tw) {
-        // FIXME: Wrapper call via fsemu-opengl ?
-        // fsemu_opengl_unpack_row_length(row_length);
-        // fsemu_opengl_log_error_maybe();
         glTexSubImage2D(GL_TEXTURE_2D,
                         0,
+                        rect.x,
+                        y1,
                         rect.w,
-                        rect.y,
-                        1,
-                        rect.h,
+                        y2 - y1,
                         fsemu_glvideo.format,
                         fsemu_glvideo.type,
-                        // pixels + (rect.w * 4 * rect.y) + (rect.w - 1) * 4);
-                        pixels + (rect.w - 1) * fsemu_glvideo.bpp);
+                        run);
+        // FIXME: fsemu_opengl_log_error_maybe();
         fsemu_opengl_log_error_maybe();
-        // FIXME: Remove
-        // fsemu_opengl_unpack_row_length(0);
-        // fsemu_opengl_log_error_maybe();
+
+        // Duplicate right (and later, bottom) edge to remove bleed effect
+        // from unused pixels in the texture when doing bilinear filtering.
+        if (fsemu_glvideo.fix_bleed && rect.w < tw) {
+            // FIXME: Wrapper call via fsemu-opengl ?
+            glTexSubImage2D(GL_TEXTURE_2D,
+                            0,
+                            rect.w,
+                            y1,
+                            1,
+                            y2 - y1,
+                            fsemu_glvideo.format,
+                            fsemu_glvideo.type,
+                            run + (rect.w - 1) * fsemu_glvideo.bpp);
+            fsemu_opengl_log_error_maybe();
+        }
+        y1 = y2;
     }
 
     if (fsemu_perfgui_mode() == 2) {
@@ -272,6 +352,10 @@ static void fsemu_glvideo_handle_frame(fsemu_video_frame_t *frame)
                         fsemu_glvideo.type,
                         slice_line);
         fsemu_opengl_log_error_maybe();
+        // The slice marker overwrote a row of the texture.
+        if (rect.y < FSEMU_GLVIDEO_MAX_ROWS) {
+            fsemu_glvideo.stale_rows[rect.y] = FSEMU_GLVIDEO_ALL_TEXTURES;
+        }
     }
 
     if (frame->partial > 0 && frame->partial != frame->height) {
@@ -7,6 +7,9 @@
 #define FSEMU_OPTION_AUDIO_DRIVER "audio_driver"
 #define FSEMU_OPTION_AUTOMATIC_INPUT_GRAB "automatic_input_grab"
 
+#define FSEMU_OPTION_BENCHMARK "benchmark"
+#define FSEMU_OPTION_BENCHMARK_REPORT "benchmark_report"
+
 #define FSEMU_OPTION_BUSY_WAIT "busy_wait"
 
 #define FSEMU_OPTION_FULLSCREEN "fullscreen"
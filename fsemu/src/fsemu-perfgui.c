@@ -8,6 +8,7 @@
 #include <stdint.h>
 
 #include "fsemu-audio.h"
+#include "fsemu-audiobuffer.h"
 #include "fsemu-frame.h"
 #include "fsemu-frameinfo.h"
 #include "fsemu-gui.h"
@@ -22,6 +23,10 @@
 // should be left transparent (or black) to avoid color bleed when drawing
 // these halves to the screen as textures with LINEAR filtering.
 
+// The bottom rows of the audio half show a histogram of the audio buffer fill
+// level instead of the scrolling graph.
+#define FSEMU_PERFGUI_HISTOGRAM_HEIGHT 32
+
 // ----------------------------------------------------------------------------
 
 int fsemu_perfgui_log_level = FSEMU_LOG_LEVEL_INFO;
@@ -424,6 +429,12 @@ static void fsemu_perfgui_update_audio(int frame)
             ((uint32_t *) row)[-2] = FSEMU_RGB(0xff0000);
             ((uint32_t *) row)[-3] = FSEMU_RGB(0xff0000);
         }
+        if (stats.overruns) {
+            ((uint32_t *) row)[-123] = FSEMU_RGB(0xffaa00);
+            ((uint32_t *) row)[-124] = FSEMU_RGB(0xffaa00);
+            ((uint32_t *) row)[-125] = FSEMU_RGB(0xffaa00);
+            ((uint32_t *) row)[-126] = FSEMU_RGB(0xffaa00);
+        }
 
         // Blank pixel at the end of the line
         ((uint32_t *) row)[-127] = FSEMU_RGBA(0x00000000);
@@ -461,6 +472,63 @@ static void fsemu_perfgui_update_audio(int frame)
 #endif
 }
 
+// Draws the audio buffer fill level histogram over the bottom rows of the
+// audio half, using the same horizontal scale as the latency graph above it.
+static void fsemu_perfgui_update_audio_histogram(void)
+{
+    if (fsemu_audio_frequency() == 0) {
+        return;
+    }
+    uint32_t bins[FSEMU_AUDIO_FILL_HISTOGRAM_BINS];
+    fsemu_audio_fill_histogram(bins);
+
+    uint32_t max_count = 0;
+    for (int i = 0; i < FSEMU_AUDIO_FILL_HISTOGRAM_BINS; i++) {
+        if (bins[i] > max_count) {
+            max_count = bins[i];
+        }
+    }
+
+    int target_us = fsemu_audiobuffer_calculate_target();
+    int scale = 2 * target_us / 1000;
+    if (scale == 0) {
+        scale = 40;
+    }
+    int target = target_us * 128 / (scale * 1000);
+
+    int heights[128];
+    for (int x = 0; x < 128; x++) {
+        int bin = x * scale / 128;
+        if (bin >= FSEMU_AUDIO_FILL_HISTOGRAM_BINS) {
+            bin = FSEMU_AUDIO_FILL_HISTOGRAM_BINS - 1;
+        }
+        heights[x] = max_count ? (int) ((uint64_t) bins[bin] *
+                                        FSEMU_PERFGUI_HISTOGRAM_HEIGHT /
+                                        max_count)
+                               : 0;
+    }
+
+    for (int i = 0; i < FSEMU_PERFGUI_HISTOGRAM_HEIGHT; i++) {
+        int y = FSEMU_PERFGUI_IMAGE_HEIGHT - 1 - i;
+        uint8_t *row =
+            fsemu_perfgui.image.data + y * fsemu_perfgui.image.stride;
+        row += (FSEMU_PERFGUI_IMAGE_WIDTH - 1) * fsemu_perfgui.image.bpp;
+        for (int x = 0; x < 128; x++) {
+            if (i < heights[x]) {
+                ((uint32_t *) row)[-x] = fsemu_perfgui.colors.audio_avg;
+            } else if (x == target) {
+                ((uint32_t *) row)[-x] = fsemu_perfgui.colors.audio_target;
+            } else if (i == FSEMU_PERFGUI_HISTOGRAM_HEIGHT - 1) {
+                ((uint32_t *) row)[-x] = fsemu_perfgui.colors.line;
+            } else {
+                ((uint32_t *) row)[-x] = fsemu_perfgui.colors.audio_bg;
+            }
+        }
+        // Blank pixel at the end of the line
+        ((uint32_t *) row)[-127] = FSEMU_RGBA(0x00000000);
+    }
+}
+
 static void fsemu_perfgui_update_video(int frame)
 {
     fsemu_frameinfo_t *frameinfo = &FSEMU_FRAMEINFO(frame);
@@ -665,6 +733,7 @@ void fsemu_perfgui_update_image(void)
         f += 1;
     }
     next_frame = frame;
+    fsemu_perfgui_update_audio_histogram();
 #if 0
 #if 0
     static int next_frame;
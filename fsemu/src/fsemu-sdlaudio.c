@@ -194,15 +194,18 @@ void fsemu_sdlaudio_callback(void *data, Uint8 *stream, int want_bytes)
         // int want = fsemu_audio_frequency() * 50 / 1000 * 4;
         int want = 8192;
         // int want = 0;
-        fsemu_audiobuffer.read = fsemu_audiobuffer.write - want;
-        if (fsemu_audiobuffer.read < fsemu_audiobuffer.data) {
-            fsemu_audiobuffer.read += fsemu_audiobuffer.size;
+        uint8_t volatile *reset = fsemu_audiobuffer_write_acquire() - want;
+        if (reset < fsemu_audiobuffer.data) {
+            reset += fsemu_audiobuffer.size;
         }
+        fsemu_audiobuffer_publish_read(reset);
     }
     // -----------------------------------------------------------------------
 
+    // The read pointer is owned by this thread, the write pointer is
+    // published by the emulation thread after the data it covers.
     uint8_t volatile *read = fsemu_audiobuffer.read;
-    uint8_t volatile *write = fsemu_audiobuffer.write;
+    uint8_t volatile *write = fsemu_audiobuffer_write_acquire();
 
     int bytes = 0;
     int bytes_written = 0;
@@ -222,13 +225,7 @@ void fsemu_sdlaudio_callback(void *data, Uint8 *stream, int want_bytes)
 
     // int error = fsemu_audio_alsa_write((void *) read, bytes);
     // FIXME: Check for underrun
-#if 1
-    for (int i = 0; i < bytes; i++) {
-        stream[i] = read[i];
-    }
-#else
     memcpy(stream, (void *) read, bytes);
-#endif
     stream += bytes;
 
     want_bytes -= bytes;
@@ -245,13 +242,7 @@ void fsemu_sdlaudio_callback(void *data, Uint8 *stream, int want_bytes)
             }
             // error = fsemu_audio_alsa_write((void *) read, bytes);
             // FIXME: Check for underrun
-#if 1
-            for (int i = 0; i < bytes; i++) {
-                stream[i] = read[i];
-            }
-#else
             memcpy(stream, (void *) read, bytes);
-#endif
             stream += bytes;
 
             want_bytes -= bytes;
@@ -265,7 +256,7 @@ void fsemu_sdlaudio_callback(void *data, Uint8 *stream, int want_bytes)
         memset(stream, 0, want_bytes);
         // FIXME: Re-enable with log level
         // fsemu_audio_log("%d bytes short of refilling SDL :(\n", want_bytes);
-        fsemu_audiobuffer.add_silence = 1;
+        __atomic_store_n(&fsemu_audiobuffer.add_silence, 1, __ATOMIC_RELEASE);
     }
 #endif
 
@@ -276,7 +267,7 @@ void fsemu_sdlaudio_callback(void *data, Uint8 *stream, int want_bytes)
         buffered_bytes, now, (uintptr_t) read, (uintptr_t) write);
 
     last_time = now;
-    fsemu_audiobuffer.read = read;
+    fsemu_audiobuffer_publish_read(read);
 
     if (bytes_written != wanted_bytes) {
         // FIXME: Re-enable with log level
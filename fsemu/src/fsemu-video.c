@@ -780,6 +780,14 @@ fsemu_video_driver_t fsemu_video_driver(void)
 void fsemu_video_decide_driver(void)
 {
     const char *driver = fsemu_option_const_string(FSEMU_OPTION_VIDEO_DRIVER);
+    if (fsemu_option_enabled(FSEMU_OPTION_BENCHMARK)) {
+        // Headless benchmark mode, no window and no waiting for vsync.
+        if (!driver) {
+            driver = "null";
+        }
+        fsemu_video.vsync = 0;
+        fsemu_video.disallow_vsync = 1;
+    }
     if (driver) {
         fsemu_video_log("Want video driver: %s\n", driver);
     }
@@ -37,6 +37,10 @@ typedef struct fsemu_video_frame_t {
     int number;
     // No actual frame data, used in pause mode
     bool dummy;
+    // Optional, one byte per buffer row (height entries). Non-zero means the
+    // row has changed since the previously posted frame. When NULL, all rows
+    // are assumed to have changed. Owned by the client, free it in finalize.
+    uint8_t *dirty_rows;
 
     void (*finalize)(struct fsemu_video_frame_t *frame);
     void *finalize_data;
@@ -44,6 +48,8 @@ typedef struct fsemu_video_frame_t {
 
 // FIXME: Move to fsemu-frame?
 #define FSEMU_FRAME_FLAG_TURBO (1 << 0)
+// Frame comes from the RTG frame buffer rather than the chipset one
+#define FSEMU_FRAME_FLAG_RTG (1 << 1)
 
 typedef enum {
     FSEMU_VIDEO_DRIVER_NULL,
@@ -204,6 +204,14 @@ typedef int (*fs_emu_checksum_function)(void);
 void fs_emu_set_state_check_function(fs_emu_checksum_function function);
 void fs_emu_set_rand_check_function(fs_emu_checksum_function function);
 
+// Used by rollback netplay. The save function is called at the start of a
+// frame (before the frame's input events are applied) and must make a
+// snapshot tagged with frame available before the frame runs. The load
+// function returns 0 if no snapshot for frame is available.
+typedef int (*fs_emu_rollback_function)(int frame);
+void fs_emu_set_netplay_rollback_functions(fs_emu_rollback_function save,
+        fs_emu_rollback_function load, int max_frames);
+
 // high level and generic functions
 
 void fs_emu_msleep(int msec);
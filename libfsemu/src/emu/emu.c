@@ -560,7 +560,11 @@ int fs_emu_wait_for_frame(int frame)
         return wait_for_frame_no_netplay();
 #ifdef WITH_NETPLAY
     }
-    return fs_emu_netplay_wait_for_frame(frame);
+    int result = fs_emu_netplay_wait_for_frame(frame);
+    if (result == FS_EMU_NETPLAY_THROTTLE) {
+        return wait_for_frame_no_netplay();
+    }
+    return result;
 #endif
 }
 
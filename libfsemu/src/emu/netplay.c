@@ -14,6 +14,9 @@
 char *g_fs_emu_netplay_server = 0;
 static fs_emu_checksum_function g_rand_checksum_function = 0;
 static fs_emu_checksum_function g_state_checksum_function = 0;
+static fs_emu_rollback_function g_rollback_save_function = 0;
+static fs_emu_rollback_function g_rollback_load_function = 0;
+static int g_rollback_max_frames = 0;
 
 int fs_emu_netplay_enabled() {
     return g_fs_emu_netplay_server != 0;
@@ -27,6 +30,13 @@ void fs_emu_set_state_check_function(fs_emu_checksum_function function) {
     g_state_checksum_function = function;
 }
 
+void fs_emu_set_netplay_rollback_functions(fs_emu_rollback_function save,
+        fs_emu_rollback_function load, int max_frames) {
+    g_rollback_save_function = save;
+    g_rollback_load_function = load;
+    g_rollback_max_frames = max_frames;
+}
+
 #ifdef WITH_NETPLAY
 
 #ifdef WINDOWS
@@ -137,6 +147,64 @@ static GQueue* g_input_event_queue;
 
 static fs_emu_dialog* g_waiting_dialog = NULL;
 
+/* Rollback mode. Instead of waiting for the server to confirm each frame
+ * before running it, the emulation may run up to g_rollback_frames frames
+ * ahead of the last confirmed frame, predicting that no input events happen
+ * in unconfirmed frames. When the server confirms input for a frame which
+ * was simulated with a wrong prediction, the emulator restores the snapshot
+ * taken at the start of that frame and the frames are simulated again with
+ * the confirmed input. Local input events are still only applied when
+ * echoed back from the server, and checksums and frame acks are only sent
+ * for frames known to have been simulated exactly as in lockstep mode, so
+ * the wire protocol is unchanged. */
+
+#define ROLLBACK_HISTORY 128
+#define ROLLBACK_MAX_EVENTS 256
+
+typedef struct rollback_frame {
+    int frame;
+    int confirmed;
+    // simulated before the input was confirmed (assuming no events)
+    int predicted;
+    // simulated with the confirmed input
+    int correct;
+    // checksums of the state at the start of the frame
+    int checks_valid;
+    int rnd_check;
+    int mem_check;
+    int num_events;
+    int events[ROLLBACK_MAX_EVENTS];
+} rollback_frame;
+
+static int g_rollback_frames = 0;
+static rollback_frame g_rollback_history[ROLLBACK_HISTORY];
+static int g_rollback_events[ROLLBACK_MAX_EVENTS];
+static int g_rollback_num_events = 0;
+// next frame to simulate, in netplay frame numbers (the emulator's own frame
+// counter keeps increasing when frames are simulated again)
+static int g_rollback_next_frame = 1;
+static int g_rollback_confirmed_frame = 0;
+static int g_rollback_acked_frame = 0;
+static int g_rollback_resim_until = 0;
+static int64_t g_rollback_resim_start = 0;
+
+static struct {
+    int rollbacks;
+    int max_depth;
+    int predicted_frames;
+    int resim_frames;
+    int64_t resim_time;
+} g_rollback_stats;
+
+static void rollback_log_stats(void) {
+    fs_log("netplay: rollback stats at frame %d: %d rollbacks (max depth "
+            "%d), %d frames predicted, %d frames simulated again in %d ms\n",
+            g_rollback_next_frame, g_rollback_stats.rollbacks,
+            g_rollback_stats.max_depth, g_rollback_stats.predicted_frames,
+            g_rollback_stats.resim_frames,
+            (int) (g_rollback_stats.resim_time / 1000));
+}
+
 static void show_waiting_dialog() {
     fs_emu_acquire_gui_lock();
     if (g_waiting_dialog) {
@@ -228,6 +296,12 @@ void fse_init_netplay() {
         g_checksum_free(cs);
     }
 
+    // The emulator limit (savestate_rollback_max_frames) is 31, matching
+    // the documented option range; it is also enforced when connecting.
+    g_rollback_frames = fs_config_get_int_clamped("netplay_rollback", 0, 31);
+    if (g_rollback_frames == FS_CONFIG_NONE) {
+        g_rollback_frames = 0;
+    }
 }
 
 static int fs_emu_get_netplay_input_event() {
@@ -270,6 +344,9 @@ static void fs_emu_netplay_on_disconnect() {
         return;
     }
     fs_emu_log("fs_emu_netplay_on_disconnect - disconnecting\n");
+    if (g_rollback_frames) {
+        rollback_log_stats();
+    }
     // FIXME: free socket
     // FIXME: reconnect or let the player continue without net play
     // FIXME: show onscreen connecting dialog with abort button...
@@ -368,44 +445,13 @@ int fs_emu_netplay_send_input_event(int input_event) {
     return 1;
 }
 
-int fs_emu_netplay_wait_for_frame(int frame) {
-
-    //printf("fs_emu_netplay_wait_for_frame %d\n", frame);
-    /*
-    while (1) {
-        fs_ml_usleep(100 * 1000);
-        if (fs_emu_is_quitting()) {
-            fs_log("fs_emu_netplay_wait_for_frame: quitting\n");
-            return 0;
-        }
-    }
-    */
-
-    if (!g_fs_emu_throttling) {
-        static int warned = 0;
-        if (!warned) {
-            fs_emu_warning("Netplay is not compatible with throttling "
-                    "disabled");
-            warned = 1;
-        }
-    }
-
+/* Waits until the server has sent (at least) the given frame. Returns 0 if
+ * the emulator is quitting or net play was disabled while waiting. */
+static int wait_for_server_frame(int frame) {
     fs_mutex_lock(g_wait_for_frame_mutex);
     while (g_frame < frame) {
-        //fs_time_val abs_time;
         // wait max 100 ms for a new frame, to allow the loop to end if the
         // emu is quitting
-
-        /*
-        g_get_current_time(&abs_time);
-        g_time_val_add(&abs_time, 100 * 1000);
-        g_cond_timed_wait(g_wait_for_frame_cond, g_wait_for_frame_mutex,
-                &abs_time);
-        */
-
-        //fs_get_current_time(&abs_time);
-        //fs_time_val_add(&abs_time, 100 * 1000);
-        // int64_t abs_time = fs_get_real_time() + 100 * 1000;
         int64_t end_time = fs_condition_get_wait_end_time(100 * 1000);
 
         // FIXME: check for spurious wakeup
@@ -434,6 +480,214 @@ int fs_emu_netplay_wait_for_frame(int frame) {
         }
     }
     fs_mutex_unlock(g_wait_for_frame_mutex);
+    return 1;
+}
+
+static rollback_frame *rollback_history_frame(int frame) {
+    rollback_frame *f = g_rollback_history + frame % ROLLBACK_HISTORY;
+    if (f->frame != frame) {
+        memset(f, 0, sizeof(rollback_frame));
+        f->frame = frame;
+    }
+    return f;
+}
+
+/* Moves complete input groups from the netplay input queue into the frame
+ * history, without blocking. Returns the first newly confirmed frame which
+ * was simulated with a wrong prediction, or 0. */
+static int rollback_collect_confirmed(void) {
+    int mispredicted = 0;
+    // history slots are reused, so do not let confirmed frames get too far
+    // ahead of the emulation
+    while (g_rollback_confirmed_frame <
+            g_rollback_next_frame + ROLLBACK_HISTORY / 2) {
+        int input_event = fs_emu_get_netplay_input_event();
+        if (input_event == 0) {
+            break;
+        }
+        if ((input_event & 0x80000000) == 0) {
+            if (g_rollback_num_events == ROLLBACK_MAX_EVENTS) {
+                fs_emu_warning("Too many input events in one frame for "
+                        "rollback net play");
+                fs_emu_netplay_disconnect();
+                return 0;
+            }
+            g_rollback_events[g_rollback_num_events++] = input_event;
+            continue;
+        }
+        int frame = input_event & 0x7fffffff;
+        if (frame != g_rollback_confirmed_frame + 1) {
+            // should not happen..
+            fs_log("ERROR: synchronization error (frame %d != sentinel %d)\n",
+                    g_rollback_confirmed_frame + 1, frame);
+            exit(1);
+        }
+        rollback_frame *f = rollback_history_frame(frame);
+        f->confirmed = 1;
+        f->num_events = g_rollback_num_events;
+        memcpy(f->events, g_rollback_events,
+                g_rollback_num_events * sizeof(int));
+        g_rollback_num_events = 0;
+        g_rollback_confirmed_frame = frame;
+        if (f->predicted) {
+            if (f->num_events == 0) {
+                f->correct = 1;
+            } else if (!mispredicted) {
+                mispredicted = frame;
+            }
+        }
+    }
+    return mispredicted;
+}
+
+/* Forgets simulation results for frames from first_frame up to (but not
+ * including) end_frame. The checksums for first_frame are kept, since the
+ * state at the start of that frame was correct. */
+static void rollback_invalidate(int first_frame, int end_frame) {
+    for (int frame = first_frame; frame < end_frame; frame++) {
+        rollback_frame *f = g_rollback_history + frame % ROLLBACK_HISTORY;
+        if (f->frame != frame) {
+            continue;
+        }
+        f->predicted = 0;
+        f->correct = 0;
+        if (frame != first_frame) {
+            f->checks_valid = 0;
+        }
+    }
+}
+
+/* Sends checksums and frame acks, in order, for confirmed frames whose
+ * start state is known to be identical to lockstep emulation. */
+static void rollback_send_acks(void) {
+    while (g_rollback_acked_frame < g_rollback_confirmed_frame) {
+        int frame = g_rollback_acked_frame + 1;
+        rollback_frame *f = g_rollback_history + frame % ROLLBACK_HISTORY;
+        if (f->frame != frame || !f->checks_valid) {
+            break;
+        }
+        if (frame > 1) {
+            rollback_frame *p = g_rollback_history +
+                    (frame - 1) % ROLLBACK_HISTORY;
+            if (p->frame != frame - 1 || !p->correct) {
+                break;
+            }
+        }
+        send_message(MESSAGE_RNDCHECK | f->rnd_check);
+        send_message(MESSAGE_MEMCHECK | f->mem_check);
+        send_message(MESSAGE_FRAME_MASK | frame);
+        g_rollback_acked_frame = frame;
+    }
+}
+
+static int rollback_wait_for_frame(int frame) {
+    static int initialized = 0;
+    if (!initialized) {
+        initialized = 1;
+        if (g_rollback_frames > g_rollback_max_frames) {
+            fs_log("netplay: rollback limited to %d frames\n",
+                    g_rollback_max_frames);
+            g_rollback_frames = g_rollback_max_frames;
+        }
+        fs_log("netplay: rollback mode, up to %d frames\n",
+                g_rollback_frames);
+    }
+
+    int s = g_rollback_next_frame;
+    rollback_frame *f = rollback_history_frame(s);
+    f->rnd_check = g_rand_checksum_function() & 0x00ffffff;
+    f->mem_check = g_state_checksum_function() & 0x00ffffff;
+    f->checks_valid = 1;
+
+    int wait_for = s - g_rollback_frames;
+    if (!wait_for_server_frame(wait_for < 1 ? 1 : wait_for)) {
+        return 0;
+    }
+    if (frame == 1) {
+        dismiss_waiting_dialog();
+    }
+
+    int mispredicted = rollback_collect_confirmed();
+    if (!fs_emu_netplay_enabled()) {
+        return 0;
+    }
+    if (mispredicted) {
+        if (!g_rollback_load_function(mispredicted)) {
+            fs_emu_warning("Net play rollback to frame %d failed",
+                    mispredicted);
+            fs_emu_netplay_disconnect();
+            return 0;
+        }
+        rollback_invalidate(mispredicted, s);
+        g_rollback_stats.rollbacks += 1;
+        if (s - mispredicted > g_rollback_stats.max_depth) {
+            g_rollback_stats.max_depth = s - mispredicted;
+        }
+        if (g_rollback_resim_until == 0) {
+            g_rollback_resim_start = fs_emu_monotonic_time();
+        }
+        if (s > g_rollback_resim_until) {
+            g_rollback_resim_until = s;
+        }
+        s = mispredicted;
+        f = rollback_history_frame(s);
+    } else {
+        g_rollback_save_function(s);
+    }
+
+    if (f->confirmed) {
+        for (int i = 0; i < f->num_events; i++) {
+            fs_emu_queue_input_event_internal(f->events[i]);
+        }
+        f->correct = 1;
+    } else {
+        f->predicted = 1;
+        g_rollback_stats.predicted_frames += 1;
+    }
+    rollback_send_acks();
+    g_rollback_next_frame = s + 1;
+
+    if (g_rollback_resim_until) {
+        if (s < g_rollback_resim_until) {
+            // simulating frames again, run as fast as possible
+            g_rollback_stats.resim_frames += 1;
+            return 1;
+        }
+        g_rollback_stats.resim_time +=
+                fs_emu_monotonic_time() - g_rollback_resim_start;
+        g_rollback_resim_until = 0;
+    }
+    if (s % 3000 == 0) {
+        rollback_log_stats();
+    }
+    if (s < g_frame) {
+        // behind the server, catch up without throttling
+        return 1;
+    }
+    return FS_EMU_NETPLAY_THROTTLE;
+}
+
+int fs_emu_netplay_wait_for_frame(int frame) {
+
+    //printf("fs_emu_netplay_wait_for_frame %d\n", frame);
+
+    if (!g_fs_emu_throttling) {
+        static int warned = 0;
+        if (!warned) {
+            fs_emu_warning("Netplay is not compatible with throttling "
+                    "disabled");
+            warned = 1;
+        }
+    }
+
+    if (g_rollback_frames > 0 && g_rollback_save_function &&
+            g_rollback_load_function) {
+        return rollback_wait_for_frame(frame);
+    }
+
+    if (!wait_for_server_frame(frame)) {
+        return 0;
+    }
 
     if (frame == 1) {
         dismiss_waiting_dialog();
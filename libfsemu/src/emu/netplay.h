@@ -7,6 +7,10 @@ int fs_emu_netplay_connect();
 void fs_emu_netplay_start();
 int fs_emu_netplay_send_input_event(int input_event);
 void fse_init_netplay();
+// Returned from fs_emu_netplay_wait_for_frame when running ahead of the
+// server in rollback mode; the caller must then pace the emulation itself.
+#define FS_EMU_NETPLAY_THROTTLE 2
+
 int fs_emu_netplay_wait_for_frame(int frame);
 
 #endif // LIBFSEMU_NETPLAY_H_
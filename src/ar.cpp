@@ -619,6 +619,7 @@ void REGPARAM2 chipmem_lput_actionreplay1 (uaecptr addr, uae_u32 l)
 		action_replay_chipwrite ();
 	m = (uae_u32 *)(chipmem_bank.baseaddr + addr);
 	do_put_mem_long (m, l);
+	MEMORY_DIRTY_MARK(chipmem_bank, addr, 4);
 }
 void REGPARAM2 chipmem_wput_actionreplay1 (uaecptr addr, uae_u32 w)
 {
@@ -630,6 +631,7 @@ void REGPARAM2 chipmem_wput_actionreplay1 (uaecptr addr, uae_u32 w)
 		action_replay_chipwrite ();
 	m = (uae_u16 *)(chipmem_bank.baseaddr + addr);
 	do_put_mem_word (m, w);
+	MEMORY_DIRTY_MARK(chipmem_bank, addr, 2);
 }
 void REGPARAM2 chipmem_bput_actionreplay1 (uaecptr addr, uae_u32 b)
 {
@@ -638,6 +640,7 @@ void REGPARAM2 chipmem_bput_actionreplay1 (uaecptr addr, uae_u32 b)
 	if (addr >= 0x60 && addr <= 0x63 && !is_ar_pc_in_rom())
 		action_replay_chipwrite();
 	chipmem_bank.baseaddr[addr] = b;
+	MEMORY_DIRTY_MARK(chipmem_bank, addr, 1);
 }
 void REGPARAM2 chipmem_lput_actionreplay23 (uaecptr addr, uae_u32 l)
 {
@@ -646,6 +649,7 @@ void REGPARAM2 chipmem_lput_actionreplay23 (uaecptr addr, uae_u32 l)
 	addr &= chipmem_bank.mask;
 	m = (uae_u32 *)(chipmem_bank.baseaddr + addr);
 	do_put_mem_long (m, l);
+	MEMORY_DIRTY_MARK(chipmem_bank, addr, 4);
 	if (action_replay_flag == ACTION_REPLAY_WAITRESET)
 		action_replay_chipwrite();
 }
@@ -657,6 +661,7 @@ void REGPARAM2 chipmem_wput_actionreplay23 (uaecptr addr, uae_u32 w)
 	addr &= chipmem_bank.mask;
 	m = (uae_u16 *)(chipmem_bank.baseaddr + addr);
 	do_put_mem_word (m, w);
+	MEMORY_DIRTY_MARK(chipmem_bank, addr, 2);
 	if (action_replay_flag == ACTION_REPLAY_WAITRESET)
 		action_replay_chipwrite();
 }
@@ -80,17 +80,19 @@ STATIC_INLINE bool usehacks(void)
 
 #include "sinctable.cpp"
 
-typedef struct {
-	int time, output;
-} sinc_queue_t;
-
 struct audio_channel_data2
 {
 	int current_sample, last_sample;
 	uae_u8 new_sample;
 	int sample_accum, sample_accum_time;
 	int sinc_output_state;
-	sinc_queue_t sinc_queue[SINC_QUEUE_LENGTH];
+	/* BLEP queue, newest entry first starting at sinc_queue_head. Every
+	 * entry is stored twice (at pos and pos + SINC_QUEUE_LENGTH) so the live
+	 * entries are always contiguous, and sinc_queue_count is the number of
+	 * entries that are still younger than SINC_QUEUE_MAX_AGE. */
+	int sinc_queue_times[SINC_QUEUE_LENGTH * 2];
+	int sinc_queue_outputs[SINC_QUEUE_LENGTH * 2];
+	int sinc_queue_count;
 	int sinc_queue_time;
 	int sinc_queue_head;
 	int audvol;
@@ -579,6 +581,18 @@ static void samplexx_anti_handler (int *datasp, int ch_start, int ch_num)
 	}
 }
 
+STATIC_INLINE void sinc_queue_push (struct audio_channel_data2 *acd, int output)
+{
+	int head = (acd->sinc_queue_head - 1) & (SINC_QUEUE_LENGTH - 1);
+	int delta = output - acd->sinc_output_state;
+	acd->sinc_queue_times[head] = acd->sinc_queue_times[head + SINC_QUEUE_LENGTH] = acd->sinc_queue_time;
+	acd->sinc_queue_outputs[head] = acd->sinc_queue_outputs[head + SINC_QUEUE_LENGTH] = delta;
+	acd->sinc_queue_head = head;
+	if (acd->sinc_queue_count < SINC_QUEUE_LENGTH)
+		acd->sinc_queue_count++;
+	acd->sinc_output_state = output;
+}
+
 static void sinc_prehandler_paula (unsigned long best_evtime)
 {
 	int i, output;
@@ -591,23 +605,49 @@ static void sinc_prehandler_paula (unsigned long best_evtime)
 
 		/* if output state changes, record the state change and also
 		 * write data into sinc queue for mixing in the BLEP */
-		if (acd->sinc_output_state != output) {
-			acd->sinc_queue_head = (acd->sinc_queue_head - 1) & (SINC_QUEUE_LENGTH - 1);
-			acd->sinc_queue[acd->sinc_queue_head].time = acd->sinc_queue_time;
-			acd->sinc_queue[acd->sinc_queue_head].output = output - acd->sinc_output_state;
-			acd->sinc_output_state = output;
-		}
+		if (acd->sinc_output_state != output)
+			sinc_queue_push (acd, output);
 
 		acd->sinc_queue_time += best_evtime;
 	}
 }
 
-/* this interpolator performs BLEP mixing (bleps are shaped like integrated sinc
-* functions) with a type of BLEP that matches the filtering configuration. */
-static void samplexx_sinc_handler (int *datasp, int ch_start, int ch_num)
+/* Queue entries are pushed in time order, so their ages grow from the head
+ * towards the tail. Entries that have aged out are dropped from the tail and
+ * the remaining ones are summed in a pass over contiguous arrays with a known
+ * trip count. Integer addition is associative, so this gives exactly the same
+ * result as walking the queue and stopping at the first expired entry. */
+STATIC_INLINE int sinc_channel_sum (struct audio_channel_data2 *acd, int const *winsinc)
+{
+	/* The sum rings with harmonic components up to infinity... */
+	int sum = acd->sinc_output_state << 17;
+	const int *times = acd->sinc_queue_times + acd->sinc_queue_head;
+	const int *outputs = acd->sinc_queue_outputs + acd->sinc_queue_head;
+	int now = acd->sinc_queue_time;
+	int count = acd->sinc_queue_count;
+
+	while (count > 0 && (unsigned int)(now - times[count - 1]) >= SINC_QUEUE_MAX_AGE)
+		count--;
+	acd->sinc_queue_count = count;
+
+	/* ...but we cancel them through mixing in BLEPs instead. Four
+	 * independent accumulators keep the multiply-subtract chains apart. */
+	int sum1 = 0, sum2 = 0, sum3 = 0;
+	int j = 0;
+	for (; j + 4 <= count; j += 4) {
+		sum -= winsinc[now - times[j]] * outputs[j];
+		sum1 -= winsinc[now - times[j + 1]] * outputs[j + 1];
+		sum2 -= winsinc[now - times[j + 2]] * outputs[j + 2];
+		sum3 -= winsinc[now - times[j + 3]] * outputs[j + 3];
+	}
+	for (; j < count; j++)
+		sum -= winsinc[now - times[j]] * outputs[j];
+	return sum + sum1 + sum2 + sum3;
+}
+
+STATIC_INLINE int const *sinc_select_table (int ch_start)
 {
-	int n, i, k;
-	int const *winsinc;
+	int n;
 
 	if (sound_use_filter_sinc && ch_start == 0) {
 		n = (sound_use_filter_sinc == FILTER_MODEL_A500) ? 0 : 2;
@@ -616,30 +656,106 @@ static void samplexx_sinc_handler (int *datasp, int ch_start, int ch_num)
 	} else {
 		n = 4;
 	}
-	winsinc = winsinc_integral[n];
+	return winsinc_integral[n];
+}
 
+/* this interpolator performs BLEP mixing (bleps are shaped like integrated sinc
+* functions) with a type of BLEP that matches the filtering configuration. */
+static void samplexx_sinc_handler (int *datasp, int ch_start, int ch_num)
+{
+	int i, k;
+	int const *winsinc = sinc_select_table (ch_start);
 
 	for (i = ch_start, k = 0; k < ch_num; i++, k++) {
-		int j, v;
-		struct audio_channel_data2 *acd = audio_data[i];
-		/* The sum rings with harmonic components up to infinity... */
-		int sum = acd->sinc_output_state << 17;
-		/* ...but we cancel them through mixing in BLEPs instead */
-		int offsetpos = acd->sinc_queue_head & (SINC_QUEUE_LENGTH - 1);
-		for (j = 0; j < SINC_QUEUE_LENGTH; j += 1) {
-			int age = acd->sinc_queue_time - acd->sinc_queue[offsetpos].time;
-			if (age >= SINC_QUEUE_MAX_AGE || age < 0)
-				break;
-			sum -= winsinc[age] * acd->sinc_queue[offsetpos].output;
-			offsetpos = (offsetpos + 1) & (SINC_QUEUE_LENGTH - 1);
-		}
-		v = sum >> 15;
+		int v = sinc_channel_sum (audio_data[i], winsinc) >> 15;
 		if (v > 32767)
 			v = 32767;
 		else if (v < -32768)
 			v = -32768;
 		datasp[k] = v;
-    }
+	}
+}
+
+/* The original per-sample queue walk, kept as the reference for
+ * audio_sinc_benchmark(). */
+static int sinc_channel_sum_reference (const struct audio_channel_data2 *acd, int const *winsinc)
+{
+	int sum = acd->sinc_output_state << 17;
+	int offsetpos = acd->sinc_queue_head & (SINC_QUEUE_LENGTH - 1);
+	for (int j = 0; j < SINC_QUEUE_LENGTH; j += 1) {
+		int age = acd->sinc_queue_time - acd->sinc_queue_times[offsetpos];
+		if (age >= SINC_QUEUE_MAX_AGE || age < 0)
+			break;
+		sum -= winsinc[age] * acd->sinc_queue_outputs[offsetpos];
+		offsetpos = (offsetpos + 1) & (SINC_QUEUE_LENGTH - 1);
+	}
+	return sum;
+}
+
+/* Set FS_DEBUG_AUDIO_BENCHMARK=1 to run a synthetic four channel Paula mix
+   through the sinc interpolator when sound is opened. It compares the output
+   of the current and the reference BLEP summation sample by sample and logs
+   the time spent per output sample for both. */
+void audio_sinc_benchmark(void)
+{
+	const int samples = 1 << 18;
+	/* about 3.55 MHz / 48 kHz Paula cycles between output samples */
+	const int cycles_per_sample = 74;
+	const int periods[AUDIO_CHANNELS_PAULA] = { 124, 161, 253, 428 };
+	struct audio_channel_data2 *acd = xcalloc(struct audio_channel_data2, AUDIO_CHANNELS_PAULA);
+	uae_s8 *levels = xmalloc(uae_s8, samples * AUDIO_CHANNELS_PAULA);
+	int const *winsinc = winsinc_integral[0];
+	int mismatches = 0;
+	uae_u32 seed = 0x1234567;
+	double times_us[2];
+
+	/* one level per channel and output sample, changing at the channel period */
+	for (int i = 0; i < AUDIO_CHANNELS_PAULA; i++) {
+		int level = 0, next = 0;
+		for (int j = 0; j < samples; j++) {
+			if (j * cycles_per_sample >= next) {
+				seed = seed * 1103515245 + 12345;
+				level = (uae_s8)(seed >> 16);
+				next += periods[i];
+			}
+			levels[j * AUDIO_CHANNELS_PAULA + i] = level;
+		}
+	}
+
+	for (int pass = 0; pass < 3; pass++) {
+		int check = 0;
+		memset(acd, 0, sizeof(struct audio_channel_data2) * AUDIO_CHANNELS_PAULA);
+		frame_time_t t = read_processor_time();
+		for (int j = 0; j < samples; j++) {
+			for (int i = 0; i < AUDIO_CHANNELS_PAULA; i++) {
+				struct audio_channel_data2 *c = &acd[i];
+				int output = levels[j * AUDIO_CHANNELS_PAULA + i] * 64;
+				if (c->sinc_output_state != output)
+					sinc_queue_push (c, output);
+				c->sinc_queue_time += cycles_per_sample;
+				if (pass == 2) {
+					int ref = sinc_channel_sum_reference (c, winsinc);
+					if (sinc_channel_sum (c, winsinc) != ref)
+						mismatches++;
+				} else if (pass == 1) {
+					check += sinc_channel_sum_reference (c, winsinc) >> 15;
+				} else {
+					check += sinc_channel_sum (c, winsinc) >> 15;
+				}
+			}
+		}
+		if (pass < 2) {
+			times_us[pass] = (read_processor_time() - t) * 1000000.0 / syncbase;
+			write_log(_T("AUDIO: sinc %s: %d samples, %.1f ns/sample (check %08x)\n"),
+				pass == 0 ? _T("current") : _T("reference"), samples,
+				times_us[pass] * 1000.0 / samples, check);
+		}
+	}
+	write_log(_T("AUDIO: sinc speedup %.2fx, %d mismatches\n"),
+		times_us[0] > 0 ? times_us[1] / times_us[0] : 0.0, mismatches);
+
+	xfree(levels);
+	xfree(acd);
 }
 
 static void do_filter(int *data, int num)
@@ -68,7 +68,6 @@ static int blitter_slowdowndebug;
 
 struct bltinfo blt_info;
 
-static uae_u8 blit_filltable[256][4][2];
 uae_u32 blit_masktable[BLITTER_MAX_WORDS];
 enum blitter_states bltstate;
 
@@ -261,32 +260,63 @@ static const int *set_cycle_diagram_type (uae_u8 diag)
 	return NULL;
 }
 
+#ifdef BLITTER_SIMD
+static blitter_simd_func * const *blitfunc_simd;
+static blitter_simd_func * const *blitfunc_simd_desc;
+
+static void blitter_simd_init (void)
+{
+	const char *s = NULL;
+	const char *name = _T("SSE2");
+
+#ifdef FSUAE
+	s = getenv ("FS_DEBUG_BLITTER_SIMD");
+#endif
+	blitfunc_simd = NULL;
+	blitfunc_simd_desc = NULL;
+	if (s && s[0] == '0') {
+		write_log (_T("BLITTER: SIMD line kernels disabled\n"));
+		return;
+	}
+	blitfunc_simd = blitfunc_simd_sse2;
+	blitfunc_simd_desc = blitfunc_simd_sse2_desc;
+#ifdef BLITTER_SIMD_AVX2
+	if (!(s && !strcmp (s, "sse2")) && __builtin_cpu_supports ("avx2")) {
+		blitfunc_simd = blitfunc_simd_avx2;
+		blitfunc_simd_desc = blitfunc_simd_avx2_desc;
+		name = _T("AVX2");
+	}
+#endif
+	write_log (_T("BLITTER: using %s line kernels\n"), name);
+}
+#endif
+
 void build_blitfilltable (void)
 {
-	unsigned int d, fillmask;
 	int i;
 
 	for (i = 0; i < BLITTER_MAX_WORDS; i++)
 		blit_masktable[i] = 0xFFFF;
+#ifdef BLITTER_SIMD
+	blitter_simd_init ();
+#endif
+}
 
-	for (d = 0; d < 256; d++) {
-		for (i = 0; i < 4; i++) {
-			int fc = i & 1;
-			uae_u8 data = d;
-			for (fillmask = 1; fillmask != 0x100; fillmask <<= 1) {
-				uae_u16 tmp = data;
-				if (fc) {
-					if (i & 2)
-						data |= fillmask;
-					else
-						data ^= fillmask;
-				}
-				if (tmp & fillmask) fc = !fc;
-			}
-			blit_filltable[d][i][0] = data;
-			blit_filltable[d][i][1] = fc;
-		}
-	}
+/* Area fill of one word, bit 0 first. The fill carry before each bit is the
+   incoming carry xor the parity of all lower bits, which is a prefix xor of
+   the word shifted left by one. Bit 16 ends up as the outgoing carry. */
+STATIC_INLINE uae_u16 blitter_fill_word (uae_u16 d, int ife, int *fc)
+{
+	uae_u32 m = (uae_u32)d << 1;
+
+	m ^= m << 1;
+	m ^= m << 2;
+	m ^= m << 4;
+	m ^= m << 8;
+	if (*fc)
+		m = ~m;
+	*fc = (m >> 16) & 1;
+	return ife ? (d | m) : (d ^ m);
 }
 
 STATIC_INLINE void record_dma_blit (uae_u16 reg, uae_u16 dat, uae_u32 addr, int hpos)
@@ -504,6 +534,166 @@ STATIC_INLINE void chipmem_agnus_wput2 (uaecptr addr, uae_u32 w)
 	}
 }
 
+#ifdef BLITTER_SIMD
+
+/* Chip RAM range touched by one channel. Fails if it does not fit in chip
+   RAM without wrapping, then the word loop has to do the masking. A pointer
+   stepping through zero disables the channel there, so keep clear of it. */
+static bool blitter_simd_range (uaecptr pt, int mod, int desc, uae_s64 *lo, uae_s64 *hi)
+{
+	uae_s64 step = blt_info.hblitsize * 2 + mod;
+	uae_s64 first = pt, last;
+
+	if (pt & 1)
+		return false;
+	if (desc) {
+		last = first - step * (blt_info.vblitsize - 1);
+		*lo = (first < last ? first : last) - (blt_info.hblitsize - 1) * 2;
+		*hi = (first > last ? first : last) + 2;
+	} else {
+		last = first + step * (blt_info.vblitsize - 1);
+		*lo = first < last ? first : last;
+		*hi = (first > last ? first : last) + blt_info.hblitsize * 2;
+	}
+	return *lo >= 4 && *hi <= (uae_s64)chipmem_bank.mask + 1;
+}
+
+/* Same result as blitfunc_dofast[] but the middle words of each line go
+   through the SIMD kernel. The kernels write D directly instead of one word
+   late, so D must not overlap a source it could still be read from. */
+static bool blitter_simd_dofast (uae_u8 mt, uaecptr pta, uaecptr ptb, uaecptr ptc, uaecptr ptd, int desc)
+{
+	blitter_simd_func *func;
+	int usea = ((mt >> 4) & 0x0f) != (mt & 0x0f);
+	int useb = ((mt >> 2) & 0x33) != (mt & 0x33);
+	int usec = ((mt >> 1) & 0x55) != (mt & 0x55);
+	int n = blt_info.hblitsize;
+	int dir = desc ? -2 : 2;
+	int ash = desc ? blt_info.blitdownashift : blt_info.blitashift;
+	int bsh = desc ? blt_info.blitdownbshift : blt_info.blitbshift;
+	uae_s64 dlo = 0, dhi = 0, lo, hi;
+	uae_u8 *base = chipmem_bank.baseaddr;
+	uae_u32 adat, aold, bdat, bold, bhold, cdat, total = 0;
+	int head, i, j;
+
+	if (!blitfunc_simd)
+		return false;
+	// D writes bypass chipmem_agnus_wput2: keep the scalar path while blitter
+	// writes are disabled for logging or the debugger watches DMA writes.
+	if ((log_blitter & 4) || memwatch_enabled)
+		return false;
+	func = desc ? blitfunc_simd_desc[mt] : blitfunc_simd[mt];
+	if (!func || n < 4)
+		return false;
+	if (chipmem_wget_indirect != chipmem_agnus_wget || chipmem_wput_indirect != chipmem_agnus_wput)
+		return false;
+	if (ptd && !blitter_simd_range (ptd, blt_info.bltdmod, desc, &dlo, &dhi))
+		return false;
+	if (usea && pta) {
+		if (!blitter_simd_range (pta, blt_info.bltamod, desc, &lo, &hi))
+			return false;
+		if (ptd && lo < dhi && dlo < hi)
+			return false;
+	}
+	if (useb && ptb) {
+		if (!blitter_simd_range (ptb, blt_info.bltbmod, desc, &lo, &hi))
+			return false;
+		if (ptd && lo < dhi && dlo < hi)
+			return false;
+	}
+	if (usec && ptc) {
+		if (!blitter_simd_range (ptc, blt_info.bltcmod, desc, &lo, &hi))
+			return false;
+		/* C == D in place is fine, each C word is read before its D word is written */
+		if (ptd && lo < dhi && dlo < hi && (ptc != ptd || blt_info.bltcmod != blt_info.bltdmod || blt_info.bltdmod < 0))
+			return false;
+	}
+
+	/* The first one or two words see bltafwm, the last one sees bltalwm
+	   and leaves the hold registers in their final state. */
+	head = usea && blit_masktable[0] != 0xffff ? 2 : 1;
+	adat = blt_info.bltadat;
+	aold = blt_info.bltaold;
+	bdat = blt_info.bltbdat;
+	bold = blt_info.bltbold;
+	bhold = blt_info.bltbhold;
+	cdat = blt_info.bltcdat;
+
+	for (j = 0; j < blt_info.vblitsize; j++) {
+		uae_u8 *pa = usea && pta ? base + pta : NULL;
+		uae_u8 *pb = useb && ptb ? base + ptb : NULL;
+		uae_u8 *pc = usec && ptc ? base + ptc : NULL;
+		uae_u8 *pd = ptd ? base + ptd : NULL;
+
+		if (pd)
+			MEMORY_DIRTY_MARK (chipmem_bank, desc ? ptd - (n - 1) * 2 : ptd, n * 2);
+		for (i = 0; i < n; i++) {
+			uae_u32 srca = 0, m;
+			if (i == head && n - 1 > head) {
+				int done = func (pa ? pa + i * dir : NULL, pb ? pb + i * dir : NULL,
+					pc ? pc + i * dir : NULL, pd ? pd + i * dir : NULL, n - 1 - head, &blt_info, &total);
+				if (done) {
+					i += done;
+					if (pa)
+						aold = do_get_mem_word ((uae_u16 *)(pa + (i - 1) * dir));
+					else
+						aold = adat;
+					if (pb)
+						bold = do_get_mem_word ((uae_u16 *)(pb + (i - 1) * dir));
+				}
+			}
+			if (usea) {
+				if (pa)
+					adat = do_get_mem_word ((uae_u16 *)(pa + i * dir));
+				m = adat & blit_masktable[i];
+				if (desc)
+					srca = ((m << 16) | aold) >> ash;
+				else
+					srca = ((aold << 16) | m) >> ash;
+				aold = m;
+			}
+			if (pb) {
+				bdat = do_get_mem_word ((uae_u16 *)(pb + i * dir));
+				if (desc)
+					bhold = ((bdat << 16) | bold) >> bsh;
+				else
+					bhold = ((bold << 16) | bdat) >> bsh;
+				bold = bdat;
+			}
+			if (pc)
+				cdat = do_get_mem_word ((uae_u16 *)(pc + i * dir));
+			m = blit_func (srca, bhold, cdat, mt) & 0xFFFF;
+			total |= m;
+			if (pd)
+				do_put_mem_word ((uae_u16 *)(pd + i * dir), m);
+		}
+		if (pta)
+			pta += (n * 2 + blt_info.bltamod) * (desc ? -1 : 1);
+		if (ptb)
+			ptb += (n * 2 + blt_info.bltbmod) * (desc ? -1 : 1);
+		if (ptc)
+			ptc += (n * 2 + blt_info.bltcmod) * (desc ? -1 : 1);
+		if (ptd)
+			ptd += (n * 2 + blt_info.bltdmod) * (desc ? -1 : 1);
+	}
+
+	if (usea) {
+		blt_info.bltadat = adat;
+		blt_info.bltaold = aold;
+	}
+	if (useb) {
+		blt_info.bltbdat = bdat;
+		blt_info.bltbold = bold;
+		blt_info.bltbhold = bhold;
+	}
+	if (usec)
+		blt_info.bltcdat = cdat;
+	if (total)
+		blt_info.blitzero = 0;
+	return true;
+}
+#endif
+
 static void blitter_dofast (void)
 {
 	int i,j;
@@ -530,6 +720,11 @@ static void blitter_dofast (void)
 		bltdpt += (blt_info.hblitsize * 2 + blt_info.bltdmod) * blt_info.vblitsize;
 	}
 
+#ifdef BLITTER_SIMD
+	if (!blitfill && blitter_simd_dofast (mt, bltadatptr, bltbdatptr, bltcdatptr, bltddatptr, 0)) {
+		;
+	} else
+#endif
 #if SPEEDUP
 	if (blitfunc_dofast[mt] && !blitfill) {
 		(*blitfunc_dofast[mt])(bltadatptr, bltbdatptr, bltcdatptr, bltddatptr, &blt_info);
@@ -568,14 +763,8 @@ static void blitter_dofast (void)
 				if (dodst)
 					chipmem_agnus_wput2 (dstp, blt_info.bltddat);
 				blt_info.bltddat = blit_func (blitahold, blitbhold, blt_info.bltcdat, mt) & 0xFFFF;
-				if (blitfill) {
-					uae_u16 d = blt_info.bltddat;
-					int ifemode = blitife ? 2 : 0;
-					int fc1 = blit_filltable[d & 255][ifemode + blitfc][1];
-					blt_info.bltddat = (blit_filltable[d & 255][ifemode + blitfc][0]
-						+ (blit_filltable[d >> 8][ifemode + fc1][0] << 8));
-					blitfc = blit_filltable[d >> 8][ifemode + fc1][1];
-				}
+				if (blitfill)
+					blt_info.bltddat = blitter_fill_word (blt_info.bltddat, blitife, &blitfc);
 				if (blt_info.bltddat)
 					blt_info.blitzero = 0;
 				if (bltddatptr) {
@@ -628,6 +817,11 @@ static void blitter_dofast_desc (void)
 		bltddatptr = bltdpt;
 		bltdpt -= (blt_info.hblitsize * 2 + blt_info.bltdmod) * blt_info.vblitsize;
 	}
+#ifdef BLITTER_SIMD
+	if (!blitfill && blitter_simd_dofast (mt, bltadatptr, bltbdatptr, bltcdatptr, bltddatptr, 1)) {
+		;
+	} else
+#endif
 #if SPEEDUP
 	if (blitfunc_dofast_desc[mt] && !blitfill) {
 		(*blitfunc_dofast_desc[mt])(bltadatptr, bltbdatptr, bltcdatptr, bltddatptr, &blt_info);
@@ -666,14 +860,8 @@ static void blitter_dofast_desc (void)
 				if (dodst)
 					chipmem_agnus_wput2 (dstp, blt_info.bltddat);
 				blt_info.bltddat = blit_func (blitahold, blitbhold, blt_info.bltcdat, mt) & 0xFFFF;
-				if (blitfill) {
-					uae_u16 d = blt_info.bltddat;
-					int ifemode = blitife ? 2 : 0;
-					int fc1 = blit_filltable[d & 255][ifemode + blitfc][1];
-					blt_info.bltddat = (blit_filltable[d & 255][ifemode + blitfc][0]
-					+ (blit_filltable[d >> 8][ifemode + fc1][0] << 8));
-					blitfc = blit_filltable[d >> 8][ifemode + fc1][1];
-				}
+				if (blitfill)
+					blt_info.bltddat = blitter_fill_word (blt_info.bltddat, blitife, &blitfc);
 				if (blt_info.bltddat)
 					blt_info.blitzero = 0;
 				if (bltddatptr) {
@@ -1005,14 +1193,8 @@ STATIC_INLINE uae_u16 blitter_doblit (void)
 
 	ddat = blit_func (blitahold, blt_info.bltbhold, blt_info.bltcdat, mt) & 0xFFFF;
 
-	if ((bltcon1 & 0x18)) {
-		uae_u16 d = ddat;
-		int ifemode = blitife ? 2 : 0;
-		int fc1 = blit_filltable[d & 255][ifemode + blitfc][1];
-		ddat = (blit_filltable[d & 255][ifemode + blitfc][0]
-			+ (blit_filltable[d >> 8][ifemode + fc1][0] << 8));
-		blitfc = blit_filltable[d >> 8][ifemode + fc1][1];
-	}
+	if ((bltcon1 & 0x18))
+		ddat = blitter_fill_word (ddat, blitife, &blitfc);
 
 	if (ddat)
 		blt_info.blitzero = 0;
@@ -2278,6 +2278,7 @@ int sys_command_scsi_direct(TrapContext *ctx, int unitnum, int type, uaecptr acm
 		if (!bank || !bank->check(ap, as.len))
 			return IOERR_BADADDRESS;
 		as.data = bank->xlateaddr (ap);
+		memory_dirty_mark_addr (ap, as.len);
 	}
 
 	ap = get_long_host(scsicmd + 12);
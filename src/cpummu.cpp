@@ -77,11 +77,10 @@ struct mmufastcache atc_data_cache_read[MMUFASTCACHE_ENTRIES];
 struct mmufastcache atc_data_cache_write[MMUFASTCACHE_ENTRIES];
 #endif
 
-#if CACHE_HIT_COUNT
-int mmu_ins_hit, mmu_ins_miss;
-int mmu_data_read_hit, mmu_data_read_miss;
-int mmu_data_write_hit, mmu_data_write_miss;
-#endif
+bool mmu_cache_hit_count;
+uae_u32 mmu_ins_hit, mmu_ins_miss;
+uae_u32 mmu_data_read_hit, mmu_data_read_miss;
+uae_u32 mmu_data_write_hit, mmu_data_write_miss;
 
 static void mmu_dump_ttr(const TCHAR * label, uae_u32 ttr)
 {
@@ -324,7 +323,22 @@ static void mmu_dump_table(const char * label, uaecptr root_ptr)
 /* {{{ mmu_dump_atc */
 static void mmu_dump_atc(void)
 {
+	if (!mmu_cache_hit_count) {
+		console_out_f(_T("ATC shortcut cache (%d entries), \"mmud c\" enables hit counting\n"), MMUFASTCACHE_ENTRIES);
+		return;
+	}
+	console_out_f(_T("ATC shortcut cache (%d entries, since last dump):\n"), MMUFASTCACHE_ENTRIES);
+	console_out_f(_T("  INS:   %10u hits %10u misses\n"), mmu_ins_hit, mmu_ins_miss);
+	console_out_f(_T("  READ:  %10u hits %10u misses\n"), mmu_data_read_hit, mmu_data_read_miss);
+	console_out_f(_T("  WRITE: %10u hits %10u misses\n"), mmu_data_write_hit, mmu_data_write_miss);
+	mmu_cache_hit_count_reset();
+}
 
+void mmu_cache_hit_count_reset(void)
+{
+	mmu_ins_hit = mmu_ins_miss = 0;
+	mmu_data_read_hit = mmu_data_read_miss = 0;
+	mmu_data_write_hit = mmu_data_write_miss = 0;
 }
 /* }}} */
 
@@ -355,13 +369,13 @@ static void flush_shortcut_cache(uaecptr addr, bool super)
 		memset(&atc_data_cache_read, 0xff, sizeof atc_data_cache_read);
 		memset(&atc_data_cache_write, 0xff, sizeof atc_data_cache_write);
 	} else {
-		for (int i = 0; i < MMUFASTCACHE_ENTRIES; i++) {
-			uae_u32 idx = ((addr & mmu_pagemaski) >> mmu_pageshift1m) | (super ? 1 : 0);
-			if (atc_data_cache_read[i].log == idx)
-				atc_data_cache_read[i].log = 0xffffffff;
-			if (atc_data_cache_write[i].log == idx)
-				atc_data_cache_write[i].log = 0xffffffff;
-		}
+		// direct mapped: the page can only live in its own slot
+		uae_u32 idx1 = ((addr & mmu_pagemaski) >> mmu_pageshift1m) | (super ? 1 : 0);
+		uae_u32 idx2 = idx1 & (MMUFASTCACHE_ENTRIES - 1);
+		if (atc_data_cache_read[idx2].log == idx1)
+			atc_data_cache_read[idx2].log = 0xffffffff;
+		if (atc_data_cache_write[idx2].log == idx1)
+			atc_data_cache_write[idx2].log = 0xffffffff;
 	}
 #endif
 }
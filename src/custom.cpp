@@ -646,7 +646,7 @@ static void docols (struct color_entry *colentry)
 #endif
 }
 
-extern struct color_entry colors_for_drawing;
+extern thread_local struct color_entry colors_for_drawing;
 
 void notice_new_xcolors (void)
 {
@@ -9359,11 +9359,14 @@ static void linesync_fsemu(void)
 
 #if 1
 	bool draw_lines_done = false;
+	int64_t draw_duration = 0;
 	if (vpos % 10 == 0) {
 		draw_lines(vpos, -1);
 		draw_lines_done = true;
 
-		now = fsemu_time_us();
+		int64_t drawn_at = fsemu_time_us();
+		draw_duration = drawn_at - now;
+		now = drawn_at;
 	}
 #endif
 
@@ -9391,7 +9394,10 @@ static void linesync_fsemu(void)
 #endif
 
 	line_ended_at = now;
-	fsemu_frame_emu_duration += line_ended_at - line_started_at;
+	// Chipset line drawing is registered as render time, so emulation time
+	// is only CPU and chipset emulation.
+	fsemu_frame_emu_duration += line_ended_at - line_started_at - draw_duration;
+	fsemu_frame_render_duration += draw_duration;
 
 	if (display_slices > 0) {
 		bool render_slice = false;
@@ -236,6 +236,9 @@ static const TCHAR help[] = {
 	_T("  dj [<level bitmask>]  Enable joystick/mouse input debugging.\n")
 	_T("  smc [<0-1>]           Enable self-modifying code detector. 1 = enable break.\n")
 	_T("  dm                    Dump current address space map.\n")
+#ifdef JIT
+	_T("  dJ                    Dump JIT block profile (FS_DEBUG_JIT_PROFILE).\n")
+#endif
 	_T("  v <vpos> [<hpos>]     Show DMA data (accurate only in cycle-exact mode).\n")
 	_T("                        v [-1 to -4] = enable visual DMA debugger.\n")
 #ifdef WITH_SEGTRACKER
@@ -5803,6 +5806,10 @@ static bool debug_line (TCHAR *input)
 					console_out_f (_T("Input logging level %d\n"), inputdevice_logging);
 				} else if (*inptr == 'm') {
 					memory_map_dump_2 (0);
+#ifdef JIT
+				} else if (*inptr == 'J') {
+					compemu_profile_dump(true);
+#endif
 				} else if (*inptr == 't') {
 					next_char (&inptr);
 					debugtest_set (&inptr);
@@ -6054,8 +6061,15 @@ static bool debug_line (TCHAR *input)
 				if (*inptr == 'm' && inptr[1] == 'u') {
 					inptr += 2;
 					if (inptr[0] == 'd') {
-						if (currprefs.mmu_model >= 68040)
+						inptr++;
+						ignore_ws (&inptr);
+						if (*inptr == 'c') {
+							mmu_cache_hit_count = !mmu_cache_hit_count;
+							mmu_cache_hit_count_reset ();
+							console_out_f (_T("MMU shortcut cache hit counting %s\n"), mmu_cache_hit_count ? _T("enabled") : _T("disabled"));
+						} else if (currprefs.mmu_model >= 68040) {
 							mmu_dump_tables();
+						}
 					} else {
 						if (currprefs.mmu_model) {
 							if (more_params (&inptr))
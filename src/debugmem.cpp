@@ -776,6 +776,7 @@ void REGPARAM2 debugmem_chipmem_lput(uaecptr addr, uae_u32 l)
 		addr &= chipmem_bank.mask;
 		m = (uae_u32 *)(chipmem_bank.baseaddr + addr);
 		do_put_mem_long(m, l);
+		MEMORY_DIRTY_MARK(chipmem_bank, addr, 4);
 	}
 }
 
@@ -789,6 +790,7 @@ void REGPARAM2 debugmem_chipmem_wput(uaecptr addr, uae_u32 w)
 		addr &= chipmem_bank.mask;
 		m = (uae_u16 *)(chipmem_bank.baseaddr + addr);
 		do_put_mem_word(m, w);
+		MEMORY_DIRTY_MARK(chipmem_bank, addr, 2);
 	}
 }
 
@@ -800,6 +802,7 @@ void REGPARAM2 debugmem_chipmem_bput(uaecptr addr, uae_u32 b)
 	} else {
 		addr &= chipmem_bank.mask;
 		chipmem_bank.baseaddr[addr] = b;
+		MEMORY_DIRTY_MARK(chipmem_bank, addr, 1);
 	}
 }
 
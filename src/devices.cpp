@@ -343,11 +343,15 @@ void do_leave_program (void)
 	picasso_free();
 	free_traps();
 	sampler_free ();
+	drawing_free ();
 	graphics_leave ();
 	inputdevice_close ();
 	DISK_free ();
 	close_sound ();
 	dump_counts ();
+#ifdef JIT
+	compemu_profile_dump(false);
+#endif
 #ifdef PARALLEL_PORT
 	parallel_exit();
 #endif
@@ -29,6 +29,7 @@ int disk_debug_track = -1;
 #include "disk.h"
 #include "gui.h"
 #include "zfile.h"
+#include "threaddep/thread.h"
 #include "newcpu.h"
 #include "osemu.h"
 #include "execlib.h"
@@ -1199,6 +1200,93 @@ static void update_disk_statusline(int num)
 		statusline_add_message(STATUSTYPE_FLOPPY, _T("DF%d: %s"), num, my_getfilepart(fname));
 }
 
+/* Swapper prefetch: after a disk from the floppy swapper list has been
+ * inserted, the previous and next list entries are opened on a worker
+ * thread. Unpacked and decoded images (DMS, archives, ...) end up in the
+ * zfile cache so the next swap only copies the ready image; plain images
+ * are read once so they come from the OS file cache. */
+
+#define DISK_PREFETCH_QUEUE 16
+
+static smp_comm_pipe disk_prefetch_requests;
+static volatile int disk_prefetch_running;
+static volatile uae_atomic disk_prefetch_pending;
+
+static void *disk_prefetch_thread (void *v)
+{
+	for (;;) {
+		TCHAR *name = (TCHAR*)read_comm_pipe_pvoid_blocking (&disk_prefetch_requests);
+		if (!name)
+			break;
+		zfile_prefetch (name, ZFD_NORMAL);
+		xfree (name);
+		atomic_dec (&disk_prefetch_pending);
+	}
+	disk_prefetch_running = -1;
+	return 0;
+}
+
+static void disk_prefetch (struct uae_prefs *p, const TCHAR *name)
+{
+	TCHAR path[MAX_DPATH];
+
+	for (int i = 0; i < MAX_FLOPPY_DRIVES; i++) {
+		if (!_tcscmp (p->floppyslots[i].df, name))
+			return;
+	}
+	if (disk_prefetch_pending >= DISK_PREFETCH_QUEUE / 2)
+		return;
+	if (!disk_prefetch_running) {
+		init_comm_pipe (&disk_prefetch_requests, DISK_PREFETCH_QUEUE, 1);
+		disk_prefetch_running = 1;
+		if (!uae_start_thread (_T("disk-prefetch"), disk_prefetch_thread, NULL, NULL)) {
+			disk_prefetch_running = 0;
+			destroy_comm_pipe (&disk_prefetch_requests);
+			return;
+		}
+	}
+	cfgfile_resolve_path_out_load (name, path, MAX_DPATH, PATH_FLOPPY);
+	atomic_inc (&disk_prefetch_pending);
+	write_comm_pipe_pvoid (&disk_prefetch_requests, my_strdup (path), 1);
+}
+
+static void disk_prefetch_neighbours (struct uae_prefs *p, const TCHAR *name)
+{
+	int idx, i;
+
+	if (!zfile_cache_enabled ())
+		return;
+	for (idx = 0; idx < MAX_SPARE_DRIVES; idx++) {
+		if (!_tcscmp (p->dfxlist[idx], name))
+			break;
+	}
+	if (idx >= MAX_SPARE_DRIVES)
+		return;
+	for (i = idx + 1; i < MAX_SPARE_DRIVES; i++) {
+		if (p->dfxlist[i][0]) {
+			disk_prefetch (p, p->dfxlist[i]);
+			break;
+		}
+	}
+	for (i = idx - 1; i >= 0; i--) {
+		if (p->dfxlist[i][0]) {
+			disk_prefetch (p, p->dfxlist[i]);
+			break;
+		}
+	}
+}
+
+static void disk_prefetch_stop (void)
+{
+	if (disk_prefetch_running <= 0)
+		return;
+	write_comm_pipe_pvoid (&disk_prefetch_requests, NULL, 1);
+	while (disk_prefetch_running > 0)
+		sleep_millis (10);
+	disk_prefetch_running = 0;
+	destroy_comm_pipe (&disk_prefetch_requests);
+}
+
 static int drive_insert (drive * drv, struct uae_prefs *p, int dnum, const TCHAR *fname_in, bool fake, bool forcedwriteprotect)
 {
 #ifdef FSUAE
@@ -1257,6 +1345,7 @@ static int drive_insert (drive * drv, struct uae_prefs *p, int dnum, const TCHAR
 		_tcscpy (drv->newname, fname_in);
 		drv->newnamewriteprotected = forcedwriteprotect;
 		gui_filename (dnum, outname);
+		disk_prefetch_neighbours (p, fname_in);
 	}
 
 	memset (buffer, 0, sizeof buffer);
@@ -4453,6 +4542,7 @@ void DSKPTL (uae_u16 v)
 
 void DISK_free (void)
 {
+	disk_prefetch_stop ();
 	for (int dr = 0; dr < MAX_FLOPPY_DRIVES; dr++) {
 		drive *drv = &floppy[dr];
 		drive_image_free (drv);
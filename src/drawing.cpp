@@ -111,7 +111,7 @@ bool direct_rgb;
 coordinates.  Zero if the resolution is the same, positive if window coordinates
 have a higher resolution (i.e. we're stretching the image), negative if window
 coordinates have a lower resolution (i.e. we're shrinking the image).  */
-static int res_shift;
+static thread_local int res_shift;
 
 static int linedbl, linedbld;
 
@@ -156,9 +156,12 @@ struct spritepixelsbuf {
 	uae_u16 stfmdata;
 	uae_u16 data;
 };
-static struct spritepixelsbuf spritepixels_buffer[MAX_PIXELS_PER_LINE];
-static struct spritepixelsbuf *spritepixels;
-static int sprite_first_x, sprite_last_x;
+/* Large per-line buffers are reached through thread_local pointers so that
+ * only render threads pay for their own copy, see render_thread(). */
+static struct spritepixelsbuf spritepixels_buffer_main[MAX_PIXELS_PER_LINE];
+static thread_local struct spritepixelsbuf *spritepixels_buffer = spritepixels_buffer_main;
+static thread_local struct spritepixelsbuf *spritepixels;
+static thread_local int sprite_first_x, sprite_last_x;
 
 /* AGA mode color lookup tables */
 unsigned int xredcolors[256], xgreencolors[256], xbluecolors[256];
@@ -172,19 +175,21 @@ int xredcolor_s, xredcolor_b, xredcolor_m;
 int xgreencolor_s, xgreencolor_b, xgreencolor_m;
 int xbluecolor_s, xbluecolor_b, xbluecolor_m;
 
-struct color_entry colors_for_drawing;
+thread_local struct color_entry colors_for_drawing;
 static struct color_entry direct_colors_for_drawing;
 
-static xcolnr *p_acolors;
-static xcolnr *p_xcolors;
+static thread_local xcolnr *p_acolors;
+static thread_local xcolnr *p_xcolors;
 
 /* The size of these arrays is pretty arbitrary; it was chosen to be "more
 than enough".  The coordinates used for indexing into these arrays are
 almost, but not quite, Amiga coordinates (there's a constant offset).  */
-static union {
+static thread_local union {
 	uae_u64 apixels_q[MAX_PIXELS_PER_LINE * 2 / sizeof(uae_u64)];
 	uae_u32 apixels_l[MAX_PIXELS_PER_LINE * 2 / sizeof(uae_u32)];
 	uae_u8  apixels[MAX_PIXELS_PER_LINE * 2];
+	/* the vector linetoscr loads may read a few bytes past the last pixel */
+	uae_u8  apixels_pad[MAX_PIXELS_PER_LINE * 2 + 32];
 } pixdata;
 
 static uae_u8 *refresh_indicator_buffer;
@@ -199,13 +204,14 @@ uae_u16 spixels[2 * MAX_SPR_PIXELS];
 
 struct sprite_stb spixstate;
 
-static uae_u32 ham_linebuf[MAX_PIXELS_PER_LINE * 2];
-static uae_u8 *real_bplpt[8];
+static uae_u32 ham_linebuf_main[MAX_PIXELS_PER_LINE * 2];
+static thread_local uae_u32 *ham_linebuf = ham_linebuf_main;
+static thread_local uae_u8 *real_bplpt[8];
 
 static uae_u8 all_ones[MAX_PIXELS_PER_LINE];
 static uae_u8 all_zeros[MAX_PIXELS_PER_LINE];
 
-uae_u8 *xlinebuffer, *xlinebuffer_genlock;
+thread_local uae_u8 *xlinebuffer, *xlinebuffer_genlock;
 
 static int *amiga2aspect_line_map, *native2amiga_line_map;
 static uae_u8 **row_map;
@@ -262,21 +268,26 @@ static int first_block_line, last_block_line;
 
 /* These are generated by the drawing code from the line_decisions array for
 each line that needs to be drawn.  These are basically extracted out of
-bit fields in the hardware registers.  */
-static int bplmode, bplehb, bplham, bpldualpf, bpldualpfpri;
-static int bpldualpf2of, bplplanecnt, ecsshres;
-static int bplbypass, bplcolorburst, bplcolorburst_field;
-static bool issprites;
-static int bplres;
-static int plf1pri, plf2pri, bplxor, bpland, bpldelay_sh;
-static uae_u32 plf_sprite_mask;
-static int sbasecol[2] = { 16, 16 };
-static int hposblank;
-static bool ecs_genlock_features_active;
-static uae_u8 ecs_genlock_features_mask;
-static bool ecs_genlock_features_colorkey;
-static int hsync_shift_hack;
-static bool sprite_smaller_than_64, sprite_smaller_than_64_inuse;
+bit fields in the hardware registers.  Like the rest of the per-line drawing
+state they are thread local, lines may be handed to the render threads.  */
+static thread_local int bplmode, bplehb, bplham, bpldualpf, bpldualpfpri;
+static thread_local int bpldualpf2of, bplplanecnt, ecsshres;
+static thread_local int bplbypass, bplcolorburst;
+static int bplcolorburst_field; /* emulation thread only */
+static thread_local bool bplcolorburst_cleared; /* folded into bplcolorburst_field */
+/* set while lines are rendered in parallel, see render_batch_parallel() */
+static thread_local bool render_private_dp;
+static thread_local bool issprites;
+static thread_local int bplres;
+static thread_local int plf1pri, plf2pri, bplxor, bpland, bpldelay_sh;
+static thread_local uae_u32 plf_sprite_mask;
+static thread_local int sbasecol[2] = { 16, 16 };
+static thread_local int hposblank;
+static thread_local bool ecs_genlock_features_active;
+static thread_local uae_u8 ecs_genlock_features_mask;
+static thread_local bool ecs_genlock_features_colorkey;
+static thread_local int hsync_shift_hack;
+static thread_local bool sprite_smaller_than_64, sprite_smaller_than_64_inuse;
 
 uae_sem_t gui_sem;
 
@@ -335,6 +346,27 @@ static void xlinecheck (unsigned int start, unsigned int end)
 #define xlinecheck(start, end)
 #endif
 
+/* Record rows y1 to y2 - 1 of the buffer as written, so the display code
+ * only needs to pass on rows which have changed. Lines which the chipset
+ * code found identical to the previous frame are never drawn, so static
+ * screens produce no dirty rows at all. */
+static void mark_rows_dirty (struct vidbuffer *vb, int y1, int y2)
+{
+	if (!vb->dirty_rows)
+		return;
+	if (y1 < 0)
+		y1 = 0;
+	if (y2 > vb->height_allocated)
+		y2 = vb->height_allocated;
+	if (y1 < y2)
+		memset (vb->dirty_rows + y1, 1, y2 - y1);
+}
+
+static void mark_all_rows_dirty (struct vidbuffer *vb)
+{
+	mark_rows_dirty (vb, 0, vb->height_allocated);
+}
+
 static void clearbuffer (struct vidbuffer *dst)
 {
 	if (!dst->bufmem_allocated)
@@ -344,6 +376,7 @@ static void clearbuffer (struct vidbuffer *dst)
 		memset (p, 0, dst->width_allocated * dst->pixbytes);
 		p += dst->rowbytes;
 	}
+	mark_all_rows_dirty (dst);
 }
 
 static void reset_decision_table (void)
@@ -850,8 +883,8 @@ void get_custom_mouse_limits (int *pw, int *ph, int *pdx, int *pdy, int dbl)
 	*pdx = dx; *pdy = dy;
 }
 
-static struct decision *dp_for_drawing;
-static struct draw_info *dip_for_drawing;
+static thread_local struct decision *dp_for_drawing;
+static thread_local struct draw_info *dip_for_drawing;
 
 /* Record DIW of the current line for use by centering code.  */
 void record_diw_line (int plfstrt, int first, int last)
@@ -886,19 +919,19 @@ STATIC_INLINE int get_shdelay_add(void)
 where do we start drawing the playfield, where do we start drawing the right border.
 All of these are forced into the visible window (VISIBLE_LEFT_BORDER .. VISIBLE_RIGHT_BORDER).
 PLAYFIELD_START and PLAYFIELD_END are in window coordinates.  */
-static int playfield_start_pre, playfield_end_pre;
-static int playfield_start, playfield_end;
-static int real_playfield_start, real_playfield_end;
-static int playfield_diff;
-static int sprite_playfield_start;
-static int may_require_hard_way;
-static int linetoscr_diw_start, linetoscr_diw_end;
-static int native_ddf_left, native_ddf_right;
-
-static int pixels_offset;
-static int src_pixel;
+static thread_local int playfield_start_pre, playfield_end_pre;
+static thread_local int playfield_start, playfield_end;
+static thread_local int real_playfield_start, real_playfield_end;
+static thread_local int playfield_diff;
+static thread_local int sprite_playfield_start;
+static thread_local int may_require_hard_way;
+static thread_local int linetoscr_diw_start, linetoscr_diw_end;
+static thread_local int native_ddf_left, native_ddf_right;
+
+static thread_local int pixels_offset;
+static thread_local int src_pixel;
 /* How many pixels in window coordinates which are to the left of the left border.  */
-static int unpainted;
+static thread_local int unpainted;
 
 STATIC_INLINE xcolnr getbgc (int blank)
 {
@@ -1331,7 +1364,7 @@ static void fill_line_border (int lineno)
 	}
 }
 
-static int sprite_shdelay;
+static thread_local int sprite_shdelay;
 #define SPRITE_DEBUG 0
 static uae_u8 render_sprites (int pos, int dualpf, uae_u8 apixel, int aga)
 {
@@ -1452,6 +1485,34 @@ STATIC_INLINE bool get_genlock_transparency(uae_u8 v)
 	}
 }
 
+#if defined(__GNUC__) && defined(__x86_64__) && (defined(__clang__) || __GNUC__ >= 5)
+/* genlinetoscr also emits AVX2 versions of the 32-bit functions, selected at
+   runtime by linetoscr_simd_select(). */
+#define LINETOSCR_AVX2 1
+#define LINETOSCR_AVX2_TARGET __attribute__ ((target ("avx2")))
+#include <immintrin.h>
+
+struct linetoscr_simd {
+	int (*scalar)(int spix, int dpix, int dpix_end);
+	int (*simd)(int spix, int dpix, int dpix_end);
+	const char *name;
+};
+
+/* Any non-zero byte (not only .data) sends the step to the scalar code,
+   cnt is a multiple of 8. */
+STATIC_INLINE bool spritepixels_empty (int dpix, int cnt)
+{
+	const uae_u8 *p = (const uae_u8 *)&spritepixels[dpix];
+	uae_u64 v = 0;
+	for (int i = 0; i < cnt * (int)sizeof (struct spritepixelsbuf); i += 8) {
+		uae_u64 t;
+		memcpy (&t, p + i, 8);
+		v |= t;
+	}
+	return v == 0;
+}
+#endif
+
 #include "linetoscr.cpp"
 
 #define LTPARMS src_pixel, start, stop
@@ -1788,12 +1849,283 @@ static int linetoscr_16_shrink2f_sh(int spix, int dpix, int stoppos)
 
 typedef int(*call_linetoscr)(int spix, int dpix, int dpix_end);
 
-static call_linetoscr pfield_do_linetoscr_normal;
-static call_linetoscr pfield_do_linetoscr_sprite;
-static call_linetoscr pfield_do_linetoscr_spriteonly;
+static thread_local call_linetoscr pfield_do_linetoscr_normal;
+static thread_local call_linetoscr pfield_do_linetoscr_sprite;
+static thread_local call_linetoscr pfield_do_linetoscr_spriteonly;
+
+#ifdef LINETOSCR_AVX2
+static bool linetoscr_avx2;
+static bool render_threads_active (void);
+
+static call_linetoscr linetoscr_simd_select (call_linetoscr f)
+{
+	if (!linetoscr_avx2)
+		return f;
+	for (const struct linetoscr_simd *t = linetoscr_avx2_table; t->scalar; t++) {
+		if (t->scalar == f)
+			return t->simd;
+	}
+	return f;
+}
+
+/* Bench mode (FS_DEBUG_LINETOSCR_BENCH=<lines>): record that many lines
+   drawn by the table functions, then time the scalar and AVX2 versions on
+   them and check that they produce the same output. Each recorded line is
+   also run through every non-sprite function of the table (all horizontal
+   modes, OCS/ECS and AGA) with the colour modes below, so one recording
+   checks the modes the title itself doesn't use on real pixel data. */
+
+#define LINETOSCR_BENCH_REPEAT 100
+
+struct linetoscr_bench_line {
+	int fn;
+	int spix, dpix, dpix_end;
+	int bplmode, bplxor, bpland, bpldualpfpri, bpldualpf2of;
+	xcolnr acolors[sizeof colors_for_drawing.acolors / sizeof (xcolnr)];
+	uae_u8 apixels[MAX_PIXELS_PER_LINE * 2];
+};
+
+static struct linetoscr_bench_line *linetoscr_bench;
+static int linetoscr_bench_lines, linetoscr_bench_recorded;
+
+// -1: keep the recorded value
+static const struct linetoscr_bench_variant {
+	const TCHAR *name;
+	int aga;
+	int bplmode, bplxor, bpland, bpldualpfpri, bpldualpf2of;
+} linetoscr_bench_variants[] = {
+	{ _T("recorded"), -1, -1, -1, -1, -1, -1 },
+	{ _T("normal"), -1, CMODE_NORMAL, 0, 0xff, -1, -1 },
+	{ _T("xor"), 1, CMODE_NORMAL, 0xa5, 0xff, -1, -1 },
+	{ _T("and"), 1, CMODE_NORMAL, 0, 0x3f, -1, -1 },
+	{ _T("xor+and"), 1, CMODE_NORMAL, 0x5a, 0xf0, -1, -1 },
+	{ _T("dualpf"), -1, CMODE_DUALPF, 0, 0xff, 0, 0 },
+	{ _T("dualpf pri"), -1, CMODE_DUALPF, 0, 0xff, 1, 0 },
+	{ _T("dualpf 2of"), 1, CMODE_DUALPF, 0, 0xff, 0, 3 },
+	{ _T("dualpf pri 2of xor"), 1, CMODE_DUALPF, 0x0f, 0xff, 1, 7 },
+	{ _T("killehb"), 0, CMODE_EXTRAHB_ECS_KILLEHB, -1, -1, -1, -1 },
+	{ NULL }
+};
+
+/* Runs all non-sprite table functions over line l in every applicable
+   variant, returns the number of mismatching runs and logs the first one
+   of each function. */
+static int linetoscr_bench_check (struct linetoscr_bench_line *l, uae_u32 *out1, uae_u32 *out2, int *bad, int *runs)
+{
+	int mismatches = 0;
+
+	for (int fn = 0; linetoscr_avx2_table[fn].scalar; fn++) {
+		const struct linetoscr_simd *t = &linetoscr_avx2_table[fn];
+		int aga = _tcsstr (t->name, _T("_aga")) != NULL;
+		int srcstep = _tcsstr (t->name, _T("_shrink2")) ? 4 : _tcsstr (t->name, _T("_shrink1")) ? 2 : 1;
+		int dpix_end = l->dpix_end;
+
+		if (_tcsstr (t->name, _T("_spr")))
+			continue;
+		if (l->spix + (dpix_end - l->dpix) * srcstep > MAX_PIXELS_PER_LINE * 2)
+			dpix_end = l->dpix + (MAX_PIXELS_PER_LINE * 2 - l->spix) / srcstep;
+		for (const struct linetoscr_bench_variant *v = linetoscr_bench_variants; v->name; v++) {
+			int s1, s2;
+			if (v->aga >= 0 && v->aga != aga)
+				continue;
+			bplmode = v->bplmode >= 0 ? v->bplmode : l->bplmode;
+			bplxor = v->bplxor >= 0 ? v->bplxor : l->bplxor;
+			bpland = v->bpland >= 0 ? v->bpland : l->bpland;
+			bpldualpfpri = v->bpldualpfpri >= 0 ? v->bpldualpfpri : l->bpldualpfpri;
+			bpldualpf2of = v->bpldualpf2of >= 0 ? v->bpldualpf2of : l->bpldualpf2of;
+			// HAM and EHB lines are scalar anyway, only check them as recorded
+			if (bplmode == CMODE_HAM || bplmode == CMODE_EXTRAHB || (aga && bplmode == CMODE_EXTRAHB_ECS_KILLEHB)) {
+				if (v != linetoscr_bench_variants)
+					continue;
+			}
+			memset (out1, 0, MAX_PIXELS_PER_LINE * sizeof (uae_u32));
+			memset (out2, 0, MAX_PIXELS_PER_LINE * sizeof (uae_u32));
+			xlinebuffer = (uae_u8 *)out1;
+			s1 = t->scalar (l->spix, l->dpix, dpix_end);
+			xlinebuffer = (uae_u8 *)out2;
+			s2 = t->simd (l->spix, l->dpix, dpix_end);
+			runs[fn]++;
+			if (s1 == s2 && !memcmp (out1, out2, MAX_PIXELS_PER_LINE * sizeof (uae_u32)))
+				continue;
+			if (!bad[fn]) {
+				int x = 0;
+				while (x < MAX_PIXELS_PER_LINE - 1 && out1[x] == out2[x])
+					x++;
+				write_log (_T("LINETOSCR: %s (%s) differs, spix %d dpix %d-%d: returned %d/%d, first difference at %d: %08x/%08x\n"),
+					t->name, v->name, l->spix, l->dpix, dpix_end, s1, s2, x, out1[x], out2[x]);
+			}
+			bad[fn]++;
+			mismatches++;
+		}
+	}
+	return mismatches;
+}
+
+static void linetoscr_bench_run (void)
+{
+	int cnt = sizeof linetoscr_avx2_table / sizeof linetoscr_avx2_table[0];
+	uae_s64 *t_scalar = xcalloc (uae_s64, cnt);
+	uae_s64 *t_simd = xcalloc (uae_s64, cnt);
+	int *lines = xcalloc (int, cnt);
+	int *bad = xcalloc (int, cnt);
+	int *check_runs = xcalloc (int, cnt);
+	int *check_bad = xcalloc (int, cnt);
+	int mismatches = 0, check_mismatches = 0, check_total = 0;
+	uae_u32 *out1 = xcalloc (uae_u32, MAX_PIXELS_PER_LINE);
+	uae_u32 *out2 = xcalloc (uae_u32, MAX_PIXELS_PER_LINE);
+	uae_u8 *oldpixels = xmalloc (uae_u8, sizeof pixdata.apixels);
+	uae_u8 *oldxlinebuffer = xlinebuffer;
+	xcolnr *oldacolors = p_acolors;
+	int oldbplmode = bplmode, oldbplxor = bplxor, oldbpland = bpland;
+	int oldbpldualpfpri = bpldualpfpri, oldbpldualpf2of = bpldualpf2of;
+
+	memcpy (oldpixels, pixdata.apixels, sizeof pixdata.apixels);
+	for (int i = 0; i < linetoscr_bench_recorded; i++) {
+		struct linetoscr_bench_line *l = &linetoscr_bench[i];
+		const struct linetoscr_simd *t = &linetoscr_avx2_table[l->fn];
+		int s1 = 0, s2 = 0;
+		uae_s64 t0, t1, t2;
+
+		memcpy (pixdata.apixels, l->apixels, sizeof pixdata.apixels);
+		p_acolors = l->acolors;
+		bplmode = l->bplmode;
+		bplxor = l->bplxor;
+		bpland = l->bpland;
+		bpldualpfpri = l->bpldualpfpri;
+		bpldualpf2of = l->bpldualpf2of;
+		memset (out1, 0, MAX_PIXELS_PER_LINE * sizeof (uae_u32));
+		memset (out2, 0, MAX_PIXELS_PER_LINE * sizeof (uae_u32));
+		t0 = uae_time_ns ();
+		xlinebuffer = (uae_u8 *)out1;
+		for (int j = 0; j < LINETOSCR_BENCH_REPEAT; j++)
+			s1 = t->scalar (l->spix, l->dpix, l->dpix_end);
+		t1 = uae_time_ns ();
+		xlinebuffer = (uae_u8 *)out2;
+		for (int j = 0; j < LINETOSCR_BENCH_REPEAT; j++)
+			s2 = t->simd (l->spix, l->dpix, l->dpix_end);
+		t2 = uae_time_ns ();
+		t_scalar[l->fn] += t1 - t0;
+		t_simd[l->fn] += t2 - t1;
+		lines[l->fn]++;
+		if (s1 != s2 || memcmp (out1, out2, MAX_PIXELS_PER_LINE * sizeof (uae_u32))) {
+			if (!bad[l->fn]) {
+				int x = 0;
+				while (x < MAX_PIXELS_PER_LINE - 1 && out1[x] == out2[x])
+					x++;
+				write_log (_T("LINETOSCR: %s differs, spix %d dpix %d-%d: returned %d/%d, first difference at %d: %08x/%08x\n"),
+					t->name, l->spix, l->dpix, l->dpix_end, s1, s2, x, out1[x], out2[x]);
+			}
+			bad[l->fn]++;
+			mismatches++;
+		}
+		check_mismatches += linetoscr_bench_check (l, out1, out2, check_bad, check_runs);
+	}
+	for (int i = 0; i < cnt; i++) {
+		if (!lines[i])
+			continue;
+		write_log (_T("LINETOSCR: %s: %d lines, scalar %lld ns, avx2 %lld ns per line, %d mismatches\n"),
+			linetoscr_avx2_table[i].name, lines[i],
+			(long long)(t_scalar[i] / (lines[i] * LINETOSCR_BENCH_REPEAT)),
+			(long long)(t_simd[i] / (lines[i] * LINETOSCR_BENCH_REPEAT)), bad[i]);
+	}
+	for (int i = 0; i < cnt; i++) {
+		if (!check_runs[i])
+			continue;
+		write_log (_T("LINETOSCR: %s: checked %d runs, %d mismatches\n"),
+			linetoscr_avx2_table[i].name, check_runs[i], check_bad[i]);
+		check_total += check_runs[i];
+	}
+	write_log (_T("LINETOSCR: compared %d lines, scalar and AVX2 output %s (%d mismatches)\n"),
+		linetoscr_bench_recorded, mismatches ? _T("DIFFER") : _T("identical"), mismatches);
+	write_log (_T("LINETOSCR: checked %d runs over all modes, scalar and AVX2 output %s (%d mismatches)\n"),
+		check_total, check_mismatches ? _T("DIFFER") : _T("identical"), check_mismatches);
+	memcpy (pixdata.apixels, oldpixels, sizeof pixdata.apixels);
+	xlinebuffer = oldxlinebuffer;
+	p_acolors = oldacolors;
+	bplmode = oldbplmode;
+	bplxor = oldbplxor;
+	bpland = oldbpland;
+	bpldualpfpri = oldbpldualpfpri;
+	bpldualpf2of = oldbpldualpf2of;
+	xfree (oldpixels);
+	xfree (out2);
+	xfree (out1);
+	xfree (check_bad);
+	xfree (check_runs);
+	xfree (bad);
+	xfree (lines);
+	xfree (t_simd);
+	xfree (t_scalar);
+}
+
+static void linetoscr_bench_record (int spix, int dpix, int dpix_end)
+{
+	struct linetoscr_bench_line *l;
+	int fn = -1;
+
+	// The recorder and the benchmark use the emulation thread's drawing
+	// state, never record while lines are being rendered in parallel.
+	if (render_private_dp || render_threads_active () || !is_mainthread ())
+		return;
+	if (dpix < 0 || dpix_end > MAX_PIXELS_PER_LINE)
+		return;
+	for (int i = 0; linetoscr_avx2_table[i].scalar; i++) {
+		if (linetoscr_avx2_table[i].scalar == pfield_do_linetoscr_normal || linetoscr_avx2_table[i].simd == pfield_do_linetoscr_normal) {
+			fn = i;
+			break;
+		}
+	}
+	if (fn < 0)
+		return;
+	if (!linetoscr_bench)
+		linetoscr_bench = xcalloc (struct linetoscr_bench_line, linetoscr_bench_lines);
+	l = &linetoscr_bench[linetoscr_bench_recorded++];
+	l->fn = fn;
+	l->spix = spix;
+	l->dpix = dpix;
+	l->dpix_end = dpix_end;
+	l->bplmode = bplmode;
+	l->bplxor = bplxor;
+	l->bpland = bpland;
+	l->bpldualpfpri = bpldualpfpri;
+	l->bpldualpf2of = bpldualpf2of;
+	memcpy (l->acolors, p_acolors, sizeof l->acolors);
+	memcpy (l->apixels, pixdata.apixels, sizeof l->apixels);
+	if (linetoscr_bench_recorded < linetoscr_bench_lines)
+		return;
+	linetoscr_bench_run ();
+	xfree (linetoscr_bench);
+	linetoscr_bench = NULL;
+	linetoscr_bench_lines = 0;
+}
+#endif
+
+static void linetoscr_simd_init (void)
+{
+#ifdef LINETOSCR_AVX2
+	const char *s = NULL;
+
+#ifdef FSUAE
+	s = getenv ("FS_DEBUG_LINETOSCR_SIMD");
+#endif
+	linetoscr_avx2 = !(s && s[0] == '0') && __builtin_cpu_supports ("avx2");
+	write_log (_T("DRAWING: %s linetoscr\n"), linetoscr_avx2 ? _T("AVX2") : _T("scalar"));
+#ifdef FSUAE
+	s = getenv ("FS_DEBUG_LINETOSCR_BENCH");
+	if (s && __builtin_cpu_supports ("avx2")) {
+		linetoscr_bench_lines = atoi (s);
+		linetoscr_bench_recorded = 0;
+	}
+#endif
+#endif
+}
 
 static void pfield_do_linetoscr(int start, int stop, int blank)
 {
+#ifdef LINETOSCR_AVX2
+	if (linetoscr_bench_lines > 0)
+		linetoscr_bench_record (src_pixel, start, stop);
+#endif
 	src_pixel = pfield_do_linetoscr_normal(src_pixel, start, stop);
 }
 static void pfield_do_linetoscr_spr(int start, int stop, int blank)
@@ -1806,8 +2138,8 @@ static int pfield_do_nothing(int a, int b, int c)
 }
 
 /* AGA subpixel delay hack */
-static call_linetoscr pfield_do_linetoscr_shdelay_normal;
-static call_linetoscr pfield_do_linetoscr_shdelay_sprite;
+static thread_local call_linetoscr pfield_do_linetoscr_shdelay_normal;
+static thread_local call_linetoscr pfield_do_linetoscr_shdelay_sprite;
 
 static int pfield_do_linetoscr_normal_shdelay(int spix, int dpix, int dpix_end)
 {
@@ -2097,6 +2429,12 @@ static void pfield_set_linetoscr (void)
 			}
 		}
 	}
+#ifdef LINETOSCR_AVX2
+	pfield_do_linetoscr_normal = linetoscr_simd_select (pfield_do_linetoscr_normal);
+	pfield_do_linetoscr_sprite = linetoscr_simd_select (pfield_do_linetoscr_sprite);
+	pfield_do_linetoscr_shdelay_normal = linetoscr_simd_select (pfield_do_linetoscr_shdelay_normal);
+	pfield_do_linetoscr_shdelay_sprite = linetoscr_simd_select (pfield_do_linetoscr_shdelay_sprite);
+#endif
 }
 
 // left or right AGA border sprite
@@ -2113,8 +2451,8 @@ static void dummy_worker (int start, int stop, int blank)
 {
 }
 
-static int ham_decode_pixel;
-static unsigned int ham_lastcolor;
+static thread_local int ham_decode_pixel;
+static thread_local unsigned int ham_lastcolor;
 
 /* Decode HAM in the invisible portion of the display (left of VISIBLE_LEFT_BORDER),
  * but don't draw anything in.  This is done to prepare HAM_LASTCOLOR for later,
@@ -2854,7 +3192,7 @@ static void pfield_expand_dp_bplcon (void)
 	issprites = dip_for_drawing->nr_sprites > 0;
 	bplcolorburst = (dp_for_drawing->bplcon0 & 0x200) != 0;
 	if (!bplcolorburst)
-		bplcolorburst_field = 0;
+		bplcolorburst_cleared = true;
 #ifdef ECS_DENISE
 	int oecsshres = ecsshres;
 	ecsshres = bplres == RES_SUPERHIRES && (currprefs.chipset_mask & CSMASK_ECS_DENISE) && !(currprefs.chipset_mask & CSMASK_AGA);
@@ -2972,8 +3310,8 @@ static void pfield_expand_dp_bplconx (int regno, int v)
 	set_res_shift();
 }
 
-static int drawing_color_matches;
-static enum { color_match_acolors, color_match_full } color_match_type;
+static thread_local int drawing_color_matches;
+static thread_local enum { color_match_acolors, color_match_full } color_match_type;
 
 /* Set up colors_for_drawing to the state at the beginning of the currently drawn
 line.  Try to avoid copying color tables around whenever possible.  */
@@ -3191,7 +3529,20 @@ enum double_how {
 	dh_emerg
 };
 
-static void pfield_draw_line (struct vidbuffer *vb, int lineno, int gfx_ypos, int follow_ypos)
+static thread_local struct decision render_dp;
+
+struct draw_line_job {
+	int lineno;
+	int gfx_ypos, follow_ypos;
+	int border, do_double;
+	struct decision *dp;
+	struct draw_info *dip;
+};
+
+/* Update the line state for one line and work out how it needs to be drawn.
+ * Always runs in the emulation thread, returns false if there is nothing
+ * to draw. */
+static bool pfield_draw_line_decide (int lineno, int gfx_ypos, int follow_ypos, struct draw_line_job *job)
 {
 #ifdef FSUAE
 #ifdef FSUAE_FRAME_DEBUG
@@ -3200,20 +3551,16 @@ static void pfield_draw_line (struct vidbuffer *vb, int lineno, int gfx_ypos, in
 	}
 #endif
 #endif
-	struct vidbuf_description *vidinfo = &adisplays[0].gfxvidinfo;
 	static int warned = 0;
 	int border = 0;
 	int do_double = 0;
-	bool have_color_changes;
-	enum double_how dh;
 	int ls = linestate[lineno];
+	struct decision *dp = line_decisions + lineno;
+	struct draw_info *dip = curr_drawinfo + lineno;
 
-	dp_for_drawing = line_decisions + lineno;
-	dip_for_drawing = curr_drawinfo + lineno;
-
-	if (dp_for_drawing->plfleft >= 0) {
+	if (dp->plfleft >= 0) {
 		lines_count++;
-		resolution_count[dp_for_drawing->bplres]++;
+		resolution_count[dp->bplres]++;
 	}
 
 	switch (ls)
@@ -3221,7 +3568,7 @@ static void pfield_draw_line (struct vidbuffer *vb, int lineno, int gfx_ypos, in
 	case LINE_REMEMBERED_AS_PREVIOUS:
 //		if (!warned) // happens when program messes up with VPOSW
 //			write_log (_T("Shouldn't get here... this is a bug.\n")), warned++;
-		return;
+		return false;
 
 	case LINE_BLACK:
 		linestate[lineno] = LINE_REMEMBERED_AS_BLACK;
@@ -3229,20 +3576,20 @@ static void pfield_draw_line (struct vidbuffer *vb, int lineno, int gfx_ypos, in
 		break;
 
 	case LINE_REMEMBERED_AS_BLACK:
-		return;
+		return false;
 
 	case LINE_AS_PREVIOUS:
-		dp_for_drawing--;
-		dip_for_drawing--;
+		dp--;
+		dip--;
 		linestate[lineno] = LINE_DONE_AS_PREVIOUS;
-		if (dp_for_drawing->plfleft < 0)
+		if (dp->plfleft < 0)
 			border = 1;
 		break;
 
 	case LINE_DONE_AS_PREVIOUS:
 		/* fall through */
 	case LINE_DONE:
-		return;
+		return false;
 
 	case LINE_DECIDED_DOUBLE:
 		if (follow_ypos >= 0) {
@@ -3252,12 +3599,43 @@ static void pfield_draw_line (struct vidbuffer *vb, int lineno, int gfx_ypos, in
 
 		/* fall through */
 	default:
-		if (dp_for_drawing->plfleft < 0)
+		if (dp->plfleft < 0)
 			border = 1;
 		linestate[lineno] = LINE_DONE;
 		break;
 	}
 
+	job->lineno = lineno;
+	job->gfx_ypos = gfx_ypos;
+	job->follow_ypos = follow_ypos;
+	job->border = border;
+	job->do_double = do_double;
+	job->dp = dp;
+	job->dip = dip;
+	return true;
+}
+
+static void pfield_draw_line_render (struct vidbuffer *vb, const struct draw_line_job *job)
+{
+	struct vidbuf_description *vidinfo = &adisplays[0].gfxvidinfo;
+	int lineno = job->lineno;
+	int gfx_ypos = job->gfx_ypos;
+	int follow_ypos = job->follow_ypos;
+	int border = job->border;
+	int do_double = job->do_double;
+	bool have_color_changes;
+	enum double_how dh;
+
+	if (render_private_dp) {
+		// HAM decoding temporarily rewrites the decision's BPLCONx fields,
+		// parallel rendering must not touch the shared line_decisions.
+		render_dp = *job->dp;
+		dp_for_drawing = &render_dp;
+	} else {
+		dp_for_drawing = job->dp;
+	}
+	dip_for_drawing = job->dip;
+
 	have_color_changes = is_color_changes(dip_for_drawing);
 	sprite_smaller_than_64_inuse = false;
 
@@ -3449,6 +3827,421 @@ static void pfield_draw_line (struct vidbuffer *vb, int lineno, int gfx_ypos, in
 	}
 }
 
+/* Render threads. When enabled (gfx_render_threads > 1), draw_lines() and
+ * draw_frame2() only decide the lines in the emulation thread and queue them,
+ * the queued lines are then rendered in chunks by the render threads and the
+ * emulation thread at the same time. Drawing state carried from one line to
+ * the next is reproduced at the start of each chunk, batches that depend on
+ * state which can't be reproduced that way are rendered serially. */
+
+#define RENDER_QUEUE_SIZE 1024
+
+#define RENDER_STATE_LIST \
+	RENDER_STATE(res_shift) \
+	RENDER_STATE(colors_for_drawing) \
+	RENDER_STATE(bplmode) \
+	RENDER_STATE(bplehb) \
+	RENDER_STATE(bplham) \
+	RENDER_STATE(bpldualpf) \
+	RENDER_STATE(bpldualpfpri) \
+	RENDER_STATE(bpldualpf2of) \
+	RENDER_STATE(bplplanecnt) \
+	RENDER_STATE(ecsshres) \
+	RENDER_STATE(bplbypass) \
+	RENDER_STATE(bplcolorburst) \
+	RENDER_STATE(issprites) \
+	RENDER_STATE(bplres) \
+	RENDER_STATE(plf1pri) \
+	RENDER_STATE(plf2pri) \
+	RENDER_STATE(bplxor) \
+	RENDER_STATE(bpland) \
+	RENDER_STATE(bpldelay_sh) \
+	RENDER_STATE(plf_sprite_mask) \
+	RENDER_STATE(sbasecol) \
+	RENDER_STATE(ecs_genlock_features_active) \
+	RENDER_STATE(ecs_genlock_features_mask) \
+	RENDER_STATE(ecs_genlock_features_colorkey) \
+	RENDER_STATE(hsync_shift_hack) \
+	RENDER_STATE(sprite_smaller_than_64) \
+	RENDER_STATE(playfield_start_pre) \
+	RENDER_STATE(playfield_end_pre) \
+	RENDER_STATE(playfield_start) \
+	RENDER_STATE(playfield_end) \
+	RENDER_STATE(real_playfield_start) \
+	RENDER_STATE(real_playfield_end) \
+	RENDER_STATE(playfield_diff) \
+	RENDER_STATE(sprite_playfield_start) \
+	RENDER_STATE(may_require_hard_way) \
+	RENDER_STATE(linetoscr_diw_start) \
+	RENDER_STATE(linetoscr_diw_end) \
+	RENDER_STATE(native_ddf_left) \
+	RENDER_STATE(native_ddf_right) \
+	RENDER_STATE(pixels_offset) \
+	RENDER_STATE(src_pixel) \
+	RENDER_STATE(unpainted) \
+	RENDER_STATE(sprite_shdelay) \
+	RENDER_STATE(ham_decode_pixel) \
+	RENDER_STATE(ham_lastcolor) \
+	RENDER_STATE(color_match_type)
+
+struct render_state {
+#define RENDER_STATE(v) decltype(v) s_##v;
+	RENDER_STATE_LIST
+#undef RENDER_STATE
+};
+
+struct render_thread {
+	uae_sem_t start_sem;
+	volatile int quit;
+	struct vidbuffer *vb;
+	int first, last;
+	int sprite_carry;
+	bool colorburst_cleared;
+	uae_thread_id tid;
+};
+
+static struct render_thread render_threads[MAX_RENDER_THREADS];
+static int render_threads_started;
+static uae_sem_t render_done_sem;
+static struct render_state render_state;
+static struct draw_line_job render_queue[RENDER_QUEUE_SIZE];
+static int render_queue_len;
+static bool render_queue_open;
+
+static void render_save_state (struct render_state *st)
+{
+#define RENDER_STATE(v) memcpy (&st->s_##v, &v, sizeof v);
+	RENDER_STATE_LIST
+#undef RENDER_STATE
+}
+
+static void render_load_state (const struct render_state *st, int sprite_carry)
+{
+#define RENDER_STATE(v) memcpy (&v, &st->s_##v, sizeof v);
+	RENDER_STATE_LIST
+#undef RENDER_STATE
+	drawing_color_matches = -1;
+	// point p_acolors and spritepixels to this thread's buffers
+	pfield_set_linetoscr ();
+	if (sprite_carry >= 0)
+		sprite_smaller_than_64 = sprite_carry != 0;
+}
+
+static void render_jobs (struct vidbuffer *vb, int first, int last)
+{
+	for (int i = first; i < last; i++) {
+		hposblank = 0;
+		pfield_draw_line_render (vb, &render_queue[i]);
+	}
+}
+
+static void *render_thread (void *arg)
+{
+	struct render_thread *rt = (struct render_thread *)arg;
+
+	spritepixels_buffer = xcalloc (struct spritepixelsbuf, MAX_PIXELS_PER_LINE);
+	ham_linebuf = xcalloc (uae_u32, MAX_PIXELS_PER_LINE * 2);
+	render_private_dp = true;
+	for (;;) {
+		uae_sem_wait (&rt->start_sem);
+		if (rt->quit)
+			break;
+		render_load_state (&render_state, rt->sprite_carry);
+		bplcolorburst_cleared = false;
+		render_jobs (rt->vb, rt->first, rt->last);
+		rt->colorburst_cleared = bplcolorburst_cleared;
+		uae_sem_post (&render_done_sem);
+	}
+	xfree (spritepixels_buffer);
+	xfree (ham_linebuf);
+	return NULL;
+}
+
+static void render_threads_set (int want)
+{
+	if (want == render_threads_started)
+		return;
+	for (int i = 0; i < render_threads_started; i++) {
+		render_threads[i].quit = 1;
+		uae_sem_post (&render_threads[i].start_sem);
+	}
+	for (int i = 0; i < render_threads_started; i++) {
+		uae_wait_thread (render_threads[i].tid);
+		uae_end_thread (&render_threads[i].tid);
+		uae_sem_destroy (&render_threads[i].start_sem);
+	}
+	render_threads_started = 0;
+	if (!want)
+		return;
+	if (!render_done_sem)
+		uae_sem_init (&render_done_sem, 0, 0);
+	for (int i = 0; i < want; i++) {
+		struct render_thread *rt = &render_threads[i];
+		rt->quit = 0;
+		uae_sem_init (&rt->start_sem, 0, 0);
+		uae_start_thread (_T("render"), render_thread, rt, &rt->tid);
+	}
+	render_threads_started = want;
+	write_log (_T("DRAWING: %d render threads\n"), want + 1);
+}
+
+#ifdef LINETOSCR_AVX2
+static bool render_threads_active (void)
+{
+	return render_threads_started > 0;
+}
+#endif
+
+static void render_threads_update (void)
+{
+	render_threads_set (currprefs.gfx_render_threads > 1 ? currprefs.gfx_render_threads - 1 : 0);
+}
+
+/* Does rendering this line go through pfield_expand_dp_bplcon()? */
+static bool render_job_expands (const struct draw_line_job *job)
+{
+	if (job->border == 0)
+		return true;
+#ifdef AGA
+	if (job->border > 0 && job->dp->bordersprite_seen && job->dip->nr_sprites && !ce_is_borderblank(colors_for_drawing.extra))
+		return true;
+#endif
+	return false;
+}
+
+static bool render_batch_parallel (struct vidbuffer *vb, int n)
+{
+	struct vidbuf_description *vidinfo = &adisplays[0].gfxvidinfo;
+	int start[MAX_RENDER_THREADS + 1], carry[MAX_RENDER_THREADS + 1];
+	int threads = render_threads_started + 1;
+	int chunks, next, sprite_carry, last_row;
+
+	if (threads > n / 2)
+		threads = n / 2;
+	if (threads < 2)
+		return false;
+	// the lines must be rendered directly to their own rows
+	if (vidinfo->drawbuffer.linemem || vidinfo->drawbuffer.emergmem)
+		return false;
+	if (need_genlock_data || row_map_color_burst_buffer || bplbypass)
+		return false;
+
+	last_row = -1;
+	for (int i = 0; i < n; i++) {
+		const struct draw_line_job *job = &render_queue[i];
+		if (job->gfx_ypos <= last_row)
+			return false;
+		last_row = job->do_double && job->follow_ypos > job->gfx_ypos ? job->follow_ypos : job->gfx_ypos;
+		if (job->border < 0)
+			continue;
+		// colors_for_drawing.extra is used before it is updated for the line
+		if (curr_color_tables[job->dp->ctable].extra != colors_for_drawing.extra)
+			return false;
+		if (job->dp->bplcon0 & 0x20)
+			return false;
+		// mid-line BPLCONx/FMODE and border/shres/hsync changes carry over to the next line
+		for (int j = job->dip->first_color_change; j < job->dip->last_color_change; j++) {
+			int regno = curr_color_changes[j].regno;
+			if (regno >= 0x1000 && regno != 0xffff)
+				return false;
+			if (regno == 0 && (curr_color_changes[j].value & COLOR_CHANGE_MASK))
+				return false;
+		}
+	}
+
+	// Split into chunks. A line drawn as previous uses the decision of the
+	// line before it, keep them in the same chunk.
+	chunks = 0;
+	next = 0;
+	sprite_carry = -1;
+	for (int i = 0; i < n && chunks < threads; i++) {
+		const struct draw_line_job *job = &render_queue[i];
+		if (i >= next && (i == 0 || job->dp == line_decisions + job->lineno)) {
+			start[chunks] = i;
+			carry[chunks] = sprite_carry;
+			chunks++;
+			next = chunks * n / threads;
+		}
+		if (render_job_expands (job))
+			sprite_carry = (job->dp->fmode & 0x0c) != 0x0c;
+	}
+	if (chunks < 2)
+		return false;
+	start[chunks] = n;
+
+	render_save_state (&render_state);
+	for (int c = 0; c < chunks - 1; c++) {
+		struct render_thread *rt = &render_threads[c];
+		rt->vb = vb;
+		rt->first = start[c];
+		rt->last = start[c + 1];
+		rt->sprite_carry = carry[c];
+		uae_sem_post (&rt->start_sem);
+	}
+	// The emulation thread renders the last chunk so that its drawing state
+	// ends up where serial rendering would have left it.
+	drawing_color_matches = -1;
+	if (carry[chunks - 1] >= 0)
+		sprite_smaller_than_64 = carry[chunks - 1] != 0;
+	render_private_dp = true;
+	render_jobs (vb, start[chunks - 1], n);
+	render_private_dp = false;
+	for (int c = 0; c < chunks - 1; c++)
+		uae_sem_wait (&render_done_sem);
+	for (int c = 0; c < chunks - 1; c++) {
+		if (render_threads[c].colorburst_cleared)
+			bplcolorburst_cleared = true;
+	}
+	return true;
+}
+
+/* Verify mode (FS_DEBUG_RENDER_VERIFY=1): each batch that is rendered in
+ * parallel is rendered again serially from the same starting state and
+ * the same row contents. The rows and the drawing state left behind by
+ * both runs are compared, the serial result is kept. A summary is logged
+ * every RENDER_VERIFY_LOG batches and at exit. */
+
+#define RENDER_VERIFY_LOG 500
+
+static int render_verify;
+static int render_verify_batches, render_verify_rows;
+static int render_verify_bad_rows, render_verify_bad_state;
+static struct render_state render_verify_state[3];
+
+static void render_verify_log (void)
+{
+	if (!render_verify_batches)
+		return;
+	write_log (_T("DRAWING: render verify: %d batches, %d rows, %d rows differ, %d states differ: %s\n"),
+		render_verify_batches, render_verify_rows, render_verify_bad_rows, render_verify_bad_state,
+		render_verify_bad_rows || render_verify_bad_state ? _T("DIFFER") : _T("identical"));
+}
+
+static const TCHAR *render_verify_state_diff (const struct render_state *a, const struct render_state *b)
+{
+#define RENDER_STATE(v) if (memcmp (&a->s_##v, &b->s_##v, sizeof v)) return _T(#v);
+	RENDER_STATE_LIST
+#undef RENDER_STATE
+	return NULL;
+}
+
+static void render_batch_verify (struct vidbuffer *vb, int n)
+{
+	struct vidbuf_description *vidinfo = &adisplays[0].gfxvidinfo;
+	struct render_state *before = &render_verify_state[0];
+	struct render_state *parallel = &render_verify_state[1];
+	struct render_state *serial = &render_verify_state[2];
+	int rowbytes = vidinfo->drawbuffer.rowbytes;
+	bool cleared_before = bplcolorburst_cleared, cleared_parallel;
+	int *rows, nrows = 0, bad = 0;
+	uae_u8 *orig, *out;
+	const TCHAR *field;
+
+	rows = xmalloc (int, 2 * n);
+	for (int i = 0; i < n; i++) {
+		const struct draw_line_job *job = &render_queue[i];
+		if (row_map[job->gfx_ypos] != row_tmp)
+			rows[nrows++] = job->gfx_ypos;
+		if (job->follow_ypos >= 0 && job->follow_ypos != job->gfx_ypos && row_map[job->follow_ypos] != row_tmp)
+			rows[nrows++] = job->follow_ypos;
+	}
+	orig = xmalloc (uae_u8, nrows * rowbytes);
+	out = xmalloc (uae_u8, nrows * rowbytes);
+	for (int i = 0; i < nrows; i++)
+		memcpy (orig + i * rowbytes, row_map[rows[i]], rowbytes);
+	render_save_state (before);
+
+	if (!render_batch_parallel (vb, n)) {
+		render_jobs (vb, 0, n);
+		goto end;
+	}
+	render_save_state (parallel);
+	cleared_parallel = bplcolorburst_cleared;
+	for (int i = 0; i < nrows; i++) {
+		memcpy (out + i * rowbytes, row_map[rows[i]], rowbytes);
+		memcpy (row_map[rows[i]], orig + i * rowbytes, rowbytes);
+	}
+
+	render_load_state (before, -1);
+	bplcolorburst_cleared = cleared_before;
+	render_jobs (vb, 0, n);
+	render_save_state (serial);
+
+	for (int i = 0; i < nrows; i++) {
+		uae_u8 *a = out + i * rowbytes, *b = row_map[rows[i]];
+		if (!memcmp (a, b, rowbytes))
+			continue;
+		if (!render_verify_bad_rows && !bad) {
+			int x = 0;
+			while (a[x] == b[x])
+				x++;
+			write_log (_T("DRAWING: render verify: batch %d row %d differs at byte %d (%02x, serial %02x)\n"),
+				render_verify_batches, rows[i], x, a[x], b[x]);
+		}
+		bad++;
+	}
+	field = render_verify_state_diff (parallel, serial);
+	if (!field && cleared_parallel != bplcolorburst_cleared)
+		field = _T("bplcolorburst_cleared");
+	if (field) {
+		if (!render_verify_bad_state)
+			write_log (_T("DRAWING: render verify: batch %d state %s differs\n"), render_verify_batches, field);
+		render_verify_bad_state++;
+	}
+	render_verify_rows += nrows;
+	render_verify_bad_rows += bad;
+	if (++render_verify_batches % RENDER_VERIFY_LOG == 0)
+		render_verify_log ();
+end:
+	xfree (out);
+	xfree (orig);
+	xfree (rows);
+}
+
+static void render_batch_flush (struct vidbuffer *vb)
+{
+	int n = render_queue_len;
+
+	render_queue_len = 0;
+	if (render_verify)
+		render_batch_verify (vb, n);
+	else if (!render_batch_parallel (vb, n))
+		render_jobs (vb, 0, n);
+}
+
+static void render_batch_begin (void)
+{
+	render_threads_update ();
+	render_queue_len = 0;
+	render_queue_open = render_threads_started > 0;
+}
+
+static void render_batch_end (struct vidbuffer *vb)
+{
+	if (!render_queue_open)
+		return;
+	render_queue_open = false;
+	render_batch_flush (vb);
+}
+
+static void pfield_draw_line (struct vidbuffer *vb, int lineno, int gfx_ypos, int follow_ypos)
+{
+	struct draw_line_job job;
+
+	if (!pfield_draw_line_decide (lineno, gfx_ypos, follow_ypos, &job))
+		return;
+	mark_rows_dirty (vb, gfx_ypos, gfx_ypos + 1);
+	if (follow_ypos >= 0)
+		mark_rows_dirty (vb, follow_ypos, follow_ypos + 1);
+	if (render_queue_open) {
+		render_queue[render_queue_len++] = job;
+		if (render_queue_len == RENDER_QUEUE_SIZE)
+			render_batch_flush (vb);
+		return;
+	}
+	pfield_draw_line_render (vb, &job);
+}
+
 static void center_image (void)
 {
 #ifdef FSUAE
@@ -3998,6 +4791,7 @@ static void draw_frame2(struct vidbuffer *vbin, struct vidbuffer *vbout)
 	int largest = 0;
 #endif
 
+	render_batch_begin();
 	for (int i = 0; i < max_ypos_thisframe; i++) {
 		int i1 = i + min_ypos_for_screen;
 		int line = i + thisframe_y_adjust_real;
@@ -4017,6 +4811,7 @@ static void draw_frame2(struct vidbuffer *vbin, struct vidbuffer *vbout)
 		hposblank = 0;
 		pfield_draw_line(vbout, line, whereline, wherenext);
 	}
+	render_batch_end(vbout);
 
 #if LARGEST_LINE_DEBUG
 	write_log (_T("%d\n"), largest);
@@ -4025,6 +4820,10 @@ static void draw_frame2(struct vidbuffer *vbin, struct vidbuffer *vbout)
 
 static void draw_frame_extras(struct vidbuffer *vb, int y_start, int y_end)
 {
+	// overlays can be drawn on rows which were not redrawn this frame
+	if (((currprefs.leds_on_screen & STATUSLINE_CHIPSET) && softstatusline()) ||
+		debug_dma > 1 || debug_heatmap > 1 || lightpen_active || refresh_indicator_buffer)
+		mark_all_rows_dirty (vb);
 	if ((currprefs.leds_on_screen & STATUSLINE_CHIPSET) && softstatusline()) {
 		int slx, sly;
 		statusline_getpos(vb->monitor_id, &slx, &sly, vb->outwidth, vb->outheight, 1, 1);
@@ -4096,6 +4895,9 @@ void draw_lines(int end, int section)
 	vidinfo->outbuffer = vb;
 	if (!lockscr(vb, false, vb->last_drawn_line ? false : true))
 		return;
+	// beamracer debug markers are drawn right after each line
+	if (!beamracer_debug)
+		render_batch_begin();
 	while (vb->last_drawn_line < end) {
 		int i = vb->last_drawn_line;
 		int i1 = i + min_ypos_for_screen;
@@ -4134,6 +4936,7 @@ void draw_lines(int end, int section)
 				static const int section_colors[] = { 0x777, 0xf00, 0x0f0, 0x00f };
 				int color = section_toggle ? section_colors[section & 3] : 0;
 				xlinebuffer = row_map[whereline];
+				mark_rows_dirty (vb, whereline, whereline + 1);
 				for (int x = 0; x < 4; x++) {
 					putpixel(xlinebuffer, NULL, vidinfo->drawbuffer.pixbytes, x, xcolors[color], 1);
 				}
@@ -4151,6 +4954,7 @@ void draw_lines(int end, int section)
 	printf("UAE vb->last_drawn_line = %d\n", vb->last_drawn_line);
 #endif
 #endif
+	render_batch_end(vb);
 	draw_frame_extras(vb, y_start, y_end + 1);
 	unlockscr(vb, y_start, y_end + 1);
 }
@@ -4345,6 +5149,10 @@ static void finish_drawing_frame(bool drawlines)
 		}
 	}
 
+	if (bplcolorburst_cleared) {
+		bplcolorburst_field = 0;
+		bplcolorburst_cleared = false;
+	}
 	// grayscale
 	if (!currprefs.monitoremu && vidinfo->tempbuffer.bufmem_allocated &&
 		((!currprefs.genlock && (!bplcolorburst_field && currprefs.cs_color_burst)) || currprefs.gfx_grayscale)) {
@@ -4356,6 +5164,8 @@ static void finish_drawing_frame(bool drawlines)
 		vidinfo->drawbuffer.tempbufferinuse = true;
 	}
 
+	if (vidinfo->drawbuffer.tempbufferinuse)
+		mark_all_rows_dirty (&vidinfo->drawbuffer);
 	unlockscr(vb, -1, -1);
 }
 
@@ -4737,6 +5547,7 @@ void reset_drawing(void)
 	center_reset = true;
 	ad->specialmonitoron = false;
 	bplcolorburst_field = 1;
+	bplcolorburst_cleared = false;
 	hsync_shift_hack = 0;
 }
 
@@ -4751,6 +5562,12 @@ static void gen_direct_drawing_table(void)
 #endif
 }
 
+void drawing_free (void)
+{
+	render_threads_set (0);
+	render_verify_log ();
+}
+
 void drawing_init (void)
 {
 	int monid = 0;
@@ -4760,6 +5577,13 @@ void drawing_init (void)
 	refresh_indicator_init();
 
 	gen_pfield_tables();
+	linetoscr_simd_init();
+#ifdef FSUAE
+	{
+		const char *s = getenv ("FS_DEBUG_RENDER_VERIFY");
+		render_verify = s && atoi (s) > 0;
+	}
+#endif
 
 	gen_direct_drawing_table();
 
@@ -488,6 +488,7 @@ static void REGPARAM2 chipmem_lput2 (uaecptr addr, uae_u32 l)
 	if (ISEXEC (addr) || ISEXEC (addr + 1) || ISEXEC (addr + 2) || ISEXEC (addr + 3))
 		return;
 	do_put_mem_long (m, l);
+	MEMORY_DIRTY_MARK(chipmem_bank, addr, 4);
 }
 
 static void REGPARAM2 chipmem_wput2 (uaecptr addr, uae_u32 w)
@@ -507,6 +508,7 @@ static void REGPARAM2 chipmem_wput2 (uaecptr addr, uae_u32 w)
 	if (ISEXEC (addr) || ISEXEC (addr + 1))
 		return;
 	do_put_mem_word (m, w);
+	MEMORY_DIRTY_MARK(chipmem_bank, addr, 2);
 }
 
 static void REGPARAM2 chipmem_bput2 (uaecptr addr, uae_u32 b)
@@ -523,6 +525,7 @@ static void REGPARAM2 chipmem_bput2 (uaecptr addr, uae_u32 b)
 	if (ISEXEC (addr))
 		return;
 	chipmem_bank.baseaddr[addr] = b;
+	MEMORY_DIRTY_MARK(chipmem_bank, addr, 1);
 }
 
 static int REGPARAM2 chipmem_check2 (uaecptr addr, uae_u32 size)
@@ -21,6 +21,14 @@
 #include "x86.h"
 #include "audio.h"
 
+#ifdef FSUAE
+#include "fsemu-frame.h"
+#include "fsemu-time.h"
+extern int64_t is_syncline_end64;
+extern int64_t line_started_at;
+extern int64_t line_ended_at;
+#endif
+
 static const int pissoff_nojit_value = 256 * CYCLE_UNIT;
 
 unsigned long int event_cycles, nextevent, currcycle;
@@ -36,6 +44,50 @@ frame_time_t vsyncmaxtime, vsyncwaittime;
 int vsynctimebase;
 int event2_count;
 
+/* Bit n is set when eventtab2[n] may be active. Entries are only activated
+ * in event2_newevent_xx, which sets the bit, but are deactivated from many
+ * places by clearing .active directly, so stale bits are cleared lazily in
+ * MISC_handler. This lets MISC_handler visit only the (few) active entries
+ * instead of scanning all ev2_max entries, in the same index order. */
+static uae_u32 event2_active_mask;
+
+#ifdef FSUAE
+/* Set FS_DEBUG_EVENT_STATS=1 to log the number of dispatched events per
+ * second (eventtab and eventtab2 handlers). */
+static int event_stats_enabled = -1;
+static unsigned int event_stats_count;
+static unsigned int event2_stats_count;
+static int64_t event_stats_since;
+
+static void events_log_stats(void)
+{
+	if (event_stats_enabled < 0) {
+		event_stats_enabled = getenv("FS_DEBUG_EVENT_STATS") != NULL;
+	}
+	if (!event_stats_enabled) {
+		return;
+	}
+	int64_t now = fsemu_time_us();
+	if (event_stats_since) {
+		double secs = (now - event_stats_since) / 1000000.0;
+		write_log(_T("EVENTS: %.0f ev/s, %.0f ev2/s (%s)\n"),
+			event_stats_count / secs, event2_stats_count / secs,
+			currprefs.cpu_cycle_exact ? _T("cycle-exact") : _T("not cycle-exact"));
+	}
+	event_stats_since = now;
+	event_stats_count = 0;
+	event2_stats_count = 0;
+}
+
+#define EVENT_STATS_INTERVAL 0x3fffff
+#define EVENT_STATS_COUNT() \
+	if ((++event_stats_count & EVENT_STATS_INTERVAL) == 0) events_log_stats()
+#define EVENT2_STATS_COUNT() event2_stats_count++
+#else
+#define EVENT_STATS_COUNT()
+#define EVENT2_STATS_COUNT()
+#endif
+
 static void events_fast(void)
 {
 	cycles_do_special();
@@ -64,13 +116,6 @@ void events_schedule (void)
 
 extern int vsync_activeheight;
 
-#ifdef FSUAE
-#include "fsemu-frame.h"
-#include "fsemu-time.h"
-extern int64_t is_syncline_end64;
-extern int64_t line_started_at;
-extern int64_t line_ended_at;
-#endif
 
 static bool event_check_vsync(void)
 {
@@ -334,6 +379,7 @@ void do_cycles_slow (unsigned long cycles_to_add)
 					gui_message(_T("eventtab[%d].handler is null!\n"), i);
 					eventtab[i].active = 0;
 				} else {
+					EVENT_STATS_COUNT();
 					(*eventtab[i].handler)();
 				}
 			}
@@ -364,21 +410,30 @@ void MISC_handler (void)
 	while (recheck) {
 		recheck = false;
 		mintime = ~0L;
+		/* The mask is re-read for every entry, since handlers may activate
+		 * entries with a higher index which must still be seen this pass. */
 		for (i = 0; i < ev2_max; i++) {
-			if (eventtab2[i].active) {
-				if (eventtab2[i].evtime == ct) {
-					eventtab2[i].active = false;
-					event2_count--;
-					eventtab2[i].handler (eventtab2[i].data);
-					if (dorecheck || eventtab2[i].active) {
-						recheck = true;
-						dorecheck = false;
-					}
-				} else {
-					evt eventtime = eventtab2[i].evtime - ct;
-					if (eventtime < mintime)
-						mintime = eventtime;
+			uae_u32 mask = event2_active_mask >> i;
+			if (!mask)
+				break;
+			i += __builtin_ctz (mask);
+			if (!eventtab2[i].active) {
+				event2_active_mask &= ~(1u << i);
+				continue;
+			}
+			if (eventtab2[i].evtime == ct) {
+				eventtab2[i].active = false;
+				event2_count--;
+				EVENT2_STATS_COUNT();
+				eventtab2[i].handler (eventtab2[i].data);
+				if (dorecheck || eventtab2[i].active) {
+					recheck = true;
+					dorecheck = false;
 				}
+			} else {
+				evt eventtime = eventtab2[i].evtime - ct;
+				if (eventtime < mintime)
+					mintime = eventtime;
 			}
 		}
 	}
@@ -418,6 +473,7 @@ void event2_newevent_xx (int no, evt t, uae_u32 data, evfunc2 func)
 		next = no;
 	}
 	eventtab2[no].active = true;
+	event2_active_mask |= 1u << no;
 	eventtab2[no].evtime = et;
 	eventtab2[no].handler = func;
 	eventtab2[no].data = data;
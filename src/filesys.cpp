@@ -4136,6 +4136,7 @@ static void get_fileinfo(TrapContext *ctx, Unit *unit, dpacket *packet, uaecptr
 		buf = buf_array;
 	} else {
 		buf = get_real_address(info);
+		memory_dirty_mark_addr(info, (sizeof buf_array) - 36);
 	}
 
 	if (aino->vfso) {
@@ -5481,6 +5482,8 @@ static void	action_read(TrapContext *ctx, Unit *unit, dpacket *packet)
 			/* normal fast read */
 			uae_u8 *realpt = get_real_address (addr);
 			actual = fs_read (k->fd, realpt, size);
+			if (actual > 0)
+				memory_dirty_mark_addr (addr, actual);
 
 		}
 
@@ -7521,6 +7524,7 @@ static uae_u32 REGPARAM2 filesys_doio(TrapContext *ctx)
 				{
 					// trackdisk.device reading boot block
 					uae_u8 *d = get_real_address(data);
+					memory_dirty_mark_addr(data, 1024);
 					memset(d, 0, 1024);
 					memcpy(d, bootblock_ofs, sizeof bootblock_ofs);
 					trap_put_long(ctx, ioreq + 32, len); // io_Actual
@@ -706,9 +706,8 @@ void fs_uae_load_rom_files(const char *path)
         return;
     }
 
-    // we include the rom key when generating the cache name for the
-    // kickstart cache file, so the cache will be regenerated if rom.key
-    // is replaced or removed/added.
+    // we include the rom key checksum in the ROM index, so entries will be
+    // rescanned if rom.key is replaced or removed/added.
     char *key_path = g_build_filename(path, "rom.key", NULL);
     GChecksum *rom_checksum = g_checksum_new(G_CHECKSUM_MD5);
     FILE *f = g_fopen(key_path, "rb");
@@ -728,32 +727,29 @@ void fs_uae_load_rom_files(const char *path)
     g_free(key_path);
 
     amiga_add_key_dir(path);
+    GPtrArray *rom_paths = g_ptr_array_new_with_free_func(g_free);
     const char *name = g_dir_read_name(dir);
     while (name) {
         char *lname = g_utf8_strdown(name, -1);
         if (g_str_has_suffix(lname, ".rom") ||
             g_str_has_suffix(lname, ".bin")) {
             fsuae_log("found file \"%s\"\n", name);
-            char *full_path = g_build_filename(path, name, NULL);
-            // GChecksum *checksum = g_checksum_new(G_CHECKSUM_MD5);
-            GChecksum *checksum = g_checksum_copy(rom_checksum);
-            g_checksum_update(
-                checksum, (guchar *) full_path, strlen(full_path));
-            const gchar *cache_name = g_checksum_get_string(checksum);
-            char *cache_path = g_build_filename(
-                fsuae_path_kickstartcache_dir(), cache_name, NULL);
-            amiga_add_rom_file(full_path, cache_path);
-            g_free(full_path);
-            if (cache_path != NULL) {
-                free(cache_path);
-            }
-            g_checksum_free(checksum);
+            g_ptr_array_add(rom_paths, g_build_filename(path, name, NULL));
         }
         free(lname);
         name = g_dir_read_name(dir);
     }
     g_dir_close(dir);
 
+    char *index_path = g_build_filename(
+        fsuae_path_kickstartcache_dir(), "rom-index.dat", NULL);
+    amiga_add_rom_files((const char **) rom_paths->pdata,
+                        rom_paths->len,
+                        index_path,
+                        g_checksum_get_string(rom_checksum));
+    g_free(index_path);
+    g_ptr_array_free(rom_paths, TRUE);
+
     if (rom_checksum != NULL) {
         g_checksum_free(rom_checksum);
     }
@@ -808,6 +804,31 @@ static void on_init(void)
         amiga_set_save_state_compression(1);
     }
 
+    int zfile_cache_size = 64;
+    if (fs_config_get_int("zfile_cache_size") != FS_CONFIG_NONE) {
+        zfile_cache_size = fs_config_get_int("zfile_cache_size");
+    }
+    if (fs_config_true("zfile_cache_spill")) {
+        gchar *spill_dir = g_build_filename(
+            fsuae_path_cache_dir(), "Decoded", NULL);
+        amiga_set_zfile_cache((int64_t) zfile_cache_size * 1024 * 1024,
+                              spill_dir);
+        g_free(spill_dir);
+    } else {
+        amiga_set_zfile_cache((int64_t) zfile_cache_size * 1024 * 1024,
+                              NULL);
+    }
+
+    int hard_drive_cache_size = 4096;
+    if (fs_config_get_int("hard_drive_cache_size") != FS_CONFIG_NONE) {
+        hard_drive_cache_size = fs_config_get_int("hard_drive_cache_size");
+    }
+    int hard_drive_read_ahead = 4;
+    if (fs_config_get_int("hard_drive_read_ahead") != FS_CONFIG_NONE) {
+        hard_drive_read_ahead = fs_config_get_int("hard_drive_read_ahead");
+    }
+    amiga_set_hard_drive_cache(hard_drive_cache_size, hard_drive_read_ahead);
+
 #if 0
     if (fs_config_get_int("min_first_line_pal") != FS_CONFIG_NONE) {
         amiga_set_min_first_line(fs_config_get_int("min_first_line_pal"), 0);
@@ -1930,6 +1951,8 @@ int main(int argc, char *argv[])
 #ifdef FSUAE_LEGACY
     fs_emu_set_state_check_function(amiga_get_state_checksum);
     fs_emu_set_rand_check_function(amiga_get_rand_checksum);
+    fs_emu_set_netplay_rollback_functions(
+        amiga_rollback_save, amiga_rollback_load, amiga_rollback_max_frames());
     fs_emu_set_quit_function(quit_function);
 #endif
 
@@ -2013,6 +2036,15 @@ int main(int argc, char *argv[])
         fs_config_get_boolean(OPTION_DETERMINISTIC) == 1) {
         deterministic_mode = 1;
     }
+    if (fs_config_get_boolean(OPTION_BENCHMARK) == 1) {
+        // Benchmark runs must be reproducible, including the final state
+        // checksum in the benchmark report.
+        fsuae_log("benchmark mode, forcing deterministic mode\n");
+        deterministic_mode = 1;
+        if (fsemu) {
+            fsemu_frame_set_checksum_function(amiga_get_state_checksum);
+        }
+    }
     if (deterministic_mode) {
         amiga_set_deterministic_mode();
     }
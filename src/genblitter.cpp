@@ -20,6 +20,22 @@ static unsigned char blttbl[]= {
     0xaa, 0xb1, 0xca, 0xcc, 0xd8, 0xe2, 0xea, 0xf0, 0xfa, 0xfc
 };
 
+/* Minterms which also get SIMD line kernels: clear, copy, xor and cookie-cut */
+
+static unsigned char simdtbl[]= {
+    0x00, 0x3c, 0x5a, 0x6a, 0xaa, 0xca, 0xcc, 0xf0
+};
+
+struct simdisa {
+    const char *name, *vtype, *cond, *attr;
+    int lanes;
+};
+
+static struct simdisa simdisas[] = {
+    { "sse2", "blitter_v8", "BLITTER_SIMD", "", 8 },
+    { "avx2", "blitter_v16", "BLITTER_SIMD_AVX2", "BLITTER_SIMD_AVX2_TARGET ", 16 }
+};
+
 static void generate_include(void)
 {
     int minterm;
@@ -33,6 +49,102 @@ static void generate_include(void)
     printf("}\n");
 }
 
+/* The SIMD kernels only cover the middle words of a line, where the A mask
+   is 0xffff. blitter_simd_dofast () does the edge words and checks that the
+   channels do not overlap, so the delayed D write can be dropped here. */
+static void generate_simd_func(struct simdisa *isa, int mt, int desc)
+{
+    int active = blitops[mt].used;
+    int a_is_on = active & 1, b_is_on = active & 2, c_is_on = active & 4;
+    const char *v = isa->vtype;
+
+    printf("%sint blitsimd_%s%s_%x (uae_u8 *pa, uae_u8 *pb, uae_u8 *pc, uae_u8 *pd, int words, struct bltinfo *b, uae_u32 *total)\n",
+	   isa->attr, isa->name, desc ? "_desc" : "", mt);
+    printf("{\n");
+    printf("\t%s dstd, vzero = { 0 }, totald = vzero;\n", v);
+    printf("\tuae_u32 t = 0;\n");
+    printf("\tint i, k;\n");
+    if (a_is_on) {
+	printf("\tint ash = b->%s;\n", desc ? "blitdownashift" : "blitashift");
+	printf("\tuae_u16 ac = ash ? (uae_u16)((b->bltadat >> ash) | (b->bltadat << (16 - ash))) : b->bltadat;\n");
+	printf("\t%s srca = vzero + ac;\n", v);
+    }
+    if (b_is_on) {
+	printf("\tint bsh = b->%s;\n", desc ? "blitdownbshift" : "blitbshift");
+	printf("\t%s srcb = vzero + b->bltbhold;\n", v);
+    }
+    if (c_is_on)
+	printf("\t%s srcc = vzero + b->bltcdat;\n", v);
+    printf("\tfor (i = 0; i + %d <= words; i += %d) {\n", isa->lanes, isa->lanes);
+    if (desc)
+	printf("\t\tint o = -(i + %d) * 2;\n", isa->lanes - 1);
+    else
+	printf("\t\tint o = i * 2;\n");
+    if (a_is_on) {
+	printf("\t\tif (pa) {\n");
+	printf("\t\t\tsrca = BLITTER_SIMD_SWAP (*(%su *)(pa + o));\n", v);
+	printf("\t\t\tif (ash & 15)\n");
+	if (desc)
+	    printf("\t\t\t\tsrca = (BLITTER_SIMD_SWAP (*(%su *)(pa + o + 2)) >> ash) | (srca << (16 - ash));\n", v);
+	else
+	    printf("\t\t\t\tsrca = (srca >> ash) | (BLITTER_SIMD_SWAP (*(%su *)(pa + o - 2)) << (16 - ash));\n", v);
+	printf("\t\t}\n");
+    }
+    if (b_is_on) {
+	printf("\t\tif (pb) {\n");
+	printf("\t\t\tsrcb = BLITTER_SIMD_SWAP (*(%su *)(pb + o));\n", v);
+	printf("\t\t\tif (bsh & 15)\n");
+	if (desc)
+	    printf("\t\t\t\tsrcb = (BLITTER_SIMD_SWAP (*(%su *)(pb + o + 2)) >> bsh) | (srcb << (16 - bsh));\n", v);
+	else
+	    printf("\t\t\t\tsrcb = (srcb >> bsh) | (BLITTER_SIMD_SWAP (*(%su *)(pb + o - 2)) << (16 - bsh));\n", v);
+	printf("\t\t}\n");
+    }
+    if (c_is_on)
+	printf("\t\tif (pc) srcc = BLITTER_SIMD_SWAP (*(%su *)(pc + o));\n", v);
+    printf("\t\tdstd = vzero | (%s);\n", blitops[mt].s);
+    printf("\t\ttotald |= dstd;\n");
+    printf("\t\tif (pd) *(%su *)(pd + o) = BLITTER_SIMD_SWAP (dstd);\n", v);
+    printf("\t}\n");
+    printf("\tfor (k = 0; k < %d; k++)\n", isa->lanes);
+    printf("\t\tt |= totald[k];\n");
+    printf("\t*total |= t;\n");
+    printf("\treturn i;\n");
+    printf("}\n");
+}
+
+static void generate_simd(void)
+{
+    unsigned int i, j;
+
+    for (j = 0; j < sizeof(simdisas) / sizeof(simdisas[0]); j++) {
+	printf("\n#ifdef %s\n", simdisas[j].cond);
+	for (i = 0; i < sizeof(simdtbl); i++) {
+	    generate_simd_func(&simdisas[j], simdtbl[i], 0);
+	    generate_simd_func(&simdisas[j], simdtbl[i], 1);
+	}
+	printf("#endif\n");
+    }
+}
+
+static void generate_simd_table(const char *name, const char *suffix)
+{
+    unsigned int index = 0;
+    unsigned int i;
+
+    printf("blitter_simd_func * const blitfunc_simd_%s%s[256] = {\n", name, suffix);
+    for (i = 0; i < 256; i++) {
+	if (index < sizeof(simdtbl) && i == simdtbl[index]) {
+	    printf("blitsimd_%s%s_%x", name, suffix, i);
+	    index++;
+	}
+	else printf("0");
+	if (i < 255) printf(", ");
+	if ((i & 7) == 7) printf("\n");
+    }
+    printf("};\n");
+}
+
 static void generate_func(void)
 {
     unsigned int i;
@@ -133,6 +245,7 @@ static void generate_func(void)
 	printf("if (totald != 0) b->blitzero = 0;\n");
 	printf("}\n");
     }
+    generate_simd();
 }
 
 static void generate_table(void)
@@ -170,15 +283,30 @@ static void generate_table(void)
 	if ((i & 7) == 7) printf("\n");
     }
     printf("};\n");
+
+    for (i = 0; i < sizeof(simdisas) / sizeof(simdisas[0]); i++) {
+	printf("\n#ifdef %s\n", simdisas[i].cond);
+	generate_simd_table(simdisas[i].name, "");
+	generate_simd_table(simdisas[i].name, "_desc");
+	printf("#endif\n");
+    }
 }
 
 static void generate_header(void)
 {
-    unsigned int i;
+    unsigned int i, j;
     for (i = 0; i < sizeof(blttbl); i++) {
 	printf("extern blitter_func blitdofast_%x;\n",blttbl[i]);
 	printf("extern blitter_func blitdofast_desc_%x;\n",blttbl[i]);
     }
+    for (j = 0; j < sizeof(simdisas) / sizeof(simdisas[0]); j++) {
+	printf("#ifdef %s\n", simdisas[j].cond);
+	for (i = 0; i < sizeof(simdtbl); i++) {
+	    printf("extern blitter_simd_func blitsimd_%s_%x;\n", simdisas[j].name, simdtbl[i]);
+	    printf("extern blitter_simd_func blitsimd_%s_desc_%x;\n", simdisas[j].name, simdtbl[i]);
+	}
+	printf("#endif\n");
+    }
 }
 
 int main(int argc, char **argv)
@@ -591,6 +591,157 @@ static void out_linetoscr (DEPTH_T bpp, HMODE_T hmode, int aga, int spr, int gen
 	outln  (	"");
 }
 
+/* AVX2 variants of the 32-bit non-genlock functions. They convert eight
+ * source pixels per step with gathers from the colour tables and hand HAM,
+ * EHB, steps that contain sprite pixels and the line tail to the scalar
+ * function, so the output is always identical to it. */
+
+static int simd_hmode_ok (HMODE_T hmode)
+{
+	return hmode == HMODE_NORMAL || hmode == HMODE_DOUBLE || hmode == HMODE_DOUBLE2X
+		|| hmode == HMODE_HALVE1 || hmode == HMODE_HALVE2;
+}
+
+static void out_linetoscr_name (char *name, DEPTH_T bpp, HMODE_T hmode, int aga, int spr)
+{
+	sprintf (name, "%s%s%s%s", get_depth_str (bpp), get_hmode_str (hmode),
+		aga ? "_aga" : "", spr > 0 ? "_spr" : "");
+}
+
+static void out_linetoscr_avx2_mode (HMODE_T hmode, int aga, int spr, CMODE_T cmode, const char *name)
+{
+	int out = hmode == HMODE_DOUBLE ? 16 : hmode == HMODE_DOUBLE2X ? 32 : 8;
+	int step = hmode == HMODE_HALVE1 ? 16 : hmode == HMODE_HALVE2 ? 32 : 8;
+
+	if (aga && cmode == CMODE_DUALPF) {
+		outln (        "const int *lookup    = bpldualpfpri ? dblpf_ind2_aga : dblpf_ind1_aga;");
+		outln (        "const int *lookup_no = bpldualpfpri ? dblpf_2nd2     : dblpf_2nd1;");
+		outln (        "__m256i ofs = _mm256_set1_epi32 (dblpfofs[bpldualpf2of]);");
+	} else if (cmode == CMODE_DUALPF) {
+		outln (        "const int *lookup = bpldualpfpri ? dblpf_ind2 : dblpf_ind1;");
+	}
+	outlnf (	"while (dpix + %d <= dpix_end) {", out);
+	outln (		"    __m256i idx, col;");
+	if (spr) {
+		outlnf ("    if (!spritepixels_empty (dpix, %d)) {", out);
+		outlnf ("        spix = linetoscr_%s (spix, dpix, dpix + %d);", name, out);
+		outlnf ("        dpix += %d;", out);
+		outln ( "        continue;");
+		outln ( "    }");
+	}
+	if (hmode == HMODE_HALVE1)
+		outln ( "    idx = _mm256_and_si256 (_mm256_cvtepu16_epi32 (_mm_loadu_si128 ((const __m128i *) &pixdata.apixels[spix])), _mm256_set1_epi32 (0xff));");
+	else if (hmode == HMODE_HALVE2)
+		outln ( "    idx = _mm256_and_si256 (_mm256_loadu_si256 ((const __m256i *) &pixdata.apixels[spix]), _mm256_set1_epi32 (0xff));");
+	else
+		outln ( "    idx = _mm256_cvtepu8_epi32 (_mm_loadl_epi64 ((const __m128i *) &pixdata.apixels[spix]));");
+
+	if (aga && cmode == CMODE_DUALPF) {
+		outln ( "    {");
+		outln ( "        __m256i no = _mm256_i32gather_epi32 (lookup_no, idx, 4);");
+		outln ( "        __m256i add = _mm256_andnot_si256 (_mm256_cmpeq_epi32 (no, _mm256_setzero_si256 ()), ofs);");
+		outln ( "        idx = _mm256_add_epi32 (_mm256_i32gather_epi32 (lookup, idx, 4), add);");
+		outln ( "        idx = _mm256_xor_si256 (_mm256_and_si256 (idx, _mm256_set1_epi32 (0xff)), xor_val);");
+		outln ( "    }");
+	} else if (cmode == CMODE_DUALPF) {
+		outln ( "    idx = _mm256_i32gather_epi32 (lookup, idx, 4);");
+	} else if (aga) {
+		outln ( "    idx = _mm256_and_si256 (_mm256_xor_si256 (idx, xor_val), and_val);");
+	} else if (cmode == CMODE_EXTRAHB_ECS_KILLEHB) {
+		outln ( "    idx = _mm256_and_si256 (idx, _mm256_set1_epi32 (31));");
+	}
+	outln (		"    col = _mm256_i32gather_epi32 ((const int *) p_acolors, idx, 4);");
+
+	if (hmode == HMODE_DOUBLE) {
+		outln ( "    _mm256_storeu_si256 ((__m256i *) &buf[dpix + 0], _mm256_permutevar8x32_epi32 (col, _mm256_setr_epi32 (0, 0, 1, 1, 2, 2, 3, 3)));");
+		outln ( "    _mm256_storeu_si256 ((__m256i *) &buf[dpix + 8], _mm256_permutevar8x32_epi32 (col, _mm256_setr_epi32 (4, 4, 5, 5, 6, 6, 7, 7)));");
+	} else if (hmode == HMODE_DOUBLE2X) {
+		outln ( "    _mm256_storeu_si256 ((__m256i *) &buf[dpix + 0], _mm256_permutevar8x32_epi32 (col, _mm256_setr_epi32 (0, 0, 0, 0, 1, 1, 1, 1)));");
+		outln ( "    _mm256_storeu_si256 ((__m256i *) &buf[dpix + 8], _mm256_permutevar8x32_epi32 (col, _mm256_setr_epi32 (2, 2, 2, 2, 3, 3, 3, 3)));");
+		outln ( "    _mm256_storeu_si256 ((__m256i *) &buf[dpix + 16], _mm256_permutevar8x32_epi32 (col, _mm256_setr_epi32 (4, 4, 4, 4, 5, 5, 5, 5)));");
+		outln ( "    _mm256_storeu_si256 ((__m256i *) &buf[dpix + 24], _mm256_permutevar8x32_epi32 (col, _mm256_setr_epi32 (6, 6, 6, 6, 7, 7, 7, 7)));");
+	} else {
+		outln ( "    _mm256_storeu_si256 ((__m256i *) &buf[dpix], col);");
+	}
+	outlnf (	"    spix += %d;", step);
+	outlnf (	"    dpix += %d;", out);
+	outln (		"}");
+}
+
+static void out_linetoscr_avx2 (DEPTH_T bpp, HMODE_T hmode, int aga, int spr)
+{
+	char name[64];
+
+	out_linetoscr_name (name, bpp, hmode, aga, spr);
+	if (aga)
+		outln  ("#ifdef AGA");
+	outlnf ("static int NOINLINE LINETOSCR_AVX2_TARGET linetoscr_%s_avx2(int spix, int dpix, int dpix_end)", name);
+	outln  (	"{");
+	outln  (	"    uae_u32 *buf = (uae_u32 *) xlinebuffer;");
+	if (aga) {
+		outln ( "    __m256i xor_val = _mm256_set1_epi32 (bplxor);");
+		outln ( "    __m256i and_val = _mm256_set1_epi32 (bpland);");
+	}
+	outln  (	"");
+	outln  (	"    switch(bplmode)");
+	outln  (	"    {");
+	outln  (	"    case CMODE_NORMAL:");
+	outln  (	"    {");
+	set_indent (8);
+	out_linetoscr_avx2_mode (hmode, aga, spr, CMODE_NORMAL, name);
+	set_indent (0);
+	outln  (	"    }");
+	outln  (	"    break;");
+	outln  (	"    case CMODE_DUALPF:");
+	outln  (	"    {");
+	set_indent (8);
+	out_linetoscr_avx2_mode (hmode, aga, spr, CMODE_DUALPF, name);
+	set_indent (0);
+	outln  (	"    }");
+	outln  (	"    break;");
+	if (!aga) {
+		outln  ("    case CMODE_EXTRAHB_ECS_KILLEHB:");
+		outln  ("    {");
+		set_indent (8);
+		out_linetoscr_avx2_mode (hmode, aga, spr, CMODE_EXTRAHB_ECS_KILLEHB, name);
+		set_indent (0);
+		outln  ("    }");
+		outln  ("    break;");
+	}
+	outln  (	"    }");
+	outln  (	"");
+	outlnf (	"    return linetoscr_%s (spix, dpix, dpix_end);", name);
+	outln  (	"}");
+	if (aga)
+		outln (	"#endif");
+	outln  (	"");
+}
+
+static void out_linetoscr_avx2_table (void)
+{
+	char name[64];
+	int aga, spr;
+	HMODE_T hmode;
+
+	outln  ("static const struct linetoscr_simd linetoscr_avx2_table[] = {");
+	for (aga = 0; aga <= 1 ; aga++) {
+		if (aga)
+			outln  ("#ifdef AGA");
+		for (spr = 0; spr <= 1; spr++) {
+			for (hmode = HMODE_NORMAL; hmode <= HMODE_MAX; hmode++) {
+				if (!simd_hmode_ok (hmode))
+					continue;
+				out_linetoscr_name (name, DEPTH_32BPP, hmode, aga, spr);
+				outlnf ("    { linetoscr_%s, linetoscr_%s_avx2, \"%s\" },", name, name, name);
+			}
+		}
+		if (aga)
+			outln  ("#endif");
+	}
+	outln  ("    { NULL, NULL, NULL }");
+	outln  ("};");
+}
+
 int main (int argc, char *argv[])
 {
 	DEPTH_T bpp;
@@ -630,5 +781,21 @@ int main (int argc, char *argv[])
 			}
 		}
 	}
+
+	if (!do_bigendian) {
+		outln ("#ifdef LINETOSCR_AVX2");
+		outln ("");
+		for (aga = 0; aga <= 1 ; aga++) {
+			for (spr = 0; spr <= 1; spr++) {
+				for (hmode = HMODE_NORMAL; hmode <= HMODE_MAX; hmode++) {
+					if (simd_hmode_ok (hmode))
+						out_linetoscr_avx2 (DEPTH_32BPP, hmode, aga, spr);
+				}
+			}
+		}
+		out_linetoscr_avx2_table ();
+		outln ("");
+		outln ("#endif /* LINETOSCR_AVX2 */");
+	}
 	return 0;
 }
@@ -802,6 +802,11 @@ void qemu_console_resize(QemuConsole *con, int width, int height)
 
 void linear_memory_region_set_dirty(MemoryRegion *mr, hwaddr addr, hwaddr size)
 {
+	struct rtggfxboard *gb = (struct rtggfxboard*)mr->data;
+	if (!gb || !gb->gfxmem_bank)
+		return;
+	// dirty pages are indexed relative to gb->vram, like addr
+	memory_dirty_mark_range(gb->gfxmem_bank, addr, size);
 }
 
 void vga_memory_region_set_dirty(MemoryRegion *mr, hwaddr addr, hwaddr size)
@@ -1600,6 +1605,7 @@ static void gfxboard_lput_vram (struct rtggfxboard *gb, uaecptr addr, uae_u32 l,
 		} else {
 			do_put_mem_long ((uae_u32*) m, l);
 		}
+		memory_dirty_mark_range(gb->gfxmem_bank, addr, 4);
 	}
 }
 static void gfxboard_wput_vram (struct rtggfxboard *gb, uaecptr addr, uae_u16 w, int bs)
@@ -1630,6 +1636,7 @@ static void gfxboard_wput_vram (struct rtggfxboard *gb, uaecptr addr, uae_u16 w,
 			*((uae_u16*)m) = w;
 		else
 			do_put_mem_word ((uae_u16*)m, w);
+		memory_dirty_mark_range(gb->gfxmem_bank, addr, 2);
 	}
 }
 static void gfxboard_bput_vram (struct rtggfxboard *gb, uaecptr addr, uae_u8 b, int bs)
@@ -1659,6 +1666,7 @@ static void gfxboard_bput_vram (struct rtggfxboard *gb, uaecptr addr, uae_u8 b,
 			gb->vram[addr ^ 1] = b;
 		else
 			gb->vram[addr] = b;
+		memory_dirty_mark_range(gb->gfxmem_bank, addr, 1);
 	}
 }
 
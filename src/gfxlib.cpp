@@ -1215,6 +1215,7 @@ static uniq_list MyLayerInfo_list = UNIQ_INIT;
 static void LY_InitLayers(uaecptr li)
 {
     memset (get_real_address (li), 0, 92);
+    memory_dirty_mark_addr (li, 92);
     put_long (li + 0, 0); /* top layer */
     put_long (li+84, 0); /* uniq: */
     m68k_areg (regs, 0) = li + 24; CallLib (get_long (4), -558); /* InitSemaphore() */
@@ -1368,6 +1369,7 @@ static struct MyLayer *LY_NewLayer(struct MyLayerInfo *mli, int x0, int x1, int
     struct MyLayer *l = (struct MyLayer *)malloc(sizeof (struct MyLayer));
     uaecptr layer = amiga_malloc(LAYER_SIZE);
     memset (get_real_address (layer), 0, LAYER_SIZE);
+    memory_dirty_mark_addr (layer, LAYER_SIZE);
     l->amigaos_layer = layer;
 
     put_word (layer + 16, x0); /* bounds */
@@ -1286,6 +1286,7 @@ static uae_u64 cmd_read(TrapContext *ctx, struct hardfiledata *hfd, uaecptr data
 			return 0;
 		if (bank_data->check(dataptr, len)) {
 			uae_u8 *buffer = bank_data->xlateaddr(dataptr);
+			memory_dirty_mark_addr(dataptr, len);
 			return cmd_readx(hfd, buffer, offset, len);
 		}
 	}
@@ -48,6 +48,7 @@ void audio_deactivate (void);
 void audio_vsync (void);
 void audio_sampleripper(int);
 void write_wavheader (struct zfile *wavfile, uae_u32 size, uae_u32 freq);
+void audio_sinc_benchmark(void);
 
 int audio_is_pull(void);
 int audio_pull_buffer(void);
@@ -62,6 +62,30 @@ extern blitter_func * const blitfunc_dofast[256];
 extern blitter_func * const blitfunc_dofast_desc[256];
 extern uae_u32 blit_masktable[BLITTER_MAX_WORDS];
 
+#if defined(__GNUC__) && defined(__SSE2__) && !defined(WORDS_BIGENDIAN)
+/* Line kernels for the common minterms, generated by genblitter. They work
+   on host chip RAM pointers and return the number of words done. */
+#define BLITTER_SIMD 1
+typedef uae_u16 blitter_v8 __attribute__ ((vector_size (16)));
+typedef uae_u16 blitter_v8u __attribute__ ((vector_size (16), aligned (2), may_alias));
+#if defined(__x86_64__) && (defined(__clang__) || __GNUC__ >= 5)
+#define BLITTER_SIMD_AVX2 1
+#define BLITTER_SIMD_AVX2_TARGET __attribute__ ((target ("avx2")))
+typedef uae_u16 blitter_v16 __attribute__ ((vector_size (32)));
+typedef uae_u16 blitter_v16u __attribute__ ((vector_size (32), aligned (2), may_alias));
+#endif
+#define BLITTER_SIMD_SWAP(v) (((v) << 8) | ((v) >> 8))
+
+typedef int blitter_simd_func(uae_u8 *, uae_u8 *, uae_u8 *, uae_u8 *, int, struct bltinfo *, uae_u32 *);
+
+extern blitter_simd_func * const blitfunc_simd_sse2[256];
+extern blitter_simd_func * const blitfunc_simd_sse2_desc[256];
+#ifdef BLITTER_SIMD_AVX2
+extern blitter_simd_func * const blitfunc_simd_avx2[256];
+extern blitter_simd_func * const blitfunc_simd_avx2_desc[256];
+#endif
+#endif
+
 #define BLIT_MODE_IMMEDIATE -1
 #define BLIT_MODE_APPROXIMATE 0
 #define BLIT_MODE_COMPATIBLE 1
@@ -37,8 +37,6 @@
 #define MMU_IPAGECACHE 1
 #define MMU_DPAGECACHE 1
 
-#define CACHE_HIT_COUNT 0
-
 #include "mmu_common.h"
 
 #ifndef FULLMMU
@@ -71,6 +69,7 @@ extern uae_u8 mmu_cache_state;
 extern uae_u8 cache_default_ins, cache_default_data;
 
 extern void mmu_dump_tables(void);
+extern void mmu_cache_hit_count_reset(void);
 
 #define MMU_TTR_LOGICAL_BASE				0xff000000
 #define MMU_TTR_LOGICAL_MASK				0x00ff0000
@@ -247,7 +246,10 @@ extern uae_u8 atc_last_ins_cache;
 #endif
 
 #if MMU_DPAGECACHE
-#define MMUFASTCACHE_ENTRIES 256
+/* Direct mapped, indexed by (page, S). Much larger than the real ATC
+ * since it is only a shortcut in front of it, entries are dropped on
+ * ATC fills and flushes like before. */
+#define MMUFASTCACHE_ENTRIES 4096
 struct mmufastcache
 {
 	uae_u32 log;
@@ -258,11 +260,11 @@ extern struct mmufastcache atc_data_cache_read[MMUFASTCACHE_ENTRIES];
 extern struct mmufastcache atc_data_cache_write[MMUFASTCACHE_ENTRIES];
 #endif
 
-#if CACHE_HIT_COUNT
-extern int mmu_ins_hit, mmu_ins_miss;
-extern int mmu_data_read_hit, mmu_data_read_miss;
-extern int mmu_data_write_hit, mmu_data_write_miss;
-#endif
+/* Shortcut cache hit counters, off unless enabled with "mmud c". */
+extern bool mmu_cache_hit_count;
+extern uae_u32 mmu_ins_hit, mmu_ins_miss;
+extern uae_u32 mmu_data_read_hit, mmu_data_read_miss;
+extern uae_u32 mmu_data_write_hit, mmu_data_write_miss;
 
 static ALWAYS_INLINE uae_u32 mmu_get_ilong(uaecptr addr, int size)
 {
@@ -270,15 +272,13 @@ static ALWAYS_INLINE uae_u32 mmu_get_ilong(uaecptr addr, int size)
 	if ((!mmu_ttr_enabled_ins || mmu_match_ttr_ins(addr,regs.s!=0) == TTR_NO_MATCH) && regs.mmu_enabled) {
 #if MMU_IPAGECACHE
 		if (((addr & mmu_pagemaski) | regs.s) == atc_last_ins_laddr) {
-#if CACHE_HIT_COUNT
-			mmu_ins_hit++;
-#endif
+			if (mmu_cache_hit_count)
+				mmu_ins_hit++;
 			addr = atc_last_ins_paddr | (addr & mmu_pagemask);
 			mmu_cache_state = atc_last_ins_cache;
 		} else {
-#if CACHE_HIT_COUNT
-			mmu_ins_miss++;
-#endif
+			if (mmu_cache_hit_count)
+				mmu_ins_miss++;
 #endif
 			addr = mmu_translate(addr, 0, regs.s!=0, false, false, size);
 #if MMU_IPAGECACHE
@@ -294,15 +294,13 @@ static ALWAYS_INLINE uae_u16 mmu_get_iword(uaecptr addr, int size)
 	if ((!mmu_ttr_enabled_ins || mmu_match_ttr_ins(addr,regs.s!=0) == TTR_NO_MATCH) && regs.mmu_enabled) {
 #if MMU_IPAGECACHE
 		if (((addr & mmu_pagemaski) | regs.s) == atc_last_ins_laddr) {
-#if CACHE_HIT_COUNT
-			mmu_ins_hit++;
-#endif
+			if (mmu_cache_hit_count)
+				mmu_ins_hit++;
 			addr = atc_last_ins_paddr | (addr & mmu_pagemask);
 			mmu_cache_state = atc_last_ins_cache;
 		} else {
-#if CACHE_HIT_COUNT
-			mmu_ins_miss++;
-#endif
+			if (mmu_cache_hit_count)
+				mmu_ins_miss++;
 #endif
 			addr = mmu_translate(addr, 0, regs.s!=0, false, false, size);
 #if MMU_IPAGECACHE
@@ -323,13 +321,11 @@ static ALWAYS_INLINE uae_u32 mmu_get_long(uaecptr addr, bool data, int size)
 		if (atc_data_cache_read[idx2].log == idx1) {
 			addr = atc_data_cache_read[idx2].phys | (addr & mmu_pagemask);
 			mmu_cache_state = atc_data_cache_read[idx2].cache_state;
-#if CACHE_HIT_COUNT
-			mmu_data_read_hit++;
-#endif
+			if (mmu_cache_hit_count)
+				mmu_data_read_hit++;
 		} else {
-#if CACHE_HIT_COUNT
-			mmu_data_read_miss++;
-#endif
+			if (mmu_cache_hit_count)
+				mmu_data_read_miss++;
 #endif
 			addr = mmu_translate(addr, 0, regs.s!=0, data, false, size);
 #if MMU_DPAGECACHE
@@ -349,13 +345,11 @@ static ALWAYS_INLINE uae_u16 mmu_get_word(uaecptr addr, bool data, int size)
 		if (atc_data_cache_read[idx2].log == idx1) {
 			addr = atc_data_cache_read[idx2].phys | (addr & mmu_pagemask);
 			mmu_cache_state = atc_data_cache_read[idx2].cache_state;
-#if CACHE_HIT_COUNT
-			mmu_data_read_hit++;
-#endif
+			if (mmu_cache_hit_count)
+				mmu_data_read_hit++;
 		} else {
-#if CACHE_HIT_COUNT
-			mmu_data_read_miss++;
-#endif
+			if (mmu_cache_hit_count)
+				mmu_data_read_miss++;
 #endif
 			addr = mmu_translate(addr, 0, regs.s!=0, data, false, size);
 #if MMU_DPAGECACHE
@@ -375,13 +369,11 @@ static ALWAYS_INLINE uae_u8 mmu_get_byte(uaecptr addr, bool data, int size)
 		if (atc_data_cache_read[idx2].log == idx1) {
 			addr = atc_data_cache_read[idx2].phys | (addr & mmu_pagemask);
 			mmu_cache_state = atc_data_cache_read[idx2].cache_state;
-#if CACHE_HIT_COUNT
-			mmu_data_read_hit++;
-#endif
+			if (mmu_cache_hit_count)
+				mmu_data_read_hit++;
 		} else {
-#if CACHE_HIT_COUNT
-			mmu_data_read_miss++;
-#endif
+			if (mmu_cache_hit_count)
+				mmu_data_read_miss++;
 #endif
 			addr = mmu_translate(addr, 0, regs.s!=0, data, false, size);
 #if MMU_DPAGECACHE
@@ -401,13 +393,11 @@ static ALWAYS_INLINE void mmu_put_long(uaecptr addr, uae_u32 val, bool data, int
 		if (atc_data_cache_write[idx2].log == idx1) {
 			addr = atc_data_cache_write[idx2].phys | (addr & mmu_pagemask);
 			mmu_cache_state = atc_data_cache_read[idx2].cache_state;
-#if CACHE_HIT_COUNT
-			mmu_data_write_hit++;
-#endif
+			if (mmu_cache_hit_count)
+				mmu_data_write_hit++;
 		} else {
-#if CACHE_HIT_COUNT
-			mmu_data_write_miss++;
-#endif
+			if (mmu_cache_hit_count)
+				mmu_data_write_miss++;
 #endif
 			addr = mmu_translate(addr, val, regs.s!=0, data, true, size);
 #if MMU_DPAGECACHE
@@ -427,13 +417,11 @@ static ALWAYS_INLINE void mmu_put_word(uaecptr addr, uae_u16 val, bool data, int
 		if (atc_data_cache_write[idx2].log == idx1) {
 			addr = atc_data_cache_write[idx2].phys | (addr & mmu_pagemask);
 			mmu_cache_state = atc_data_cache_read[idx2].cache_state;
-#if CACHE_HIT_COUNT
-			mmu_data_write_hit++;
-#endif
+			if (mmu_cache_hit_count)
+				mmu_data_write_hit++;
 		} else {
-#if CACHE_HIT_COUNT
-			mmu_data_write_miss++;
-#endif
+			if (mmu_cache_hit_count)
+				mmu_data_write_miss++;
 #endif
 			addr = mmu_translate(addr, val, regs.s!=0, data, true, size);
 #if MMU_DPAGECACHE
@@ -453,13 +441,11 @@ static ALWAYS_INLINE void mmu_put_byte(uaecptr addr, uae_u8 val, bool data, int
 		if (atc_data_cache_write[idx2].log == idx1) {
 			addr = atc_data_cache_write[idx2].phys | (addr & mmu_pagemask);
 			mmu_cache_state = atc_data_cache_read[idx2].cache_state;
-#if CACHE_HIT_COUNT
-			mmu_data_write_hit++;
-#endif
+			if (mmu_cache_hit_count)
+				mmu_data_write_hit++;
 		} else {
-#if CACHE_HIT_COUNT
-			mmu_data_write_miss++;
-#endif
+			if (mmu_cache_hit_count)
+				mmu_data_write_miss++;
 #endif
 			addr = mmu_translate(addr, val, regs.s!=0, data, true, size);
 #if MMU_DPAGECACHE
@@ -479,13 +465,11 @@ static ALWAYS_INLINE uae_u32 mmu_get_user_long(uaecptr addr, bool super, bool wr
 		if (atc_data_cache_read[idx2].log == idx1) {
 			addr = atc_data_cache_read[idx2].phys | (addr & mmu_pagemask);
 			mmu_cache_state = atc_data_cache_read[idx2].cache_state;
-#if CACHE_HIT_COUNT
-			mmu_data_read_hit++;
-#endif
+			if (mmu_cache_hit_count)
+				mmu_data_read_hit++;
 		} else {
-#if CACHE_HIT_COUNT
-			mmu_data_read_miss++;
-#endif
+			if (mmu_cache_hit_count)
+				mmu_data_read_miss++;
 #endif
 			addr = mmu_translate(addr, 0, super, true, write, size);
 #if MMU_DPAGECACHE
@@ -507,13 +491,11 @@ static ALWAYS_INLINE uae_u16 mmu_get_user_word(uaecptr addr, bool super, bool wr
 		if (atc_data_cache_read[idx2].log == idx1) {
 			addr = atc_data_cache_read[idx2].phys | (addr & mmu_pagemask);
 			mmu_cache_state = atc_data_cache_read[idx2].cache_state;
-#if CACHE_HIT_COUNT
-			mmu_data_read_hit++;
-#endif
+			if (mmu_cache_hit_count)
+				mmu_data_read_hit++;
 		} else {
-#if CACHE_HIT_COUNT
-			mmu_data_read_miss++;
-#endif
+			if (mmu_cache_hit_count)
+				mmu_data_read_miss++;
 #endif
 			addr = mmu_translate(addr, 0, super, true, write, size);
 #if MMU_DPAGECACHE
@@ -535,13 +517,11 @@ static ALWAYS_INLINE uae_u8 mmu_get_user_byte(uaecptr addr, bool super, bool wri
 		if (atc_data_cache_read[idx2].log == idx1) {
 			addr = atc_data_cache_read[idx2].phys | (addr & mmu_pagemask);
 			mmu_cache_state = atc_data_cache_read[idx2].cache_state;
-#if CACHE_HIT_COUNT
-			mmu_data_read_hit++;
-#endif
+			if (mmu_cache_hit_count)
+				mmu_data_read_hit++;
 		} else {
-#if CACHE_HIT_COUNT
-			mmu_data_read_miss++;
-#endif
+			if (mmu_cache_hit_count)
+				mmu_data_read_miss++;
 #endif
 			addr = mmu_translate(addr, 0, super, true, write, size);
 #if MMU_DPAGECACHE
@@ -563,13 +543,11 @@ static ALWAYS_INLINE void mmu_put_user_long(uaecptr addr, uae_u32 val, bool supe
 		if (atc_data_cache_write[idx2].log == idx1) {
 			addr = atc_data_cache_write[idx2].phys | (addr & mmu_pagemask);
 			mmu_cache_state = atc_data_cache_read[idx2].cache_state;
-#if CACHE_HIT_COUNT
-			mmu_data_write_hit++;
-#endif
+			if (mmu_cache_hit_count)
+				mmu_data_write_hit++;
 		} else {
-#if CACHE_HIT_COUNT
-			mmu_data_write_miss++;
-#endif
+			if (mmu_cache_hit_count)
+				mmu_data_write_miss++;
 #endif
 			addr = mmu_translate(addr, val, super, true, true, size);
 #if MMU_DPAGECACHE
@@ -591,13 +569,11 @@ static ALWAYS_INLINE void mmu_put_user_word(uaecptr addr, uae_u16 val, bool supe
 		if (atc_data_cache_write[idx2].log == idx1) {
 			addr = atc_data_cache_write[idx2].phys | (addr & mmu_pagemask);
 			mmu_cache_state = atc_data_cache_read[idx2].cache_state;
-#if CACHE_HIT_COUNT
-			mmu_data_write_hit++;
-#endif
+			if (mmu_cache_hit_count)
+				mmu_data_write_hit++;
 		} else {
-#if CACHE_HIT_COUNT
-			mmu_data_write_miss++;
-#endif
+			if (mmu_cache_hit_count)
+				mmu_data_write_miss++;
 #endif
 			addr = mmu_translate(addr, val, super, true, true, size);
 #if MMU_DPAGECACHE
@@ -619,13 +595,11 @@ static ALWAYS_INLINE void mmu_put_user_byte(uaecptr addr, uae_u8 val, bool super
 		if (atc_data_cache_write[idx2].log == idx1) {
 			addr = atc_data_cache_write[idx2].phys | (addr & mmu_pagemask);
 			mmu_cache_state = atc_data_cache_read[idx2].cache_state;
-#if CACHE_HIT_COUNT
-			mmu_data_write_hit++;
-#endif
+			if (mmu_cache_hit_count)
+				mmu_data_write_hit++;
 		} else {
-#if CACHE_HIT_COUNT
-			mmu_data_write_miss++;
-#endif
+			if (mmu_cache_hit_count)
+				mmu_data_write_miss++;
 #endif
 			addr = mmu_translate(addr, val, super, true, true, size);
 #if MMU_DPAGECACHE
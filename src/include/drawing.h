@@ -338,6 +338,7 @@ void draw_remaining_lines(void);
 extern void init_hardware_for_drawing_frame (void);
 extern void reset_drawing (void);
 extern void drawing_init (void);
+extern void drawing_free (void);
 extern bool notice_interlace_seen (bool);
 extern void notice_resolution_seen (int, bool);
 extern bool frame_drawn (int monid);
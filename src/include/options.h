@@ -121,6 +121,7 @@ struct jport {
 #define KBTYPE_PC2 2
 
 #define MAX_SPARE_DRIVES 20
+#define MAX_RENDER_THREADS 8
 #define MAX_CUSTOM_MEMORY_ADDRS 2
 
 #define CONFIG_TYPE_ALL -1
@@ -563,6 +564,7 @@ struct uae_prefs {
 	bool lightpen_crosshair;
 	int lightpen_offset[2];
 	int gfx_display_sections;
+	int gfx_render_threads;
 	int gfx_variable_sync;
 	bool gfx_windowed_resize;
 
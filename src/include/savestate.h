@@ -249,6 +249,7 @@ extern bool savestate_check (void);
 #define STATE_DORESTORE 8
 #define STATE_REWIND 16
 #define STATE_DOREWIND 32
+#define STATE_ROLLBACK 64
 
 extern int savestate_state;
 extern TCHAR savestate_fname[MAX_DPATH];
@@ -257,7 +258,7 @@ extern struct zfile *savestate_file;
 STATIC_INLINE bool isrestore (void)
 {
 #ifdef SAVESTATE
-	return savestate_state == STATE_RESTORE || savestate_state == STATE_REWIND;
+	return savestate_state == STATE_RESTORE || savestate_state == STATE_REWIND || savestate_state == STATE_ROLLBACK;
 #else
 	return false;
 #endif
@@ -274,4 +275,9 @@ extern void savestate_listrewind (void);
 extern void statefile_save_recording (const TCHAR*);
 extern void savestate_capture_request (void);
 
+extern int savestate_rollback_max_frames (void);
+extern void savestate_rollback_capture_request (int frame);
+extern bool savestate_rollback_restore_request (int frame);
+extern void savestate_rollback_restore (void);
+
 #endif /* UAE_SAVESTATE_H */
@@ -148,8 +148,35 @@ typedef struct {
 	uae_u8 *baseaddr_direct_r;
 	uae_u8 *baseaddr_direct_w;
 	uae_u32 startaccessmask;
+	/* non-NULL if writes are tracked, one entry per MEMORY_DIRTY_PAGE_SIZE */
+	uae_u8 *dirty_pages;
+	uae_u32 dirty_pages_num;
 } addrbank;
 
+/* Page-granular RAM write tracking. Write handlers of a tracked bank set
+ * all bits of the page entry, each consumer clears only its own bit. */
+#define MEMORY_DIRTY_PAGE_SHIFT 12
+#define MEMORY_DIRTY_PAGE_SIZE (1 << MEMORY_DIRTY_PAGE_SHIFT)
+#define MEMORY_DIRTY_REWIND 0x01
+#define MEMORY_DIRTY_CHECKSUM 0x02
+#define MEMORY_DIRTY_ROLLBACK 0x04
+#define MEMORY_DIRTY_RTG 0x08
+#define MEMORY_DIRTY_ALL 0xff
+
+#define MEMORY_DIRTY_MARK(ab, addr, size) \
+do { \
+	if ((ab).dirty_pages) { \
+		(ab).dirty_pages[(addr) >> MEMORY_DIRTY_PAGE_SHIFT] = MEMORY_DIRTY_ALL; \
+		(ab).dirty_pages[((addr) + (size) - 1) >> MEMORY_DIRTY_PAGE_SHIFT] = MEMORY_DIRTY_ALL; \
+	} \
+} while (0)
+
+extern void memory_dirty_enable(addrbank *ab);
+extern void memory_dirty_free(addrbank *ab);
+extern void memory_dirty_mark_range(addrbank *ab, uae_u32 offset, uae_u32 size);
+extern void memory_dirty_mark_addr(uaecptr addr, uae_u32 size);
+extern bool memory_dirty_reliable(void);
+
 #define MEMORY_MIN_SUBBANK 1024
 struct addrbank_sub
 {
@@ -261,6 +288,7 @@ static void REGPARAM2 name ## _lput (uaecptr addr, uae_u32 l) \
 	addr &= name ## _bank.mask; \
 	m = name ## _bank.baseaddr + addr; \
 	do_put_mem_long ((uae_u32 *)m, l); \
+	MEMORY_DIRTY_MARK(name ## _bank, addr, 4); \
 }
 #define MEMORY_WPUT(name) \
 static void REGPARAM3 name ## _wput (uaecptr, uae_u32) REGPARAM; \
@@ -271,6 +299,7 @@ static void REGPARAM2 name ## _wput (uaecptr addr, uae_u32 w) \
 	addr &= name ## _bank.mask; \
 	m = name ## _bank.baseaddr + addr; \
 	do_put_mem_word ((uae_u16 *)m, w); \
+	MEMORY_DIRTY_MARK(name ## _bank, addr, 2); \
 }
 #define MEMORY_BPUT(name) \
 static void REGPARAM3 name ## _bput (uaecptr, uae_u32) REGPARAM; \
@@ -279,6 +308,7 @@ static void REGPARAM2 name ## _bput (uaecptr addr, uae_u32 b) \
 	addr -= name ## _bank.startaccessmask; \
 	addr &= name ## _bank.mask; \
 	name ## _bank.baseaddr[addr] = b; \
+	MEMORY_DIRTY_MARK(name ## _bank, addr, 1); \
 }
 #define MEMORY_CHECK(name) \
 static int REGPARAM3 name ## _check (uaecptr addr, uae_u32 size) REGPARAM; \
@@ -369,6 +399,7 @@ static void REGPARAM2 name ## index ## _lput (uaecptr addr, uae_u32 l) \
 	addr &= name ## _bank[index].mask; \
 	m = name ## _bank[index].baseaddr + addr; \
 	do_put_mem_long ((uae_u32 *)m, l); \
+	MEMORY_DIRTY_MARK(name ## _bank[index], addr, 4); \
 }
 #define MEMORY_ARRAY_WPUT(name, index) \
 static void REGPARAM3 name ## index ## _wput (uaecptr, uae_u32) REGPARAM; \
@@ -379,6 +410,7 @@ static void REGPARAM2 name ## index ## _wput (uaecptr addr, uae_u32 w) \
 	addr &= name ## _bank[index].mask; \
 	m = name ## _bank[index].baseaddr + addr; \
 	do_put_mem_word ((uae_u16 *)m, w); \
+	MEMORY_DIRTY_MARK(name ## _bank[index], addr, 2); \
 }
 #define MEMORY_ARRAY_BPUT(name, index) \
 static void REGPARAM3 name ## index ## _bput (uaecptr, uae_u32) REGPARAM; \
@@ -387,6 +419,7 @@ static void REGPARAM2 name ## index ## _bput (uaecptr addr, uae_u32 b) \
 	addr -= name ## _bank[index].startaccessmask; \
 	addr &= name ## _bank[index].mask; \
 	name ## _bank[index].baseaddr[addr] = b; \
+	MEMORY_DIRTY_MARK(name ## _bank[index], addr, 1); \
 }
 #define MEMORY_ARRAY_CHECK(name, index) \
 static int REGPARAM3 name ## index ## _check (uaecptr addr, uae_u32 size) REGPARAM; \
@@ -494,6 +527,22 @@ extern addrbank *get_sub_bank(uaecptr *addr);
 
 extern addrbank *mem_banks[MEMORY_BANKS];
 
+/* Host address of each 64 KB bank if reads can bypass the bank handlers
+ * (see baseaddr_direct_r), NULL otherwise. */
+extern uae_u8 *mem_banks_direct_r[MEMORY_BANKS];
+
+STATIC_INLINE void set_mem_bank_direct(uaecptr addr, addrbank *b)
+{
+	uae_u8 *p = NULL;
+	if (b->baseaddr_direct_r && b->mask >= 0xffff && !(b->mask & (b->mask + 1))) {
+		uae_u32 offset = (addr - b->startaccessmask) & b->mask;
+		if (!(offset & 0xffff))
+			p = b->baseaddr_direct_r + offset;
+	}
+	mem_banks_direct_r[bankindex(addr)] = p;
+}
+extern void clear_mem_bank_direct(addrbank *b);
+
 #ifdef JIT
 extern uae_u8 *baseaddr[MEMORY_BANKS];
 #endif
@@ -504,14 +553,17 @@ extern addrbank *get_mem_bank_real(uaecptr);
 #ifdef JIT
 #define put_mem_bank(addr, b, realstart) do { \
 	(mem_banks[bankindex(addr)] = (b)); \
+	set_mem_bank_direct(addr, b); \
 	if ((b)->baseaddr) \
 		baseaddr[bankindex(addr)] = (b)->baseaddr - (realstart); \
 	else \
 		baseaddr[bankindex(addr)] = (uae_u8*)(((uae_u8*)b)+1); \
 } while (0)
 #else
-#define put_mem_bank(addr, b, realstart) \
-	(mem_banks[bankindex(addr)] = (b));
+#define put_mem_bank(addr, b, realstart) do { \
+	(mem_banks[bankindex(addr)] = (b)); \
+	set_mem_bank_direct(addr, b); \
+} while (0)
 #endif
 
 extern void memory_init (void);
@@ -543,22 +595,37 @@ uae_u32 memory_get_wordi(uaecptr);
 
 STATIC_INLINE uae_u32 get_long(uaecptr addr)
 {
+	uae_u8 *m = mem_banks_direct_r[bankindex(addr)];
+	if (m)
+		return do_get_mem_long((uae_u32*)(m + (addr & 0xffff)));
 	return memory_get_long(addr);
 }
 STATIC_INLINE uae_u32 get_word (uaecptr addr)
 {
+	uae_u8 *m = mem_banks_direct_r[bankindex(addr)];
+	if (m)
+		return do_get_mem_word((uae_u16*)(m + (addr & 0xffff)));
 	return memory_get_word(addr);
 }
 STATIC_INLINE uae_u32 get_byte (uaecptr addr)
 {
+	uae_u8 *m = mem_banks_direct_r[bankindex(addr)];
+	if (m)
+		return m[addr & 0xffff];
 	return memory_get_byte(addr);
 }
 STATIC_INLINE uae_u32 get_longi(uaecptr addr)
 {
+	uae_u8 *m = mem_banks_direct_r[bankindex(addr)];
+	if (m)
+		return do_get_mem_long((uae_u32*)(m + (addr & 0xffff)));
 	return memory_get_longi(addr);
 }
 STATIC_INLINE uae_u32 get_wordi(uaecptr addr)
 {
+	uae_u8 *m = mem_banks_direct_r[bankindex(addr)];
+	if (m)
+		return do_get_mem_word((uae_u16*)(m + (addr & 0xffff)));
 	return memory_get_wordi(addr);
 }
 
@@ -817,6 +884,7 @@ extern void memcpyah (uae_u8 *dst, uaecptr src, int size);
 
 #ifdef FSUAE // NL
 int uae_get_memory_checksum(void *data, int size);
+void uae_memory_checksum_benchmark(void);
 #endif
 
 /* Get a list of memory regions in the Amiga address space */
@@ -170,6 +170,8 @@ struct vidbuffer
 
 	int monitor_id;
 	int last_drawn_line;
+	/* optional, one byte per row of bufmem, set when the row is written */
+	uae_u8 *dirty_rows;
 };
 
 extern bool isnativevidbuf(int monid);
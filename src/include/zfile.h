@@ -70,9 +70,13 @@ extern int zfile_putc (int c, struct zfile *z);
 extern int zfile_ferror (struct zfile *z);
 extern uae_u8 *zfile_getdata (struct zfile *z, uae_s64 offset, int len, int *outlen);
 extern void zfile_exit (void);
+extern void zfile_cache_configure (uae_s64 budget, const TCHAR *spilldir);
+extern bool zfile_cache_enabled (void);
+extern bool zfile_prefetch (const TCHAR *name, int mask);
 extern int execute_command (TCHAR *);
 extern int zfile_iscompressed (struct zfile *z);
 extern int zfile_zcompress (struct zfile *dst, void *src, int size);
+extern int zfile_zcompress_level (struct zfile *dst, void *src, int size, int level);
 extern int zfile_zuncompress (void *dst, int dstsize, struct zfile *src, int srcsize);
 extern int zfile_gettype (struct zfile *z);
 extern int zfile_zopen (const TCHAR *name, zfile_callback zc, void *user);
@@ -242,9 +242,38 @@ static clock_t emul_start_time	= 0;
 static clock_t emul_end_time	= 0;
 #endif
 
+#ifdef UAE
+/* Block profiler, enabled with FS_DEBUG_JIT_PROFILE. The counters are in
+ * static tables since the generated code increments them through 32-bit
+ * absolute addresses (same as raw_cputbl_count below). */
+#define JIT_PROFILE 1
+#endif
+
+#ifdef JIT_PROFILE
+#define JIT_PROFILE_BLOCKS 16384
+#define JIT_PROFILE_FLUSH_CODES 128
+struct jit_profile_block {
+	uae_u8 *pc_p;
+	uae_u32 pc;
+	uae_u32 count;
+	uae_u32 compiles;
+	uae_u16 len;
+	uae_u16 fallbacks;
+	uae_u8 optlevel;
+};
+static bool jit_profile;
+static int jit_profile_used;
+static jit_profile_block jit_profile_blocks[JIT_PROFILE_BLOCKS];
+static uae_u32 jit_profile_flush_soft[JIT_PROFILE_FLUSH_CODES];
+static uae_u32 jit_profile_flush_hard[JIT_PROFILE_FLUSH_CODES];
+#endif
+
+#if defined(PROFILE_UNTRANSLATED_INSNS) || defined(JIT_PROFILE)
+static uae_u32 raw_cputbl_count[65536] = { 0, };
+#endif
+
 #ifdef PROFILE_UNTRANSLATED_INSNS
 static const int untranslated_top_ten = 50;
-static uae_u32 raw_cputbl_count[65536] = { 0, };
 static uae_u16 opcode_nums[65536];
 
 
@@ -3945,6 +3974,97 @@ void compemu_reset(void)
 }
 #endif
 
+#ifdef JIT_PROFILE
+static jit_profile_block *jit_profile_get(uae_u8 *pc_p)
+{
+	uae_u32 i = (uae_u32)(((uintptr)pc_p >> 1) * 2654435761u) & (JIT_PROFILE_BLOCKS - 1);
+	for (;;) {
+		jit_profile_block *p = &jit_profile_blocks[i];
+		if (p->pc_p == pc_p)
+			return p;
+		if (!p->pc_p) {
+			/* keep the table sparse, later blocks are simply not tracked */
+			if (jit_profile_used >= JIT_PROFILE_BLOCKS * 3 / 4)
+				return NULL;
+			jit_profile_used++;
+			p->pc_p = pc_p;
+			p->pc = (uae_u32)((uintptr)pc_p - MEMBaseDiff);
+			return p;
+		}
+		i = (i + 1) & (JIT_PROFILE_BLOCKS - 1);
+	}
+}
+
+static int jit_profile_block_cmp(const void *a, const void *b)
+{
+	uae_u32 ca = (*(const jit_profile_block * const *)a)->count;
+	uae_u32 cb = (*(const jit_profile_block * const *)b)->count;
+	return ca < cb ? 1 : (ca > cb ? -1 : 0);
+}
+
+static int jit_profile_opcode_cmp(const void *a, const void *b)
+{
+	uae_u32 ca = raw_cputbl_count[*(const uae_u16 *)a];
+	uae_u32 cb = raw_cputbl_count[*(const uae_u16 *)b];
+	return ca < cb ? 1 : (ca > cb ? -1 : 0);
+}
+
+void compemu_profile_dump(bool console)
+{
+	void (*out)(const TCHAR *, ...) = console ? console_out_f : write_log;
+	const int top = 50;
+
+	if (!jit_profile) {
+		if (console)
+			out(_T("JIT profiling is disabled, set FS_DEBUG_JIT_PROFILE to enable it.\n"));
+		return;
+	}
+
+	jit_profile_block **blocks = xmalloc(jit_profile_block *, jit_profile_used + 1);
+	int num = 0;
+	for (int i = 0; i < JIT_PROFILE_BLOCKS; i++) {
+		if (jit_profile_blocks[i].pc_p)
+			blocks[num++] = &jit_profile_blocks[i];
+	}
+	qsort(blocks, num, sizeof(jit_profile_block *), jit_profile_block_cmp);
+	out(_T("JIT: %d blocks profiled, compiled code %u KB\n"), num, get_jitted_size() / 1024);
+	out(_T("Rank  PC       Len Opt      Count Compiles Fallbacks\n"));
+	for (int i = 0; i < num && i < top; i++) {
+		jit_profile_block *p = blocks[i];
+		if (!p->count)
+			break;
+		out(_T("%4d: %08x %3d %3d %10u %8u %9d\n"), i, p->pc, p->len, p->optlevel,
+			p->count, p->compiles, p->fallbacks);
+	}
+	xfree(blocks);
+
+	uae_u16 *opcodes = xmalloc(uae_u16, 65536);
+	for (int i = 0; i < 65536; i++)
+		opcodes[i] = i;
+	qsort(opcodes, 65536, sizeof(uae_u16), jit_profile_opcode_cmp);
+	out(_T("Untranslated opcodes:\n"));
+	out(_T("Rank  Opc       Count Name\n"));
+	for (int i = 0; i < top; i++) {
+		uae_u32 count = raw_cputbl_count[opcodes[i]];
+		struct instr *dp;
+		struct mnemolookup *lookup;
+		if (!count)
+			break;
+		dp = table68k + opcodes[i];
+		for (lookup = lookuptab; lookup->mnemo != (instrmnem)dp->mnemo; lookup++)
+			;
+		out(_T("%4d: %04x %10u %s\n"), i, opcodes[i], count, lookup->name);
+	}
+	xfree(opcodes);
+
+	out(_T("Cache flushes (reason code: soft/hard):\n"));
+	for (int i = 0; i < JIT_PROFILE_FLUSH_CODES; i++) {
+		if (jit_profile_flush_soft[i] || jit_profile_flush_hard[i])
+			out(_T("  %3d: %u/%u\n"), i, jit_profile_flush_soft[i], jit_profile_flush_hard[i]);
+	}
+}
+#endif
+
 #ifdef UAE
 #else
 // OPCODE is in big endian format, use cft_map() beforehand, if needed.
@@ -4029,6 +4149,9 @@ void build_comp(void)
 		jit_log("JIT: JIT compiler is not enabled");
 		return;
 	}
+#endif
+#ifdef JIT_PROFILE
+	jit_profile = getenv("FS_DEBUG_JIT_PROFILE") != NULL;
 #endif
 	int i;
 	unsigned long opcode;
@@ -4238,6 +4361,10 @@ void flush_icache_hard(int n)
 		n,regs.pc,regs.pc_p,current_cache_size/1024);
 #endif
 	UNUSED(n);
+#ifdef JIT_PROFILE
+	if (jit_profile)
+		jit_profile_flush_hard[n & (JIT_PROFILE_FLUSH_CODES - 1)]++;
+#endif
 	bi=active;
 	while(bi) {
 		cache_tags[cacheline(bi->pc_p)].handler=(cpuop_func*)popall_execute_normal;
@@ -4288,6 +4415,10 @@ void flush_icache(int n)
 		flush_icache_hard(n);
 		return;
 	}
+#endif
+#ifdef JIT_PROFILE
+	if (jit_profile)
+		jit_profile_flush_soft[n & (JIT_PROFILE_FLUSH_CODES - 1)]++;
 #endif
 	if (!active)
 		return;
@@ -4457,6 +4588,9 @@ static void compile_block(cpu_history* pc_hist, int blocklen)
 		blockinfo* bi=NULL;
 		blockinfo* bi2;
 		int extra_len=0;
+#ifdef JIT_PROFILE
+		jit_profile_block *prof=NULL;
+#endif
 
 		redo_current_block=0;
 		if (current_compile_p >= MAX_COMPILE_PTR)
@@ -4487,6 +4621,17 @@ static void compile_block(cpu_history* pc_hist, int blocklen)
 			bi->count=optcount[optlev]-1;
 		}
 		current_block_pc_p=(uintptr)pc_hist[0].location;
+#ifdef JIT_PROFILE
+		if (jit_profile) {
+			prof=jit_profile_get((uae_u8*)pc_hist[0].location);
+			if (prof) {
+				prof->compiles++;
+				prof->len=blocklen;
+				prof->optlevel=optlev;
+				prof->fallbacks=0;
+			}
+		}
+#endif
 
 		remove_deps(bi); /* We are about to create new code */
 		bi->optlevel=optlev;
@@ -4573,6 +4718,11 @@ static void compile_block(cpu_history* pc_hist, int blocklen)
 			init_comp();
 			was_comp=1;
 
+#ifdef JIT_PROFILE
+			if (prof)
+				compemu_raw_add_l_mi((uintptr)&prof->count,1);
+#endif
+
 #ifdef USE_CPU_EMUL_SERVICES
 			compemu_raw_sub_l_mi((uintptr)&emulated_ticks,blocklen);
 			compemu_raw_jcc_b_oponly(NATIVE_CC_GT);
@@ -4690,6 +4840,13 @@ static void compile_block(cpu_history* pc_hist, int blocklen)
 #ifdef PROFILE_UNTRANSLATED_INSNS
 					// raw_cputbl_count[] is indexed with plain opcode (in m68k order)
 					compemu_raw_add_l_mi((uintptr)&raw_cputbl_count[cft_map(opcode)],1);
+#elif defined(JIT_PROFILE)
+					if (jit_profile)
+						compemu_raw_add_l_mi((uintptr)&raw_cputbl_count[cft_map(opcode)],1);
+#endif
+#ifdef JIT_PROFILE
+					if (prof)
+						prof->fallbacks++;
 #endif
 #if USE_NORMAL_CALLING_CONVENTION
 					raw_inc_sp(4);
@@ -745,6 +745,11 @@ void fixup_prefs (struct uae_prefs *p, bool userconfig)
 	} else if (p->gfx_display_sections > 99) {
 		p->gfx_display_sections = 99;
 	}
+	if (p->gfx_render_threads < 0) {
+		p->gfx_render_threads = 0;
+	} else if (p->gfx_render_threads > MAX_RENDER_THREADS) {
+		p->gfx_render_threads = MAX_RENDER_THREADS;
+	}
 	if (p->maprom && !p->address_space_24) {
 #ifdef FSUAE
 		write_log("MAPROM: Setting address 0x0f000000 (was 0x%08x)\n", p->maprom);
@@ -162,6 +162,7 @@ void m_to_shiftreg_cb(address_space space, offs_t offset, UINT16 *shiftreg)
 void m_from_shiftreg_cb(address_space space, offs_t offset, UINT16* shiftreg)
 {
 	memcpy(&gfxmem_banks[a2410_data.a2410_gfxboard]->baseaddr[TOWORD(offset)], shiftreg, 256 * sizeof(UINT16));
+	memory_dirty_mark_range(gfxmem_banks[a2410_data.a2410_gfxboard], TOWORD(offset), 256 * sizeof(UINT16));
 }
 
 UINT16 direct_read_data::read_decrypted_word(UINT32 pc)
@@ -432,6 +433,7 @@ void address_space::write_byte(UINT32 a, UINT8 b)
 		break;
 		case A2410_BANK_FRAMEBUFFER:
 		data->gfxbank->baseaddr[addr] = b;
+		memory_dirty_mark_range(data->gfxbank, addr, 1);
 		//write_log(_T("TMS gfx byte write %08x (%08x) = %02x PC=%08x\n"), aa, addr, b, M68K_GETPC);
 		break;
 		case A2410_BANK_RAMDAC:
@@ -477,6 +479,7 @@ void address_space::write_word(UINT32 a, UINT16 b)
 		case A2410_BANK_FRAMEBUFFER:
 		data->gfxbank->baseaddr[addr] = b >> 8;
 		data->gfxbank->baseaddr[addr + 1] = b & 0xff;
+		memory_dirty_mark_range(data->gfxbank, addr, 2);
 		//write_log(_T("TMS gfx word write %08x (%08x) = %04x PC=%08x\n"), aa, addr, b, M68K_GETPC);
 		break;
 		case A2410_BANK_RAMDAC:
@@ -111,6 +111,16 @@ static int bogomem_aliasing;
 static bool last_address_space_24;
 
 addrbank *mem_banks[MEMORY_BANKS];
+uae_u8 *mem_banks_direct_r[MEMORY_BANKS];
+
+/* Must be called before the memory of a mapped bank goes away. */
+void clear_mem_bank_direct(addrbank *b)
+{
+	for (int i = 0; i < MEMORY_BANKS; i++) {
+		if (mem_banks[i] == b)
+			mem_banks_direct_r[i] = NULL;
+	}
+}
 
 /* This has two functions. It either holds a host address that, when added
 to the 68k address, gives the host address corresponding to that 68k
@@ -556,6 +566,19 @@ static uae_u32 chipmem_full_size;
 static int REGPARAM3 chipmem_check (uaecptr addr, uae_u32 size) REGPARAM;
 static uae_u8 *REGPARAM3 chipmem_xlate (uaecptr addr) REGPARAM;
 
+/* Agnus addresses go up to chipmem_full_size. With bogomem_aliasing the
+ * part above chip RAM is slow RAM, tracked in bogomem_bank. */
+STATIC_INLINE void chipmem_agnus_dirty (uaecptr addr, uae_u32 size)
+{
+	uae_u32 chipsize = chipmem_bank.allocated_size;
+	if (addr < chipsize && chipmem_bank.dirty_pages)
+		memory_dirty_mark_range (&chipmem_bank, addr, addr + size > chipsize ? chipsize - addr : size);
+	if (addr + size > chipsize && bogomem_bank.dirty_pages) {
+		uae_u32 offset = addr > chipsize ? addr - chipsize : 0;
+		memory_dirty_mark_range (&bogomem_bank, offset, addr + size - chipsize - offset);
+	}
+}
+
 #ifdef AGA
 
 /* AGA ce-chipram access */
@@ -601,6 +624,7 @@ static void REGPARAM2 chipmem_lput_ce2 (uaecptr addr, uae_u32 l)
 	m = (uae_u32 *)(chipmem_bank.baseaddr + addr);
 	ce2_timeout ();
 	do_put_mem_long (m, l);
+	MEMORY_DIRTY_MARK(chipmem_bank, addr, 4);
 }
 
 static void REGPARAM2 chipmem_wput_ce2 (uaecptr addr, uae_u32 w)
@@ -611,6 +635,7 @@ static void REGPARAM2 chipmem_wput_ce2 (uaecptr addr, uae_u32 w)
 	m = (uae_u16 *)(chipmem_bank.baseaddr + addr);
 	ce2_timeout ();
 	do_put_mem_word (m, w);
+	MEMORY_DIRTY_MARK(chipmem_bank, addr, 2);
 }
 
 static void REGPARAM2 chipmem_bput_ce2 (uaecptr addr, uae_u32 b)
@@ -618,6 +643,7 @@ static void REGPARAM2 chipmem_bput_ce2 (uaecptr addr, uae_u32 b)
 	addr &= chipmem_bank.mask;
 	ce2_timeout ();
 	chipmem_bank.baseaddr[addr] = b;
+	MEMORY_DIRTY_MARK(chipmem_bank, addr, 1);
 }
 
 #endif
@@ -681,6 +707,7 @@ void REGPARAM2 chipmem_lput (uaecptr addr, uae_u32 l)
 	addr &= chipmem_bank.mask;
 	m = (uae_u32 *)(chipmem_bank.baseaddr + addr);
 	do_put_mem_long (m, l);
+	MEMORY_DIRTY_MARK(chipmem_bank, addr, 4);
 }
 
 void REGPARAM2 chipmem_wput (uaecptr addr, uae_u32 w)
@@ -700,6 +727,7 @@ void REGPARAM2 chipmem_wput (uaecptr addr, uae_u32 w)
 	addr &= chipmem_bank.mask;
 	m = (uae_u16 *)(chipmem_bank.baseaddr + addr);
 	do_put_mem_word (m, w);
+	MEMORY_DIRTY_MARK(chipmem_bank, addr, 2);
 }
 
 void REGPARAM2 chipmem_bput (uaecptr addr, uae_u32 b)
@@ -716,6 +744,7 @@ void REGPARAM2 chipmem_bput (uaecptr addr, uae_u32 b)
 #endif
 	addr &= chipmem_bank.mask;
 	chipmem_bank.baseaddr[addr] = b;
+	MEMORY_DIRTY_MARK(chipmem_bank, addr, 1);
 }
 
 /* cpu chipmem access inside agnus addressable ram but no ram available */
@@ -807,6 +836,7 @@ static void REGPARAM2 chipmem_agnus_lput (uaecptr addr, uae_u32 l)
 		return;
 	m = (uae_u32 *)(chipmem_bank.baseaddr + addr);
 	do_put_mem_long (m, l);
+	chipmem_agnus_dirty (addr, 4);
 }
 
 void REGPARAM2 chipmem_agnus_wput (uaecptr addr, uae_u32 w)
@@ -823,6 +853,7 @@ void REGPARAM2 chipmem_agnus_wput (uaecptr addr, uae_u32 w)
 		return;
 	m = (uae_u16 *)(chipmem_bank.baseaddr + addr);
 	do_put_mem_word (m, w);
+	chipmem_agnus_dirty (addr, 2);
 }
 
 static void REGPARAM2 chipmem_agnus_bput (uaecptr addr, uae_u32 b)
@@ -836,6 +867,7 @@ static void REGPARAM2 chipmem_agnus_bput (uaecptr addr, uae_u32 b)
 	if (addr >= chipmem_full_size)
 		return;
 	chipmem_bank.baseaddr[addr] = b;
+	chipmem_agnus_dirty (addr, 1);
 }
 
 static int REGPARAM2 chipmem_check (uaecptr addr, uae_u32 size)
@@ -2026,6 +2058,74 @@ err:
 	return 0;
 }
 
+void memory_dirty_enable(addrbank *ab)
+{
+	uae_u32 size;
+
+	if (ab->dirty_pages || !ab->baseaddr || !ab->allocated_size)
+		return;
+	size = ab->allocated_size;
+	if (ab->mask + 1 > size)
+		size = ab->mask + 1;
+	// one extra entry for long writes that straddle the end of the bank
+	ab->dirty_pages_num = ((size + MEMORY_DIRTY_PAGE_SIZE - 1) >> MEMORY_DIRTY_PAGE_SHIFT) + 1;
+	ab->dirty_pages = xmalloc(uae_u8, ab->dirty_pages_num);
+	if (ab->dirty_pages)
+		memset(ab->dirty_pages, MEMORY_DIRTY_ALL, ab->dirty_pages_num);
+}
+
+void memory_dirty_free(addrbank *ab)
+{
+	xfree(ab->dirty_pages);
+	ab->dirty_pages = NULL;
+	ab->dirty_pages_num = 0;
+}
+
+/* For writes done through host pointers, offset is relative to the bank. */
+void memory_dirty_mark_range(addrbank *ab, uae_u32 offset, uae_u32 size)
+{
+	uae_u32 first, last;
+
+	if (!ab->dirty_pages || !size)
+		return;
+	first = offset >> MEMORY_DIRTY_PAGE_SHIFT;
+	if (first >= ab->dirty_pages_num)
+		return;
+	last = (offset + size - 1) >> MEMORY_DIRTY_PAGE_SHIFT;
+	if (last < first || last >= ab->dirty_pages_num)
+		last = ab->dirty_pages_num - 1;
+	memset(ab->dirty_pages + first, MEMORY_DIRTY_ALL, last - first + 1);
+}
+
+/* For host code that writes guest memory through get_real_address or
+ * xlateaddr instead of the bank put handlers. */
+void memory_dirty_mark_addr(uaecptr addr, uae_u32 size)
+{
+	while (size > 0) {
+		addrbank *ab = &get_mem_bank(addr);
+		uae_u32 len = 65536 - (addr & 65535);
+		if (len > size)
+			len = size;
+		if (ab->dirty_pages)
+			memory_dirty_mark_range(ab, (addr - ab->startaccessmask) & ab->mask, len);
+		addr += len;
+		size -= len;
+	}
+}
+
+/* JIT compiled code writes directly to natmem and bypasses the handlers,
+ * as do bsdsocket (from its socket threads) and native code libraries. */
+bool memory_dirty_reliable(void)
+{
+#ifdef JIT
+	if (currprefs.cachesize)
+		return false;
+#endif
+	if (currprefs.socket_emu || currprefs.native_code)
+		return false;
+	return true;
+}
+
 static void set_direct_memory(addrbank *ab)
 {
 	if (!(ab->flags & ABFLAG_DIRECTACCESS))
@@ -2039,6 +2139,7 @@ static void set_direct_memory(addrbank *ab)
 
 bool mapped_malloc (addrbank *ab)
 {
+	clear_mem_bank_direct(ab);
 	ab->startmask = ab->start;
 	ab->startaccessmask = ab->start & ab->mask;
 	ab->baseaddr = xcalloc (uae_u8, ab->reserved_size + 4);
@@ -2052,6 +2153,8 @@ bool mapped_malloc (addrbank *ab)
 
 void mapped_free (addrbank *ab)
 {
+	clear_mem_bank_direct(ab);
+	memory_dirty_free(ab);
 	xfree(ab->baseaddr);
 	ab->flags &= ~ABFLAG_MAPPED;
 	ab->allocated_size = 0;
@@ -2195,6 +2298,7 @@ bool mapped_malloc (addrbank *ab)
 	if (ab->allocated_size) {
 		write_log(_T("mapped_malloc with memory bank '%s' already allocated!?\n"), ab->name);
 	}
+	clear_mem_bank_direct(ab);
 	ab->allocated_size = 0;
 	ab->baseaddr_direct_r = NULL;
 	ab->baseaddr_direct_w = NULL;
@@ -3845,6 +3949,7 @@ void memory_put_long(uaecptr addr, uae_u32 v)
 		addr &= ab->mask;
 		m = ab->baseaddr_direct_w + addr;
 		do_put_mem_long((uae_u32*)m, v);
+		MEMORY_DIRTY_MARK(*ab, addr, 4);
 	}
 }
 void memory_put_word(uaecptr addr, uae_u32 v)
@@ -3858,6 +3963,7 @@ void memory_put_word(uaecptr addr, uae_u32 v)
 		addr &= ab->mask;
 		m = ab->baseaddr_direct_w + addr;
 		do_put_mem_word((uae_u16*)m, v);
+		MEMORY_DIRTY_MARK(*ab, addr, 2);
 	}
 }
 void memory_put_byte(uaecptr addr, uae_u32 v)
@@ -3871,6 +3977,7 @@ void memory_put_byte(uaecptr addr, uae_u32 v)
 		addr &= ab->mask;
 		m = ab->baseaddr_direct_w + addr;
 		*m = (uae_u8)v;
+		MEMORY_DIRTY_MARK(*ab, addr, 1);
 	}
 }
 
@@ -3899,54 +4006,262 @@ int memory_valid_address(uaecptr addr, uae_u32 size)
 
 #ifdef FSUAE
 
+/* Memory checksum for netplay and input recording sync checks.
+
+   Each page is summed Fletcher style (running sum of words plus running sum
+   of those sums), so swapped or moved words change the result. Page values
+   are mixed with the page position and added up, which lets pages reported
+   dirty by the write tracking be replaced in the total without rescanning
+   the rest of the memory. */
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define MEMORY_CHECKSUM_SSE2
+#endif
+
+#define MEMORY_CHECKSUM_BANKS (2 + 2 * MAX_RAM_BOARDS + 4)
+
+struct memory_checksum_bank
+{
+	uae_u8 *base;
+	uae_u32 size;
+	uae_u32 *pages;
+};
+
+static struct memory_checksum_bank memory_checksum_banks[MEMORY_CHECKSUM_BANKS];
+static uae_u32 memory_checksum_total;
+
+static addrbank *memory_checksum_bank_get(int num)
+{
+	if (num == 0)
+		return &chipmem_bank;
+	if (num == 1)
+		return &bogomem_bank;
+	num -= 2;
+	if (num < MAX_RAM_BOARDS)
+		return &fastmem_bank[num];
+	num -= MAX_RAM_BOARDS;
+	if (num < MAX_RAM_BOARDS)
+		return &z3fastmem_bank[num];
+	num -= MAX_RAM_BOARDS;
+	switch (num)
+	{
+	case 0:
+		return &z3chipmem_bank;
+	case 1:
+		return &mem25bit_bank;
+	case 2:
+		return &a3000lmem_bank;
+	case 3:
+		return &a3000hmem_bank;
+	}
+	return NULL;
+}
+
+static uae_u32 memory_checksum_mix(uae_u32 v)
+{
+	v ^= v >> 16;
+	v *= 0x85ebca6b;
+	v ^= v >> 13;
+	v *= 0xc2b2ae35;
+	v ^= v >> 16;
+	return v;
+}
+
+static uae_u32 memory_checksum_page_scalar(const uae_u8 *p, int len)
+{
+	uae_u32 a = 0, b = 0;
+	for (int i = 0; i < len / 4; i++) {
+		uae_u32 v;
+		memcpy(&v, p + i * 4, 4);
+		a += v;
+		b += a;
+	}
+	return memory_checksum_mix(a ^ memory_checksum_mix(b));
+}
+
+#ifdef MEMORY_CHECKSUM_SSE2
+
+/* Four interleaved lanes. With S groups of four words, lane j holds
+   sum(w[4k+j]) and sum((S-k) * w[4k+j]), and the weight of each word in
+   the scalar version is 4 * (S-k) - j, so both produce the same value. */
+static uae_u32 memory_checksum_page_sse2(const uae_u8 *p, int len)
+{
+	__m128i va = _mm_setzero_si128();
+	__m128i vb = _mm_setzero_si128();
+	uae_u32 sa[4], sb[4];
+	int n = len / 4;
+	int n4 = n & ~3;
+
+	for (int i = 0; i < n4; i += 4) {
+		va = _mm_add_epi32(va, _mm_loadu_si128((const __m128i *) (p + i * 4)));
+		vb = _mm_add_epi32(vb, va);
+	}
+	_mm_storeu_si128((__m128i *) sa, va);
+	_mm_storeu_si128((__m128i *) sb, vb);
+	uae_u32 a = sa[0] + sa[1] + sa[2] + sa[3];
+	uae_u32 b = 4 * (sb[0] + sb[1] + sb[2] + sb[3]) - (sa[1] + 2 * sa[2] + 3 * sa[3]);
+	for (int i = n4; i < n; i++) {
+		uae_u32 v;
+		memcpy(&v, p + i * 4, 4);
+		a += v;
+		b += a;
+	}
+	return memory_checksum_mix(a ^ memory_checksum_mix(b));
+}
+
+#define memory_checksum_page_data memory_checksum_page_sse2
+#else
+#define memory_checksum_page_data memory_checksum_page_scalar
+#endif
+
+static uae_u32 memory_checksum_page(int bank, uae_u32 page, uae_u32 hash)
+{
+	return memory_checksum_mix(hash + ((bank << 20) + page) * 0x9e3779b9);
+}
+
+static void memory_checksum_update(bool full)
+{
+	bool reliable = memory_dirty_reliable();
+
+	for (int i = 0; i < MEMORY_CHECKSUM_BANKS; i++) {
+		struct memory_checksum_bank *mcb = &memory_checksum_banks[i];
+		addrbank *ab = memory_checksum_bank_get(i);
+		uae_u8 *base = ab->allocated_size ? ab->baseaddr : NULL;
+		uae_u32 size = base ? ab->allocated_size : 0;
+		uae_u32 pages = (mcb->size + MEMORY_DIRTY_PAGE_SIZE - 1) >> MEMORY_DIRTY_PAGE_SHIFT;
+		bool rescan = full || !reliable;
+
+		if (mcb->base != base || mcb->size != size) {
+			for (uae_u32 page = 0; page < pages; page++)
+				memory_checksum_total -= mcb->pages[page];
+			xfree(mcb->pages);
+			mcb->pages = NULL;
+			mcb->base = NULL;
+			mcb->size = 0;
+			if (!base)
+				continue;
+			pages = (size + MEMORY_DIRTY_PAGE_SIZE - 1) >> MEMORY_DIRTY_PAGE_SHIFT;
+			mcb->pages = xcalloc(uae_u32, pages);
+			if (!mcb->pages)
+				continue;
+			mcb->base = base;
+			mcb->size = size;
+			rescan = true;
+		}
+		if (!mcb->base)
+			continue;
+		memory_dirty_enable(ab);
+		uae_u8 *dirty = ab->dirty_pages;
+		for (uae_u32 page = 0; page < pages; page++) {
+			if (dirty) {
+				if (!rescan && !(dirty[page] & MEMORY_DIRTY_CHECKSUM))
+					continue;
+				dirty[page] &= ~MEMORY_DIRTY_CHECKSUM;
+			}
+			uae_u32 offset = page << MEMORY_DIRTY_PAGE_SHIFT;
+			uae_u32 len = size - offset < MEMORY_DIRTY_PAGE_SIZE ? size - offset : MEMORY_DIRTY_PAGE_SIZE;
+			uae_u32 v = memory_checksum_page(i, page, memory_checksum_page_data(base + offset, len));
+			memory_checksum_total += v - mcb->pages[page];
+			mcb->pages[page] = v;
+		}
+	}
+}
+
+/* Host code that writes guest memory without marking it dirty would leave
+   stale page sums behind, so the whole checksum is recomputed regularly
+   and any difference from the incremental total is logged. */
+#define MEMORY_CHECKSUM_VERIFY_INTERVAL 256
+
 int uae_get_memory_checksum(void *data, int size)
 {
-	uint32_t checksum = 0;
-	int bank_size;
-    uint32_t *mem;
-    int pos = 0;
-
-    mem = (uint32_t *) chipmem_bank.baseaddr;
-    bank_size = chipmem_bank.allocated_size / 4;
-    if (data) {
-        if (pos + bank_size * 4 <= size) {
-            memcpy((char *) data + pos, mem, bank_size * 4);
-        }
-        pos += bank_size * 4;
-    }
-    for (int i = 0; i < bank_size; i++) {
-        //checksum = (checksum + *mem) & 0x00ffffff;
-    	checksum += *mem;
-        mem++;
-    }
-
-    mem = (uint32_t *) bogomem_bank.baseaddr;
-    bank_size = bogomem_bank.allocated_size / 4;
-    if (data) {
-        if (pos + bank_size * 4 <= size) {
-            memcpy((char *) data + pos, mem, bank_size * 4);
-        }
-        pos += bank_size * 4;
-    }
-    for (int i = 0; i < bank_size; i++) {
-    	checksum += *mem;
-        mem++;
-    }
-
-    mem = (uint32_t *) fastmem_bank[0].baseaddr;
-    bank_size = fastmem_bank[0].allocated_size / 4;
-    if (data) {
-        if (pos + bank_size * 4 <= size) {
-            memcpy((char *) data + pos, mem, bank_size * 4);
-        }
-        pos += bank_size * 4;
-    }
-    for (int i = 0; i < bank_size; i++) {
-        checksum += *mem;
-        mem++;
-    }
-
-    return checksum;
+	static int verify_counter;
+	if (++verify_counter >= MEMORY_CHECKSUM_VERIFY_INTERVAL) {
+		uae_u32 incremental;
+		verify_counter = 0;
+		memory_checksum_update(false);
+		incremental = memory_checksum_total;
+		memory_checksum_update(true);
+		if (incremental != memory_checksum_total)
+			write_log(_T("memory checksum: unmarked guest memory write detected\n"));
+	} else {
+		memory_checksum_update(false);
+	}
+	if (data) {
+		/* debug dump, same layout as before: chip, slow and first fast bank */
+		addrbank *banks[] = { &chipmem_bank, &bogomem_bank, &fastmem_bank[0] };
+		int pos = 0;
+		for (int i = 0; i < 3; i++) {
+			int bank_size = banks[i]->allocated_size;
+			if (pos + bank_size <= size)
+				memcpy((char *) data + pos, banks[i]->baseaddr, bank_size);
+			pos += bank_size;
+		}
+	}
+	return memory_checksum_total;
+}
+
+/* Set FS_DEBUG_MEMCHECK_BENCHMARK=1 to time the checksum on the configured
+   memory (for example 2 MB chip + 8 MB fast) the first time it is used. */
+void uae_memory_checksum_benchmark(void)
+{
+	const int rounds = 50;
+	uae_u32 total_size = 0, legacy = 0, check = 0;
+	frame_time_t t;
+	double legacy_us, scalar_us, simd_us, incremental_us;
+
+	for (int i = 0; i < MEMORY_CHECKSUM_BANKS; i++) {
+		addrbank *ab = memory_checksum_bank_get(i);
+		if (ab->baseaddr && ab->allocated_size)
+			total_size += ab->allocated_size;
+	}
+
+	// old implementation: 32-bit add over chip, slow and first fast bank
+	t = read_processor_time();
+	for (int r = 0; r < rounds; r++) {
+		addrbank *banks[] = { &chipmem_bank, &bogomem_bank, &fastmem_bank[0] };
+		for (int i = 0; i < 3; i++) {
+			uae_u32 *mem = (uae_u32 *) banks[i]->baseaddr;
+			for (uae_u32 j = 0; j < banks[i]->allocated_size / 4; j++)
+				legacy += mem[j];
+		}
+	}
+	legacy_us = (read_processor_time() - t) * 1000000.0 / syncbase / rounds;
+
+	t = read_processor_time();
+	for (int r = 0; r < rounds; r++) {
+		for (int i = 0; i < MEMORY_CHECKSUM_BANKS; i++) {
+			addrbank *ab = memory_checksum_bank_get(i);
+			if (!ab->baseaddr || !ab->allocated_size)
+				continue;
+			for (uae_u32 offset = 0; offset < ab->allocated_size; offset += MEMORY_DIRTY_PAGE_SIZE) {
+				uae_u32 len = ab->allocated_size - offset < MEMORY_DIRTY_PAGE_SIZE ? ab->allocated_size - offset : MEMORY_DIRTY_PAGE_SIZE;
+				check += memory_checksum_page_scalar(ab->baseaddr + offset, len);
+			}
+		}
+	}
+	scalar_us = (read_processor_time() - t) * 1000000.0 / syncbase / rounds;
+
+	t = read_processor_time();
+	for (int r = 0; r < rounds; r++)
+		memory_checksum_update(true);
+	simd_us = (read_processor_time() - t) * 1000000.0 / syncbase / rounds;
+
+	// typical frame: a few dozen pages written
+	t = read_processor_time();
+	for (int r = 0; r < rounds; r++) {
+		if (chipmem_bank.dirty_pages) {
+			for (int i = 0; i < 32; i++)
+				chipmem_bank.dirty_pages[(i * 7) % (chipmem_bank.dirty_pages_num - 1)] = MEMORY_DIRTY_ALL;
+		}
+		memory_checksum_update(false);
+	}
+	incremental_us = (read_processor_time() - t) * 1000000.0 / syncbase / rounds;
+
+	write_log(_T("MEMCHECK: %u KB in all RAM banks (legacy sum %08x, %08x)\n"),
+		total_size / 1024, legacy, check);
+	write_log(_T("MEMCHECK: legacy %.1f us, scalar %.1f us, simd %.1f us, incremental %.1f us\n"),
+		legacy_us, scalar_us, simd_us, incremental_us);
 }
 
 #endif
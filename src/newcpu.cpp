@@ -6654,6 +6654,8 @@ void m68k_go (int may_quit)
 				restore_state (savestate_fname);
 			else if (savestate_state == STATE_REWIND)
 				savestate_rewind ();
+			else if (savestate_state == STATE_ROLLBACK)
+				savestate_rollback_restore ();
 #endif
 			if (cpu_hardreset)
 				m68k_reset_restore();
@@ -11,6 +11,7 @@
 
 #include <fs/fs.h>
 #include <fs/filesys.h>
+#include <fs/thread.h>
 #include <fs/time.h>
 #include <fs/util.h>
 
@@ -390,6 +391,157 @@ int custom_fsdb_used_as_nname(a_inode *base, const TCHAR *nname)
     return 1;
 }
 
+// Per-directory name index, used by find_nname_case and fsdb_get_file_info
+// so that looking up a name does not scan the host directory every time.
+// An index is reused while the directory mtime is unchanged. An index
+// scanned while the mtime was so recent that a later change could still get
+// the same (coarse) timestamp is untrusted: it is still used, but a name
+// missing from it causes one rescan before the miss is believed.
+
+#define FSDB_DIR_CACHE_MAX 256
+
+typedef struct fsdb_dir_index {
+    // lowercased Latin-1 name -> native name
+    GHashTable *names;
+    // ASCII-lowercased native names which have a .uaem sidecar
+    GHashTable *uaem;
+    time_t mtime;
+    int mtime_nsec;
+    time_t scan_time;
+} fsdb_dir_index;
+
+static GHashTable *g_dir_cache;
+static fs_mutex *g_dir_cache_mutex;
+
+static void lower_latin1(char *s);
+
+static void fsdb_dir_index_free(gpointer data)
+{
+    fsdb_dir_index *index = (fsdb_dir_index *) data;
+    g_hash_table_destroy(index->names);
+    g_hash_table_destroy(index->uaem);
+    g_free(index);
+}
+
+static fsdb_dir_index *fsdb_dir_index_scan(const char *dir_path,
+                                           struct fs_stat *st)
+{
+    GDir *dir = g_dir_open(dir_path, 0, NULL);
+    if (dir == NULL) {
+        write_log("open dir %s failed\n", dir_path);
+        return NULL;
+    }
+    if (g_fsdb_debug) {
+        write_log("indexing dir %s\n", dir_path);
+    }
+    fsdb_dir_index *index = g_new0(fsdb_dir_index, 1);
+    index->names = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                         g_free, g_free);
+    index->uaem = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                        g_free, NULL);
+    index->mtime = st->mtime;
+    index->mtime_nsec = st->mtime_nsec;
+    index->scan_time = time(NULL);
+
+    const char *result;
+    while ((result = g_dir_read_name(dir)) != NULL) {
+        int len = strlen(result);
+        if (len > 5 && strcmp(result + len - 5, ".uaem") == 0) {
+            char *key = g_ascii_strdown(result, len - 5);
+            g_hash_table_replace(index->uaem, key, key);
+        }
+        char *cmp_result = fs_utf8_to_latin1(result, -1);
+        if (cmp_result == NULL) {
+            // file name could not be represented as ISO-8859-1, so it
+            // will be ignored
+            write_log("cannot convert name \"%s\" to ISO-8859-1 - ignoring\n",
+                    result);
+            continue;
+        }
+        lower_latin1(cmp_result);
+        // The first match in directory order wins, as before.
+        if (g_hash_table_lookup(index->names, cmp_result)) {
+            g_free(cmp_result);
+            continue;
+        }
+        g_hash_table_insert(index->names, cmp_result, g_strdup(result));
+    }
+    g_dir_close(dir);
+    return index;
+}
+
+static bool fsdb_dir_index_trusted(fsdb_dir_index *index)
+{
+    return index->scan_time - index->mtime > 2;
+}
+
+// Must be called with g_dir_cache_mutex held, the index is only valid until
+// the mutex is released. With rescan set, an untrusted index is scanned
+// again even if the mtime is unchanged.
+static fsdb_dir_index *fsdb_dir_index_get(const char *dir_path, bool rescan)
+{
+    struct fs_stat st;
+    if (fs_stat(dir_path, &st) != 0) {
+        return NULL;
+    }
+    if (g_dir_cache == NULL) {
+        g_dir_cache = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                            g_free, fsdb_dir_index_free);
+    }
+    fsdb_dir_index *index = (fsdb_dir_index *) g_hash_table_lookup(
+            g_dir_cache, dir_path);
+    if (index && index->mtime == st.mtime &&
+            index->mtime_nsec == st.mtime_nsec &&
+            !(rescan && !fsdb_dir_index_trusted(index))) {
+        return index;
+    }
+    index = fsdb_dir_index_scan(dir_path, &st);
+    if (index == NULL) {
+        g_hash_table_remove(g_dir_cache, dir_path);
+        return NULL;
+    }
+    if (g_hash_table_size(g_dir_cache) >= FSDB_DIR_CACHE_MAX) {
+        g_hash_table_remove_all(g_dir_cache);
+    }
+    g_hash_table_replace(g_dir_cache, g_strdup(dir_path), index);
+    return index;
+}
+
+static void fsdb_dir_cache_lock(void)
+{
+    if (g_dir_cache_mutex == NULL) {
+        g_dir_cache_mutex = fs_mutex_create();
+    }
+    fs_mutex_lock(g_dir_cache_mutex);
+}
+
+static void fsdb_dir_cache_unlock(void)
+{
+    fs_mutex_unlock(g_dir_cache_mutex);
+}
+
+// Returns false only if a trusted directory index knows there is no .uaem
+// file.
+static bool fsdb_may_have_meta_file(const char *nname)
+{
+    char *dir_path = g_path_get_dirname(nname);
+    char *name = g_path_get_basename(nname);
+    char *key = g_ascii_strdown(name, -1);
+    bool result = true;
+    fsdb_dir_cache_lock();
+    fsdb_dir_index *index = fsdb_dir_index_get(dir_path, false);
+    // Most files have no .uaem file, so a miss in an untrusted index just
+    // lets the caller try to open it rather than rescanning the directory.
+    if (index && fsdb_dir_index_trusted(index)) {
+        result = g_hash_table_lookup(index->uaem, key) != NULL;
+    }
+    fsdb_dir_cache_unlock();
+    g_free(key);
+    g_free(name);
+    g_free(dir_path);
+    return result;
+}
+
 static int fsdb_get_file_info(const char *nname, fsdb_file_info *info)
 {
     int error = 0;
@@ -413,10 +565,14 @@ static int fsdb_get_file_info(const char *nname, fsdb_file_info *info)
 
     char *meta_file = g_strconcat(nname, ".uaem", NULL);
 
-    FILE *f = fsdb_open_meta_file(meta_file, "rb");
+    FILE *f = NULL;
+    bool has_meta_file = fsdb_may_have_meta_file(nname);
+    if (has_meta_file) {
+        f = fsdb_open_meta_file(meta_file, "rb");
+    }
     int file_size = 0;
     if (f == NULL) {
-        if (fs_path_exists(meta_file)) {
+        if (has_meta_file && fs_path_exists(meta_file)) {
             error = host_errno_to_dos_errno(errno);
             write_log("WARNING: fsdb_get_file_info - could not open "
                       "meta file for reading\n");
@@ -935,58 +1091,40 @@ int fsdb_set_file_attrs(a_inode *aino)
 
 static void find_nname_case(const char *dir_path, char **name)
 {
-    // FIXME: should cache these results...!!
     if (g_fsdb_debug) {
         write_log("find case for %s in dir %s\n", *name, dir_path);
     }
-    GDir *dir = g_dir_open(dir_path, 0, NULL);
-    if (dir == NULL) {
-        write_log("open dir %s failed\n", *name);
-        return;
-    }
-
     //gsize read, written;
     //gchar *cmp_name = g_convert(*name, -1, "ISO-8859-1", "UTF-8", &read,
     //        &written, NULL);
     char *cmp_name = fs_utf8_to_latin1(*name, -1);
     if (cmp_name == NULL) {
         write_log("WARNING: could not convert to latin1: %s", *name);
-        g_dir_close(dir);
         return;
     }
     lower_latin1(cmp_name);
 
-    const char *result;
-    while (1) {
-        result = g_dir_read_name(dir);
-        if (!result) {
-            break;
-        }
-
-        //char *cmp_result = g_convert(result, -1, "ISO-8859-1", "UTF-8", &read,
-        //        &written, NULL);
-        char *cmp_result = fs_utf8_to_latin1(result, -1);
-        //printf("%s %s\n", result, cmp_result);
-        if (cmp_result == NULL) {
-            // file name could not be represented as ISO-8859-1, so it
-            // will be ignored
-            write_log("cannot convert name \"%s\" to ISO-8859-1 - ignoring\n",
-                    result);
-            continue;
+    fsdb_dir_cache_lock();
+    fsdb_dir_index *index = fsdb_dir_index_get(dir_path, false);
+    const char *result = NULL;
+    if (index) {
+        result = (const char *) g_hash_table_lookup(index->names, cmp_name);
+    }
+    if (index && result == NULL && !fsdb_dir_index_trusted(index)) {
+        index = fsdb_dir_index_get(dir_path, true);
+        if (index) {
+            result = (const char *) g_hash_table_lookup(index->names,
+                                                        cmp_name);
         }
-        lower_latin1(cmp_result);
-
-        if (strcmp(cmp_name, cmp_result) == 0) {
-            // FIXME: memory leak, free name first?
-            *name = g_strdup(result);
-            if (g_fsdb_debug) {
-                write_log("              %s\n", *name);
-            }
-            break;
+    }
+    if (result) {
+        g_free(*name);
+        *name = g_strdup(result);
+        if (g_fsdb_debug) {
+            write_log("              %s\n", *name);
         }
-        g_free(cmp_result);
     }
-    g_dir_close(dir);
+    fsdb_dir_cache_unlock();
     g_free(cmp_name);
 }
 
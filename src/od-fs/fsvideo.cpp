@@ -46,6 +46,11 @@ static struct {
 	uint8_t *chipset_framebuffer;
 	// Size in bytes of allocated chipset frame buffer
 	int chipset_framebuffer_bytes;
+	// One byte per chipset frame buffer row, set by the drawing code when
+	// the row is written and cleared when the rows are posted to fsemu.
+	uint8_t *chipset_dirty_rows;
+	// Set (FS_DEBUG_DIRTY_ROWS=0) to always upload the full frame
+	bool chipset_dirty_rows_disabled;
 	// The actual frame buffer for RTG screens
 	uint8_t *picasso_framebuffer;
 	// Size in bytes of allocated RTG screen buffer
@@ -774,6 +779,15 @@ int lockscr(struct vidbuffer *vb, bool fullupdate, bool first)
 					uae_fsvideo.chipset_framebuffer_bytes);
 			}
 			vb->bufmem = uae_fsvideo.chipset_framebuffer;
+			if (uae_fsvideo.chipset_dirty_rows == NULL) {
+				const char *env = getenv("FS_DEBUG_DIRTY_ROWS");
+				uae_fsvideo.chipset_dirty_rows_disabled =
+					env && env[0] == '0';
+				uae_fsvideo.chipset_dirty_rows = (uint8_t *) malloc(
+					AMIGA_HEIGHT);
+				memset(uae_fsvideo.chipset_dirty_rows, 1, AMIGA_HEIGHT);
+			}
+			vb->dirty_rows = uae_fsvideo.chipset_dirty_rows;
 		} else {
 			vb->bufmem = g_renderdata.pixels;
 		}
@@ -2142,6 +2156,11 @@ void toggle_fullscreen(int monid, int mode)
 
 #include "fsemu-video.h"
 
+static void uae_fsvideo_finalize_frame(fsemu_video_frame_t *frame)
+{
+	free(frame->dirty_rows);
+}
+
 bool uae_fsvideo_renderframe(int monid, int mode, bool immediate)
 {
 	struct AmigaMonitor *mon = &AMonitors[monid];
@@ -2258,6 +2277,7 @@ bool uae_fsvideo_renderframe(int monid, int mode, bool immediate)
 			frame->flags |= FSEMU_FRAME_FLAG_TURBO;
 		}
 		if (mon->screen_is_picasso) {
+			frame->flags |= FSEMU_FRAME_FLAG_RTG;
 			frame->buffer = uae_fsvideo.picasso_framebuffer;
 			frame->stride = uae_fsvideo.picasso_width * g_amiga_video_bpp; // FIXME
 			frame->width = uae_fsvideo.picasso_width;
@@ -2303,6 +2323,19 @@ bool uae_fsvideo_renderframe(int monid, int mode, bool immediate)
 			frame->limits.y = 22;
 			frame->limits.w = 692;
 			frame->limits.h = 540;
+
+			// Hand over the rows written since the previous post, so the
+			// video renderer can skip uploading unchanged rows. The frame
+			// buffer itself persists between frames, and lines which the
+			// chipset code found unchanged are not redrawn.
+			if (uae_fsvideo.chipset_dirty_rows &&
+					!uae_fsvideo.chipset_dirty_rows_disabled) {
+				frame->dirty_rows = (uint8_t *) malloc(AMIGA_HEIGHT);
+				memcpy(frame->dirty_rows, uae_fsvideo.chipset_dirty_rows,
+					AMIGA_HEIGHT);
+				memset(uae_fsvideo.chipset_dirty_rows, 0, AMIGA_HEIGHT);
+				frame->finalize = uae_fsvideo_finalize_frame;
+			}
 		}
 
 		frame->frequency = 0; // FIXME
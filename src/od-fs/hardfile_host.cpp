@@ -17,6 +17,7 @@
 #include "uae/fs.h"
 #include "uae/io.h"
 #include "uae/log.h"
+#include "uae/time.h"
 
 #ifdef MACOSX
 #include <sys/stat.h>
@@ -41,11 +42,40 @@ static int g_debug = 0;
 #define DEBUG_LOG(...) do ; while(0)
 #endif
 
+/* Read cache, per hardfile. Data is kept in chunks of HDF_CACHE_CHUNK bytes
+ * (aligned relative to the start of the hardfile data) and replaced in LRU
+ * order. A miss directly following the previous miss is treated as a
+ * sequential read and reads ahead several chunks at once. The cache size
+ * and read ahead are set with hdf_cache_configure, see the
+ * hard_drive_cache_size and hard_drive_read_ahead options. */
+#define HDF_CACHE_CHUNK 65536
+#define HDF_CACHE_MAX_CHUNKS 256
+#define HDF_CACHE_CHUNKS 64
+#define HDF_CACHE_READAHEAD 4
+
+static int g_hdf_cache_chunks = HDF_CACHE_CHUNKS;
+static int g_hdf_cache_readahead = HDF_CACHE_READAHEAD;
+
+struct hdf_chunk
+{
+    uae_u64 offset;
+    int len;
+    uae_u32 lastuse;
+    uae_u8 *data;
+};
+
 struct hardfilehandle
 {
     int zfile;
     struct zfile *zf;
     FILE *h;
+    struct hdf_chunk chunks[HDF_CACHE_MAX_CHUNKS];
+    int nchunks;
+    int readahead_chunks;
+    uae_u32 usecount;
+    uae_u64 next_offset;
+    uae_u64 hits, misses, readahead;
+    uae_s64 read_us;
 };
 
 struct uae_driveinfo {
@@ -234,6 +264,8 @@ int hdf_open_target (struct hardfiledata *hfd, const char *pname)
     }
     hfd->handle = xcalloc (struct hardfilehandle, 1);
     hfd->handle->h = INVALID_HANDLE_VALUE;
+    hfd->handle->nchunks = g_hdf_cache_chunks;
+    hfd->handle->readahead_chunks = g_hdf_cache_readahead;
     hfd_log ("hfd open: '%s'\n", name);
     if (_tcslen (name) > 4 && !_tcsncmp (name,"HD_", 3)) {
         hdf_init_target ();
@@ -415,8 +447,28 @@ static void freehandle (struct hardfilehandle *h)
 }
 */
 
+static void hdf_cache_free (struct hardfiledata *hfd)
+{
+    struct hardfilehandle *h = hfd->handle;
+    if (h->hits || h->misses) {
+        write_log("hdf: cache %llu hits, %llu misses, %llu read ahead, "
+                  "%lld us/miss\n", (unsigned long long) h->hits,
+                  (unsigned long long) h->misses,
+                  (unsigned long long) h->readahead,
+                  (long long) (h->misses ? h->read_us / (uae_s64) h->misses : 0));
+    }
+    for (int i = 0; i < h->nchunks; i++) {
+        xfree(h->chunks[i].data);
+        h->chunks[i].data = NULL;
+        h->chunks[i].len = 0;
+    }
+}
+
 void hdf_close_target (struct hardfiledata *hfd) {
     write_log("hdf_close_target\n");
+    if (hfd->handle) {
+        hdf_cache_free(hfd);
+    }
     if (hfd->handle && hfd->handle->h) {
         write_log("closing file handle %p\n", hfd->handle->h);
         fclose(hfd->handle->h);
@@ -509,15 +561,6 @@ static void poscheck (struct hardfiledata *hfd, int len)
     }
 }
 
-static int isincache (struct hardfiledata *hfd, uae_u64 offset, int len)
-{
-    if (!hfd->cache_valid)
-        return -1;
-    if (offset >= hfd->cache_offset && offset + len <= hfd->cache_offset + CACHE_SIZE)
-        return (int)(offset - hfd->cache_offset);
-    return -1;
-}
-
 #if 0
 void hfd_flush_cache (struct hardfiledata *hfd, int now)
 {
@@ -534,39 +577,102 @@ void hfd_flush_cache (struct hardfiledata *hfd, int now)
 }
 #endif
 
+static struct hdf_chunk *hdf_cache_find (struct hardfilehandle *h,
+                                         uae_u64 offset)
+{
+    for (int i = 0; i < h->nchunks; i++) {
+        struct hdf_chunk *c = &h->chunks[i];
+        if (c->len && c->offset == offset)
+            return c;
+    }
+    return NULL;
+}
+
+static struct hdf_chunk *hdf_cache_victim (struct hardfilehandle *h)
+{
+    struct hdf_chunk *victim = &h->chunks[0];
+    for (int i = 0; i < h->nchunks; i++) {
+        struct hdf_chunk *c = &h->chunks[i];
+        if (!c->len)
+            return c;
+        if (c->lastuse < victim->lastuse)
+            victim = c;
+    }
+    return victim;
+}
+
+/* Reads the chunk at offset, and on sequential access also the chunks
+ * following it, with a single seek. Returns the chunk at offset. */
+static struct hdf_chunk *hdf_cache_fill (struct hardfiledata *hfd,
+                                        uae_u64 offset)
+{
+    struct hardfilehandle *h = hfd->handle;
+    struct hdf_chunk *first = NULL;
+    uae_u64 limit = hfd->physsize - hfd->virtual_size;
+    int count = offset == h->next_offset ? h->readahead_chunks : 1;
+    int64_t t = uae_time_us();
+
+    h->misses++;
+    hdf_seek (hfd, offset);
+    for (int i = 0; i < count && offset < limit; i++) {
+        struct hdf_chunk *c = hdf_cache_find (h, offset);
+        int len = (int) (limit - offset < HDF_CACHE_CHUNK ?
+                         limit - offset : HDF_CACHE_CHUNK);
+        long outlen = 0;
+        if (i > 0 && c && c->len == len) {
+            /* already cached, stop reading ahead */
+            break;
+        }
+        if (!c)
+            c = hdf_cache_victim (h);
+        c->len = 0;
+        if (!c->data)
+            c->data = xmalloc (uae_u8, HDF_CACHE_CHUNK);
+        if (!c->data)
+            break;
+        poscheck (hfd, len);
+        if (hfd->handle_valid == HDF_HANDLE_LINUX)
+            outlen = fread (c->data, 1, len, h->h);
+        else if (hfd->handle_valid == HDF_HANDLE_ZFILE)
+            outlen = zfile_fread (c->data, 1, len, h->zf);
+        if (outlen != len)
+            break;
+        c->offset = offset;
+        c->len = len;
+        c->lastuse = ++h->usecount;
+        if (i == 0)
+            first = c;
+        else
+            h->readahead++;
+        offset += len;
+    }
+    h->next_offset = offset;
+    h->read_us += uae_time_us() - t;
+    return first;
+}
+
 static int hdf_read_2 (struct hardfiledata *hfd, void *buffer, uae_u64 offset, int len)
 {
-    long outlen = 0;
-    int coffset;
-
-    if (offset == 0)
-        hfd->cache_valid = 0;
-    coffset = isincache (hfd, offset, len);
-    if (coffset >= 0) {
-        memcpy (buffer, hfd->cache + coffset, len);
-        return len;
-    }
-    hfd->cache_offset = offset;
-    if (offset + CACHE_SIZE > hfd->offset + (hfd->physsize - hfd->virtual_size))
-        hfd->cache_offset = hfd->offset + (hfd->physsize - hfd->virtual_size) - CACHE_SIZE;
-    hdf_seek (hfd, hfd->cache_offset);
-    poscheck (hfd, CACHE_SIZE);
-    if (hfd->handle_valid == HDF_HANDLE_LINUX)
-        outlen = fread (hfd->cache, 1, CACHE_SIZE, hfd->handle->h);
-    else if (hfd->handle_valid == HDF_HANDLE_ZFILE)
-        outlen = zfile_fread (hfd->cache, 1, CACHE_SIZE, hfd->handle->zf);
-    hfd->cache_valid = 0;
-    if (outlen != CACHE_SIZE)
-        return 0;
-    hfd->cache_valid = 1;
-    coffset = isincache (hfd, offset, len);
-    if (coffset >= 0) {
-        memcpy (buffer, hfd->cache + coffset, len);
-        return len;
+    struct hardfilehandle *h = hfd->handle;
+    uae_u64 chunkoffset = offset & ~(uae_u64) (HDF_CACHE_CHUNK - 1);
+    int coffset = (int) (offset - chunkoffset);
+    struct hdf_chunk *c = hdf_cache_find (h, chunkoffset);
+
+    if (c && offset == 0) {
+        /* block zero is always read from the file */
+        c->len = 0;
+        c = NULL;
+    }
+    if (c && coffset + len <= c->len) {
+        h->hits++;
+    } else {
+        c = hdf_cache_fill (hfd, chunkoffset);
+        if (!c || coffset + len > c->len)
+            return 0;
     }
-    write_log ("hdf_read: cache bug! offset=0x%llx len=%d\n", offset, len);
-    hfd->cache_valid = 0;
-    return 0;
+    c->lastuse = ++h->usecount;
+    memcpy (buffer, c->data + coffset, len);
+    return len;
 }
 
 int hdf_read_target (struct hardfiledata *hfd, void *buffer, uae_u64 offset, int len)
@@ -590,8 +696,21 @@ int hdf_read_target (struct hardfiledata *hfd, void *buffer, uae_u64 offset, int
                 ret = zfile_fread (buffer, 1, len, hfd->handle->zf);
             }
             maxlen = len;
+        } else if (!hfd->handle->nchunks) {
+            /* cache disabled, read straight into the caller's buffer */
+            hdf_seek (hfd, offset);
+            poscheck (hfd, len);
+            if (hfd->handle_valid == HDF_HANDLE_LINUX) {
+                ret = fread (p, 1, len, hfd->handle->h);
+            } else if (hfd->handle_valid == HDF_HANDLE_ZFILE) {
+                ret = zfile_fread (p, 1, len, hfd->handle->zf);
+            }
+            maxlen = len;
         } else {
-            maxlen = len > CACHE_SIZE ? CACHE_SIZE : len;
+            /* do not cross a cache chunk */
+            maxlen = HDF_CACHE_CHUNK - (int) (offset & (HDF_CACHE_CHUNK - 1));
+            if (maxlen > len)
+                maxlen = len;
             ret = hdf_read_2 (hfd, p, offset, maxlen);
         }
         got += ret;
@@ -604,6 +723,30 @@ int hdf_read_target (struct hardfiledata *hfd, void *buffer, uae_u64 offset, int
     return got;
 }
 
+/* Writes go straight to the file. After a successful write the cached
+ * copies are updated in place, after a failed or short write they are
+ * dropped since the file contents are unknown. */
+static void hdf_cache_update (struct hardfiledata *hfd, const void *buffer,
+                              uae_u64 offset, int len, bool ok)
+{
+    struct hardfilehandle *h = hfd->handle;
+    for (int i = 0; i < h->nchunks; i++) {
+        struct hdf_chunk *c = &h->chunks[i];
+        if (!c->len || c->offset >= offset + len ||
+                c->offset + c->len <= offset)
+            continue;
+        if (!ok) {
+            c->len = 0;
+            continue;
+        }
+        uae_u64 from = offset > c->offset ? offset : c->offset;
+        uae_u64 to = offset + len < c->offset + c->len ?
+                     offset + len : c->offset + c->len;
+        memcpy (c->data + (from - c->offset),
+                (const uae_u8 *) buffer + (from - offset), (size_t) (to - from));
+    }
+}
+
 static int hdf_write_2 (struct hardfiledata *hfd, void *buffer, uae_u64 offset, int len)
 {
     int outlen = 0;
@@ -620,7 +763,6 @@ static int hdf_write_2 (struct hardfiledata *hfd, void *buffer, uae_u64 offset,
         }
         return 0;
     }
-    hfd->cache_valid = 0;
     hdf_seek (hfd, offset);
     poscheck (hfd, len);
     memcpy (hfd->cache, buffer, len);
@@ -649,8 +791,26 @@ static int hdf_write_2 (struct hardfiledata *hfd, void *buffer, uae_u64 offset,
     } else if (hfd->handle_valid == HDF_HANDLE_ZFILE) {
         outlen = zfile_fwrite (hfd->cache, 1, len, hfd->handle->zf);
     }
+    hdf_cache_update (hfd, buffer, offset, len, outlen == len);
     return outlen;
 }
+
+void hdf_cache_configure (int size_kb, int readahead)
+{
+    int chunks = size_kb / (HDF_CACHE_CHUNK / 1024);
+    if (chunks < 0)
+        chunks = 0;
+    if (chunks > HDF_CACHE_MAX_CHUNKS)
+        chunks = HDF_CACHE_MAX_CHUNKS;
+    if (readahead < 1)
+        readahead = 1;
+    if (readahead > chunks)
+        readahead = chunks > 0 ? chunks : 1;
+    g_hdf_cache_chunks = chunks;
+    g_hdf_cache_readahead = readahead;
+    write_log("hdf: cache %d x %d KB chunks, read ahead %d\n", chunks,
+              HDF_CACHE_CHUNK / 1024, readahead);
+}
 int hdf_write_target (struct hardfiledata *hfd, void *buffer, uae_u64 offset, int len)
 {
     int got = 0;
@@ -98,6 +98,15 @@ void amiga_set_deterministic_mode();
 
 void amiga_set_save_state_compression(int compress);
 
+// Byte budget for decoded disk images kept in memory (0 disables the
+// cache). When spill_dir is set, evicted images are written there instead
+// of being discarded.
+void amiga_set_zfile_cache(int64_t budget, const char *spill_dir);
+
+// Per hard file read cache size in KB (0 disables the cache) and the
+// number of 64 KB chunks read at once on sequential access.
+void amiga_set_hard_drive_cache(int size_kb, int read_ahead);
+
 int amiga_enable_serial_port(const char *serial_name);
 int amiga_enable_parallel_port(const char *parallel_name);
 
@@ -118,6 +127,10 @@ int amiga_get_rand_checksum();
 int amiga_get_state_checksum(void);
 int amiga_get_state_checksum_and_dump(void *data, int size);
 
+int amiga_rollback_max_frames(void);
+int amiga_rollback_save(int frame);
+int amiga_rollback_load(int frame);
+
 void amiga_floppy_set_writable_images(int writable);
 const char *amiga_floppy_get_file(int index);
 const char *amiga_floppy_get_list_entry(int index);
@@ -266,7 +279,12 @@ int amiga_send_input_event(int input_event, int state);
 void amiga_write_config(const char *path);
 
 void amiga_add_key_dir(const char *path);
-int amiga_add_rom_file(const char *path, const char *cache_path);
+/* Scans the given ROM files and adds the known ROMs to the ROM list. Files
+ * not found in the index at index_path are hashed on a thread pool, and the
+ * index is updated afterwards. key_checksum identifies the rom.key in use,
+ * index entries recorded with another key are rescanned. */
+int amiga_add_rom_files(const char **paths, int count,
+        const char *index_path, const char *key_checksum);
 
 void amiga_set_paths(const char **rom_paths, const char **floppy_paths,
         const char **cd_paths, const char **hd_paths);
@@ -6,6 +6,7 @@
 #include "custom.h"
 #include "disk.h"
 #include "events.h"
+#include "filesys.h"
 #include "fs/filesys.h"
 #include "fsemu-glib.h"
 // #include "fsemu-mutex.h"
@@ -14,12 +15,14 @@
 #include "keyboard.h"
 #include "luascript.h"
 #include "options.h"
+#include "savestate.h"
 #include "uae.h"
 #include "uae/fs.h"
 #include "uae/glib.h"
 #include "uae/log.h"
 #include "uae/memory.h"
 #include "uae/time.h"
+#include "zfile.h"
 
 static struct {
     // GMutex *mutex;
@@ -104,6 +107,16 @@ void amiga_set_save_state_compression(int compress)
     g_amiga_savestate_docompress = compress ? 1 : 0;
 }
 
+void amiga_set_zfile_cache(int64_t budget, const char *spill_dir)
+{
+    zfile_cache_configure(budget, spill_dir);
+}
+
+void amiga_set_hard_drive_cache(int size_kb, int read_ahead)
+{
+    hdf_cache_configure(size_kb, read_ahead);
+}
+
 #ifdef WITH_LUA
 
 void amiga_init_lua(void (*lock)(void), void (*unlock)(void))
@@ -330,6 +343,13 @@ int amiga_get_rand_checksum()
 
 int amiga_get_state_checksum(void)
 {
+    static bool benchmark_checked;
+    if (!benchmark_checked) {
+        benchmark_checked = true;
+        if (getenv("FS_DEBUG_MEMCHECK_BENCHMARK")) {
+            uae_memory_checksum_benchmark();
+        }
+    }
     int checksum = uae_get_memory_checksum(NULL, 0);
 #ifdef DEBUG_SYNC
     write_sync_log("memcheck: %08x\n", checksum);
@@ -337,6 +357,22 @@ int amiga_get_state_checksum(void)
     return checksum & 0x00ffffff;
 }
 
+int amiga_rollback_max_frames(void)
+{
+    return savestate_rollback_max_frames();
+}
+
+int amiga_rollback_save(int frame)
+{
+    savestate_rollback_capture_request(frame);
+    return 1;
+}
+
+int amiga_rollback_load(int frame)
+{
+    return savestate_rollback_restore_request(frame) ? 1 : 0;
+}
+
 int amiga_get_state_checksum_and_dump(void *data, int size)
 {
     int checksum = uae_get_memory_checksum(data, size);
@@ -38,43 +38,72 @@ void romlist_init (void)
 	"\xc3\xc4\x81\x16\x08\x66\xe6\x0d\x08\x5e" \
 	"\x43\x6a\x24\xdb\x36\x17\xff\x60\xb5\xf9"
 
-void romlist_patch_rom (uae_u8 *buf, size_t size)
+/* Formats a binary SHA1 digest as hex. Unlike get_sha1_txt, this does not
+ * use a static buffer, so it is safe to call from the ROM scan threads. */
+static void sha1_to_txt (const uae_u8 *sha1, char *out)
 {
-	write_log ("romlist_patch_rom\n");
-	uae_u8 sha1[SHA1_SIZE];
-	get_sha1 (buf, size, sha1);
-	write_log ("ROM: SHA1=");
 	for (int i = 0; i < SHA1_SIZE; i++) {
-		write_log ("%02x", sha1[i]);
+		sprintf (out + i * 2, "%02x", sha1[i]);
 	}
-	write_log ("\n");
-	int converted = 0;
-	if (memcmp (sha1, AMIGA_OS_130_SHA1, SHA1_SIZE) == 0) {
-		write_log ("convering amiga-os-130 ROM (in-memory) "
-			   "to preferred A500 ROM\n");
+}
+
+enum {
+	ROM_PATCH_NONE,
+	ROM_PATCH_130,
+	ROM_PATCH_310,
+};
+
+/* Patches buf in place without logging, so it can be used from the ROM scan
+ * threads. sha1 receives the digest before and, if patched, after. */
+static int romlist_patch_rom_2 (uae_u8 *buf, size_t size,
+				uae_u8 sha1[2][SHA1_SIZE])
+{
+	int converted = ROM_PATCH_NONE;
+	get_sha1 (buf, size, sha1[0]);
+	if (memcmp (sha1[0], AMIGA_OS_130_SHA1, SHA1_SIZE) == 0) {
 		buf[413] = '\x08';
 		buf[176029] = '\xb9';
 		buf[262121] = '\x26';
-		converted = 1;
-	} else if (memcmp (sha1, AMIGA_OS_310_SHA1, SHA1_SIZE) == 0) {
-		write_log ("converting amiga-os-310 ROM (in-memory) "
-			   "to preferred A4000 ROM\n");
+		converted = ROM_PATCH_130;
+	} else if (memcmp (sha1[0], AMIGA_OS_310_SHA1, SHA1_SIZE) == 0) {
 		buf[220] = '\x74';
 		buf[222] = '\x7a';
 		buf[326] = '\x70';
 		buf[434] = '\x7c';
 		buf[524264] = '\x45';
 		buf[524266] = '\x14';
-		converted = 1;
+		converted = ROM_PATCH_310;
 	}
 	if (converted) {
-		get_sha1 (buf, size, sha1);
-		write_log ("ROM: SHA1=");
-		for (int i = 0; i < SHA1_SIZE; i++) {
-			write_log ("%02x", sha1[i]);
-		}
-		write_log ("\n");
+		get_sha1 (buf, size, sha1[1]);
 	}
+	return converted;
+}
+
+static void romlist_patch_rom_log (uae_u8 sha1[2][SHA1_SIZE], int converted)
+{
+	char sha1_txt[SHA1_SIZE * 2 + 1];
+	write_log ("romlist_patch_rom\n");
+	sha1_to_txt (sha1[0], sha1_txt);
+	write_log ("ROM: SHA1=%s\n", sha1_txt);
+	if (converted == ROM_PATCH_130) {
+		write_log ("convering amiga-os-130 ROM (in-memory) "
+			   "to preferred A500 ROM\n");
+	} else if (converted == ROM_PATCH_310) {
+		write_log ("converting amiga-os-310 ROM (in-memory) "
+			   "to preferred A4000 ROM\n");
+	}
+	if (converted) {
+		sha1_to_txt (sha1[1], sha1_txt);
+		write_log ("ROM: SHA1=%s\n", sha1_txt);
+	}
+}
+
+void romlist_patch_rom (uae_u8 *buf, size_t size)
+{
+	uae_u8 sha1[2][SHA1_SIZE];
+	int converted = romlist_patch_rom_2 (buf, size, sha1);
+	romlist_patch_rom_log (sha1, converted);
 #if 0
 	struct romdata *rd = getromdatabydata (buf, size);
 	if (rd) {
@@ -85,72 +114,261 @@ void romlist_patch_rom (uae_u8 *buf, size_t size)
 #endif
 }
 
-static struct romdata *scan_single_rom_2 (struct zfile *f, uae_u32 *crc32)
+/* ROM scan index. A single file in the kickstart cache directory remembers,
+ * for every ROM file scanned, the CRC32 of its contents and whether it is a
+ * known ROM. Entries are keyed on path, size, mtime and inode, and also on
+ * the rom.key in use since that decides how encrypted ROMs decode. Files
+ * which are not known ROMs are recorded too, so they are not rehashed on
+ * every start. The file is a header, a flat entry array and a string pool,
+ * and is loaded with a read-only mapping. */
+
+#define ROM_INDEX_MAGIC "UAEROMIX"
+#define ROM_INDEX_VERSION 1
+
+struct rom_index_header {
+	char magic[8];
+	uae_u32 version;
+	/* Number of entries in the built-in ROM table. A different count means
+	 * negative entries may be stale, so the index is discarded. */
+	uae_u32 roms;
+	uae_u32 count;
+	uae_u32 pool_size;
+};
+
+struct rom_index_entry {
+	uae_u64 size;
+	uae_s64 mtime;
+	uae_u64 inode;
+	uae_u32 key;
+	uae_u32 crc32;
+	uae_u32 known;
+	uae_u32 path_offset;
+};
+
+static uae_u32 rom_index_rom_count (void)
+{
+	uae_u32 count = 0;
+	while (getromdatabyid (count + 1)) {
+		count++;
+	}
+	return count;
+}
+
+static GHashTable *rom_index_load (const char *index_path)
+{
+	GHashTable *index = g_hash_table_new_full (
+		g_str_hash, g_str_equal, g_free, g_free);
+	GMappedFile *mapped = g_mapped_file_new (index_path, FALSE, NULL);
+	if (!mapped) {
+		return index;
+	}
+	const char *data = g_mapped_file_get_contents (mapped);
+	gsize length = g_mapped_file_get_length (mapped);
+	struct rom_index_header header;
+	if (length < sizeof (header)) {
+		g_mapped_file_unref (mapped);
+		return index;
+	}
+	memcpy (&header, data, sizeof (header));
+	gsize entries_size = (gsize) header.count * sizeof (struct rom_index_entry);
+	if (memcmp (header.magic, ROM_INDEX_MAGIC, 8) != 0 ||
+	    header.version != ROM_INDEX_VERSION ||
+	    header.roms != rom_index_rom_count () ||
+	    length != sizeof (header) + entries_size + header.pool_size) {
+		write_log ("ROM index %s is outdated or invalid, ignoring\n", index_path);
+		g_mapped_file_unref (mapped);
+		return index;
+	}
+	const char *entries = data + sizeof (header);
+	const char *pool = entries + entries_size;
+	for (uae_u32 i = 0; i < header.count; i++) {
+		struct rom_index_entry *entry = g_new (struct rom_index_entry, 1);
+		memcpy (entry, entries + i * sizeof (*entry), sizeof (*entry));
+		if (entry->path_offset >= header.pool_size ||
+		    !memchr (pool + entry->path_offset, 0,
+			     header.pool_size - entry->path_offset)) {
+			g_free (entry);
+			continue;
+		}
+		g_hash_table_replace (index, g_strdup (pool + entry->path_offset), entry);
+	}
+	g_mapped_file_unref (mapped);
+	write_log ("ROM index %s: %d entries\n", index_path, header.count);
+	return index;
+}
+
+static void rom_index_save (GHashTable *index, const char *index_path)
+{
+	GByteArray *entries = g_byte_array_new ();
+	GByteArray *pool = g_byte_array_new ();
+	struct rom_index_header header;
+	memcpy (header.magic, ROM_INDEX_MAGIC, 8);
+	header.version = ROM_INDEX_VERSION;
+	header.roms = rom_index_rom_count ();
+	header.count = 0;
+
+	GHashTableIter iter;
+	gpointer key, value;
+	g_hash_table_iter_init (&iter, index);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		const char *path = (const char *) key;
+		struct rom_index_entry entry = *(struct rom_index_entry *) value;
+		/* Drop entries for files which have been removed. */
+		if (!g_file_test (path, G_FILE_TEST_EXISTS)) {
+			continue;
+		}
+		entry.path_offset = pool->len;
+		g_byte_array_append (pool, (const guint8 *) path, strlen (path) + 1);
+		g_byte_array_append (entries, (const guint8 *) &entry, sizeof (entry));
+		header.count++;
+	}
+	header.pool_size = pool->len;
+
+	char *temp_path = g_strconcat (index_path, ".tmp", NULL);
+	FILE *f = g_fopen (temp_path, "wb");
+	bool ok = false;
+	if (f != NULL) {
+		ok = fwrite (&header, sizeof (header), 1, f) == 1 &&
+		     (entries->len == 0 || fwrite (entries->data, entries->len, 1, f) == 1) &&
+		     (pool->len == 0 || fwrite (pool->data, pool->len, 1, f) == 1);
+		ok = (fclose (f) == 0) && ok;
+	}
+	if (ok) {
+#ifdef _WIN32
+		g_unlink (index_path);
+#endif
+		ok = g_rename (temp_path, index_path) == 0;
+	}
+	if (ok) {
+		write_log ("ROM index %s: wrote %d entries\n", index_path, header.count);
+	} else {
+		write_log ("ROM index %s: could not write index\n", index_path);
+		g_unlink (temp_path);
+	}
+	g_free (temp_path);
+	g_byte_array_free (entries, TRUE);
+	g_byte_array_free (pool, TRUE);
+}
+
+enum {
+	ROM_SCAN_SKIP,
+	ROM_SCAN_DIRECT,
+	ROM_SCAN_CACHED,
+	ROM_SCAN_HASH,
+};
+
+struct rom_scan_job {
+	const char *path;
+	GStatBuf st;
+	int state;
+	struct romdata *rd;
+	/* Results from the scan thread */
+	bool scanned;
+	bool too_big;
+	int size;
+	uae_u32 crc32;
+	uae_u8 sha1[SHA1_SIZE];
+	int patched;
+	uae_u8 patch_sha1[2][SHA1_SIZE];
+	/* Cloanto encrypted ROM, decoded on the calling thread since that uses
+	 * the key ring and sets the global cloanto_rom flag. */
+	uae_u8 *encrypted;
+};
+
+static void scan_rom_job_identify (struct rom_scan_job *job, uae_u8 *rombuf,
+				   int size)
 {
-	uae_u8 buffer[20] = { 0 };
-	uae_u8 *rombuf;
-	int cl = 0, size;
-	struct romdata *rd = 0;
-
-	zfile_fseek (f, 0, SEEK_END);
-	size = zfile_ftell (f);
-	zfile_fseek (f, 0, SEEK_SET);
-	if (size > 524288 * 2) { /* don't skip KICK disks or 1M ROMs */
-		write_log (_T ("'%s': too big %d, ignored\n"), zfile_getname (f), size);
-		return 0;
+	job->patched = romlist_patch_rom_2 (rombuf, size, job->patch_sha1);
+	struct romdata *rd = getromdatabydata (rombuf, size);
+	if (!rd && (size & 65535) == 0) {
+		/* check byteswap */
+		for (int i = 0; i < size; i += 2) {
+			uae_u8 b = rombuf[i];
+			rombuf[i] = rombuf[i + 1];
+			rombuf[i + 1] = b;
+		}
+		rd = getromdatabydata (rombuf, size);
 	}
-	zfile_fread (buffer, 1, 11, f);
-	if (!memcmp (buffer, "KICK", 4)) {
-		zfile_fseek (f, 512, SEEK_SET);
+	job->rd = rd;
+	job->size = size;
+	job->crc32 = get_crc32 (rombuf, size);
+	get_sha1 (rombuf, size, job->sha1);
+	job->scanned = true;
+}
+
+/* Identifies a ROM file the same way scan_single_rom_2 used to do through
+ * zfile, but reads the file directly and only uses functions which are safe
+ * to call from the scan thread pool. Encrypted ROMs are left for
+ * scan_rom_job_finish. */
+static void scan_rom_job (struct rom_scan_job *job)
+{
+	gchar *data;
+	gsize length;
+	if (!g_file_get_contents (job->path, &data, &length, NULL)) {
+		return;
+	}
+	int size = length, offset = 0, cl = 0;
+	if (length > 524288 * 2) { /* don't skip KICK disks or 1M ROMs */
+		job->too_big = true;
+		job->size = length;
+		job->scanned = true;
+		g_free (data);
+		return;
+	}
+	if (length >= 4 && !memcmp (data, "KICK", 4)) {
+		offset = 512;
 		if (size > 262144)
 			size = 262144;
-	} else if (!memcmp (buffer, "AMIROMTYPE1", 11)) {
+	} else if (length >= 11 && !memcmp (data, "AMIROMTYPE1", 11)) {
+		offset = 11;
 		cl = 1;
 		size -= 11;
-	} else {
-		zfile_fseek (f, 0, SEEK_SET);
 	}
-	rombuf = xcalloc (uae_u8, size);
-	if (!rombuf)
-		return 0;
-	zfile_fread (rombuf, 1, size, f);
+	uae_u8 *rombuf = xcalloc (uae_u8, size);
+	if (!rombuf) {
+		g_free (data);
+		return;
+	}
+	int available = (int) length - offset;
+	if (available > size)
+		available = size;
+	if (available > 0)
+		memcpy (rombuf, data + offset, available);
+	g_free (data);
+
 	if (cl > 0) {
-		decode_cloanto_rom_do (rombuf, size, size);
-		cl = 0;
+		job->encrypted = rombuf;
+		job->size = size;
+		return;
 	}
-	romlist_patch_rom (rombuf, size);
-	if (!cl) {
-		rd = getromdatabydata (rombuf, size);
-		if (!rd && (size & 65535) == 0) {
-			/* check byteswap */
-			int i;
-			for (i = 0; i < size; i+=2) {
-				uae_u8 b = rombuf[i];
-				rombuf[i] = rombuf[i + 1];
-				rombuf[i + 1] = b;
-			}
-			rd = getromdatabydata (rombuf, size);
-		}
+	scan_rom_job_identify (job, rombuf, size);
+	xfree (rombuf);
+}
+
+/* Calling thread part of a scan, after the thread pool has finished. */
+static void scan_rom_job_finish (struct rom_scan_job *job)
+{
+	if (job->encrypted) {
+		decode_cloanto_rom_do (job->encrypted, job->size, job->size);
+		scan_rom_job_identify (job, job->encrypted, job->size);
+		xfree (job->encrypted);
+		job->encrypted = NULL;
 	}
-	*crc32 = get_crc32 (rombuf, size);
-	if (!rd) {
-		write_log (_T ("!: Name='%s':%d\nCRC32=%08X SHA1=%s\n"),
-			   zfile_getname (f), size, *crc32, get_sha1_txt (rombuf, size));
-	} else {
-		TCHAR tmp[MAX_DPATH];
-		getromname (rd, tmp);
-		write_log (_T ("*: %s:%d = %s\nCRC32=%08X SHA1=%s\n"),
-			   zfile_getname (f), size, tmp, *crc32, get_sha1_txt (rombuf, size));
+	if (job->scanned && !job->too_big) {
+		romlist_patch_rom_log (job->patch_sha1, job->patched);
 	}
-	xfree (rombuf);
-	return rd;
 }
 
-static struct romdata *scan_single_rom (const TCHAR *path, uae_u32 *crc32)
+static void rom_scan_worker (gpointer data, gpointer user_data)
 {
-	struct zfile *z;
-	struct romdata *rd;
+	scan_rom_job ((struct rom_scan_job *) data);
+}
 
+/* Cheap checks which do not need the file contents, done on the calling
+ * thread since they may go through zfile. */
+static struct romdata *scan_rom_direct (const char *path)
+{
+	struct romdata *rd;
 #ifdef ARCADIA
 	TCHAR tmp[MAX_DPATH];
 	_tcscpy (tmp, path);
@@ -161,10 +379,7 @@ static struct romdata *scan_single_rom (const TCHAR *path, uae_u32 *crc32)
 	rd = getromdatabypath (path);
 	if (rd && rd->crc32 == 0xffffffff)
 		return rd;
-	z = zfile_fopen (path, _T ("rb"), ZFD_NORMAL);
-	if (!z)
-		return 0;
-	return scan_single_rom_2 (z, crc32);
+	return NULL;
 }
 
 extern "C" {
@@ -176,88 +391,113 @@ void amiga_add_key_dir (const char *path)
 	g_free (p);
 }
 
-int amiga_add_rom_file (const char *path, const char *cache_path)
+int amiga_add_rom_files (const char **paths, int count,
+			 const char *index_path, const char *key_checksum)
 {
-	write_log ("amiga_add_rom_file %s\n", path);
-	struct romdata *rd = NULL;
-	struct fs_stat rom_stat;
-
-	if (cache_path != NULL) {
-		if (fs_stat (path, &rom_stat) != 0) {
-			write_log ("- could not stat rom file\n");
-			return 2;
+	write_log ("amiga_add_rom_files: %d files\n", count);
+	uae_u32 key = 0;
+	if (key_checksum) {
+		key = get_crc32 ((void *) key_checksum, strlen (key_checksum));
+	}
+	GHashTable *index = index_path ? rom_index_load (index_path) : NULL;
+	bool index_changed = false;
+	struct rom_scan_job *jobs = g_new0 (struct rom_scan_job, count);
+	GThreadPool *pool = NULL;
+	int hashed = 0, cached = 0, added = 0;
+
+	for (int i = 0; i < count; i++) {
+		struct rom_scan_job *job = jobs + i;
+		job->path = paths[i];
+		if (g_stat (job->path, &job->st) != 0) {
+			write_log ("%s: could not stat rom file\n", job->path);
+			job->state = ROM_SCAN_SKIP;
+			continue;
 		}
-		struct fs_stat cache_stat;
-		if (fs_stat (cache_path, &cache_stat) == 0) {
-			if (rom_stat.mtime == cache_stat.mtime) {
-				// we should have cached ROM information...
-				unsigned char buf[4];
-				FILE *f = g_fopen (cache_path, "rb");
-				int read_count = 0;
-				if (f != NULL) {
-					read_count = fread (buf, 4, 1, f);
-					fclose (f);
-				}
-				if (read_count == 1) {
-					write_log ("- found cached crc32\n");
-					uae_u32 crc32 = buf[0] << 24 | buf[1] << 16 |
-							buf[2] << 8 | buf[3];
-					rd = getromdatabycrc (crc32);
-					if (rd) {
-						write_log ("- rom added via cached entry\n");
-						romlist_add (path, rd);
-						return 0;
-					}
-					// we do not need / want to write cache information
-					// to this file since we have updated information
-					// cache_path = NULL;
-					return 1;
-				}
+		struct rom_index_entry *entry = index ? (struct rom_index_entry *)
+			g_hash_table_lookup (index, job->path) : NULL;
+		if (entry && entry->size == (uae_u64) job->st.st_size &&
+		    entry->mtime == (uae_s64) job->st.st_mtime &&
+		    entry->inode == (uae_u64) job->st.st_ino && entry->key == key) {
+			if (entry->known) {
+				job->rd = getromdatabycrc (entry->crc32);
+			}
+			if (!entry->known || job->rd) {
+				job->state = ROM_SCAN_CACHED;
+				cached++;
+				continue;
 			}
 		}
+		job->rd = scan_rom_direct (job->path);
+		if (job->rd) {
+			job->state = ROM_SCAN_DIRECT;
+			continue;
+		}
+		job->state = ROM_SCAN_HASH;
+		hashed++;
+		if (pool == NULL) {
+			pool = g_thread_pool_new (
+				rom_scan_worker, NULL, g_get_num_processors (), FALSE, NULL);
+		}
+		if (pool == NULL || !g_thread_pool_push (pool, job, NULL)) {
+			scan_rom_job (job);
+		}
 	}
-
-	uae_u32 crc32 = 0;
-	rd = scan_single_rom (path, &crc32);
-	if (rd) {
-		crc32 = rd->crc32;
-		//write_log("rom data at %p\n", rd);
-		//write_log("adding to rom list (id: %d)\n", rd->id);
-		//if (rd->name) {
-		//	  write_log("rom name: %s\n", rd->name);
-		//}
-		romlist_add (path, rd);
-		// FIXME: Should rd be freed here?
-	} else {
-		write_log ("- not a known rom file\n");
-		// FIXME: should set crc32 here also, so this ROM won't be
-		// rescanned again and again
+	if (pool) {
+		/* Waits for all queued jobs to complete */
+		g_thread_pool_free (pool, FALSE, TRUE);
 	}
-	if (crc32 && cache_path != NULL) {
-		write_log ("- crc32 cache file: %s\n", cache_path);
-		FILE *f = g_fopen (cache_path, "wb");
-		if (f != NULL) {
-			write_log ("- writing crc32 to ROM cache file\n");
-			unsigned char buf[4];
-			buf[0] = (crc32 >> 24) & 0xff;
-			buf[1] = (crc32 >> 16) & 0xff;
-			buf[2] = (crc32 >> 8) & 0xff;
-			buf[3] = (crc32) & 0xff;
-			if (fwrite (buf, 4, 1, f) == 1) {
-				fclose (f);
-				struct timeval tv;
-				tv.tv_sec = rom_stat.mtime;
-				tv.tv_usec = 0;
-				//write_log("- setting file time\n");
-				fs_set_file_time (cache_path, &tv);
+
+	for (int i = 0; i < count; i++) {
+		struct rom_scan_job *job = jobs + i;
+		if (job->state == ROM_SCAN_HASH) {
+			scan_rom_job_finish (job);
+			if (!job->scanned) {
+				write_log ("%s: could not read rom file\n", job->path);
+				continue;
+			}
+			char sha1_txt[SHA1_SIZE * 2 + 1];
+			sha1_to_txt (job->sha1, sha1_txt);
+			if (job->too_big) {
+				write_log (_T ("'%s': too big %d, ignored\n"), job->path, job->size);
+			} else if (job->rd) {
+				TCHAR tmp[MAX_DPATH];
+				getromname (job->rd, tmp);
+				write_log (_T ("*: %s:%d = %s\nCRC32=%08X SHA1=%s\n"),
+					   job->path, job->size, tmp, job->crc32, sha1_txt);
 			} else {
-				fclose (f);
+				write_log (_T ("!: Name='%s':%d\nCRC32=%08X SHA1=%s\n"),
+					   job->path, job->size, job->crc32, sha1_txt);
+			}
+			if (index) {
+				struct rom_index_entry *entry = g_new0 (struct rom_index_entry, 1);
+				entry->size = job->st.st_size;
+				entry->mtime = job->st.st_mtime;
+				entry->inode = job->st.st_ino;
+				entry->key = key;
+				entry->known = job->rd != NULL;
+				entry->crc32 = job->rd ? job->rd->crc32 : job->crc32;
+				g_hash_table_replace (index, g_strdup (job->path), entry);
+				index_changed = true;
 			}
+		} else if (job->state == ROM_SCAN_CACHED && !job->rd) {
+			write_log ("%s: not a known rom file (cached)\n", job->path);
+		}
+		if (job->rd) {
+			romlist_add (job->path, job->rd);
+			added++;
 		}
 	}
+	write_log ("amiga_add_rom_files: %d added, %d hashed, %d from index\n",
+		   added, hashed, cached);
 
-	write_log ("- done\n");
-	return 0;
+	if (index) {
+		if (index_changed) {
+			rom_index_save (index, index_path);
+		}
+		g_hash_table_destroy (index);
+	}
+	g_free (jobs);
+	return added;
 }
 
 } // extern C
@@ -362,6 +362,10 @@ static int open_sound (void)
     //init_sound_table16 ();
     sample_handler = currprefs.sound_stereo ? sample16s_handler : sample16_handler;
 
+    if (getenv("FS_DEBUG_AUDIO_BENCHMARK")) {
+        audio_sinc_benchmark();
+    }
+
     //obtainedfreq = currprefs.sound_freq;
     obtainedfreq = sdp->obtainedfreq;
 
@@ -724,6 +724,8 @@ void mapped_free (addrbank *ab)
 	shmpiece *x = shm_start;
 	bool rtgmem = (ab->flags & ABFLAG_RTG) != 0;
 
+	clear_mem_bank_direct(ab);
+	memory_dirty_free(ab);
 	ab->flags &= ~ABFLAG_MAPPED;
 	if (ab->baseaddr == NULL)
 		return;
@@ -535,6 +535,19 @@ static int CopyRenderInfoStructureA2U(TrapContext *ctx, uaecptr amigamemptr, str
 	return 0;
 }
 
+/* Native blitter functions write VRAM through host pointers, the bank
+ * write handlers never see it. Mark the touched rows as written. */
+static void mark_vram_dirty(struct RenderInfo *ri, unsigned long x, unsigned long y, unsigned long width, unsigned long height, int Bpp)
+{
+	if (!width || !height)
+		return;
+	uaecptr addr = ri->AMemory + y * ri->BytesPerRow + x * Bpp;
+	addrbank *ab = &get_mem_bank(addr);
+	if (!ab->dirty_pages)
+		return;
+	memory_dirty_mark_range(ab, (addr - ab->startaccessmask) & ab->mask, (height - 1) * ri->BytesPerRow + width * Bpp);
+}
+
 static int CopyPatternStructureA2U(TrapContext *ctx, uaecptr amigamemptr, struct Pattern *pattern)
 {
 	if (trap_valid_address(ctx, amigamemptr, PSSO_Pattern_sizeof)) {
@@ -2437,10 +2450,57 @@ static void CopyLibResolutionStructureU2A(TrapContext *ctx, struct LibResolution
 	trap_put_long(ctx, amigamemptr + PSSO_LibResolution_BoardInfo, libres->BoardInfo);
 }
 
+#ifdef FSUAE
+/* FS-UAE has no GetWriteWatch, VRAM writes are tracked with the gfxmem bank
+ * dirty pages instead (MEMORY_DIRTY_RTG). The bank handlers mark pages, and
+ * so do the native blitter functions and the QEMU VGA code. Not usable if
+ * JIT writes directly to VRAM, or if the RTG render thread would race with
+ * the emulation thread on the page flags. */
+static uae_u8 *vram_dirty[MAX_RTG_BOARDS];
+static uae_u32 vram_dirty_num[MAX_RTG_BOARDS];
+static bool vram_dirty_valid[MAX_RTG_BOARDS];
+
+static bool vram_dirty_tracking(void)
+{
+	return memory_dirty_reliable() && !currprefs.rtg_multithread;
+}
+
+/* GetWriteWatch equivalent: store the host addresses of pages between start
+ * and end that were written since the last call in gwwbuf and reset them.
+ * base is the host address of the start of the bank. Returns non-zero if
+ * writes are not tracked. */
+static int vram_getwritewatch(int index, uae_u8 *base, uae_u8 *start, uae_u8 *end, uintptr_t *count)
+{
+	addrbank *ab = gfxmem_banks[index];
+
+	*count = 0;
+	if (!ab || !vram_dirty_tracking())
+		return 1;
+	memory_dirty_enable(ab);
+	if (!ab->dirty_pages)
+		return 1;
+	uae_u32 first = (start - base) >> MEMORY_DIRTY_PAGE_SHIFT;
+	uae_u32 last = (end - base + MEMORY_DIRTY_PAGE_SIZE - 1) >> MEMORY_DIRTY_PAGE_SHIFT;
+	if (last > ab->dirty_pages_num)
+		last = ab->dirty_pages_num;
+	for (uae_u32 page = first; page < last && *count < gwwbufsize[index]; page++) {
+		if (!(ab->dirty_pages[page] & MEMORY_DIRTY_RTG))
+			continue;
+		ab->dirty_pages[page] &= ~MEMORY_DIRTY_RTG;
+		gwwbuf[index][(*count)++] = base + (page << MEMORY_DIRTY_PAGE_SHIFT);
+	}
+	return 0;
+}
+#endif
+
 void picasso_allocatewritewatch (int index, int gfxmemsize)
 {
 #ifdef FSUAE
-	/* FS-UAE does not support write watch. */
+	xfree (gwwbuf[index]);
+	gwwpagesize[index] = MEMORY_DIRTY_PAGE_SIZE;
+	gwwbufsize[index] = gfxmemsize / gwwpagesize[index] + 1;
+	gwwpagemask[index] = gwwpagesize[index] - 1;
+	gwwbuf[index] = xmalloc (void*, gwwbufsize[index]);
 #else
 	SYSTEM_INFO si;
 
@@ -2461,7 +2521,24 @@ static int watch_offset[MAX_RTG_BOARDS];
 void picasso_getwritewatch (int index, int offset)
 {
 #ifdef FSUAE
-	/* FS-UAE does not support write watch. */
+	addrbank *ab = gfxmem_banks[index];
+	watch_offset[index] = offset;
+	vram_dirty_valid[index] = false;
+	if (!ab || !vram_dirty_tracking())
+		return;
+	memory_dirty_enable(ab);
+	if (!ab->dirty_pages)
+		return;
+	if (vram_dirty_num[index] != ab->dirty_pages_num) {
+		xfree(vram_dirty[index]);
+		vram_dirty[index] = xmalloc(uae_u8, ab->dirty_pages_num);
+		vram_dirty_num[index] = ab->dirty_pages_num;
+	}
+	for (uae_u32 page = 0; page < ab->dirty_pages_num; page++) {
+		vram_dirty[index][page] = ab->dirty_pages[page] & MEMORY_DIRTY_RTG;
+		ab->dirty_pages[page] &= ~MEMORY_DIRTY_RTG;
+	}
+	vram_dirty_valid[index] = true;
 #else
 	ULONG ps;
 	writewatchcount[index] = gwwbufsize[index];
@@ -2476,8 +2553,17 @@ void picasso_getwritewatch (int index, int offset)
 bool picasso_is_vram_dirty (int index, uaecptr addr, int size)
 {
 #ifdef FSUAE
-	/* FS-UAE does not support write watch. */
-	return true;
+	if (!vram_dirty_valid[index])
+		return true;
+	// dirty pages are VRAM relative, watch_offset is only for GetWriteWatch
+	uae_u32 offset = addr - gfxmem_banks[index]->start;
+	uae_u32 first = offset >> MEMORY_DIRTY_PAGE_SHIFT;
+	uae_u32 last = (offset + (size > 0 ? size : 1) - 1) >> MEMORY_DIRTY_PAGE_SHIFT;
+	for (uae_u32 page = first; page <= last && page < vram_dirty_num[index]; page++) {
+		if (vram_dirty[index][page])
+			return true;
+	}
+	return false;
 #else
 	static ULONG_PTR last;
 	uae_u8 *a = addr + natmem_offset + watch_offset[index];
@@ -2516,14 +2602,6 @@ static void init_alloc (TrapContext *ctx, int size)
 	picasso96_amemend = picasso96_amem + size;
 	write_log (_T("P96 RESINFO: %08X-%08X (%d,%d)\n"), picasso96_amem, picasso96_amemend, size / PSSO_ModeInfo_sizeof, size);
 	picasso_allocatewritewatch (0, gfxmem_bank.allocated_size);
-#ifdef FSUAE
-	printf("setting gwwpagesize to something...\n");
-	gwwpagesize[0] = 1024*1024*4; // FIXME:...
-
-	gwwbufsize[0] = gfxmem_bank.allocated_size / gwwpagesize[0] + 1;
-	gwwpagemask[0] = gwwpagesize[0] - 1;
-	gwwbuf[0] = xmalloc (void*, gwwbufsize[0]);
-#endif
 }
 
 static int p96depth (int depth)
@@ -3466,6 +3544,7 @@ static uae_u32 REGPARAM2 picasso_InvertRect (TrapContext *ctx)
 
 		for (lines = 0; lines < Height; lines++, uae_mem += ri.BytesPerRow)
 			do_xor8 (uae_mem, width_in_bytes, xorval);
+		mark_vram_dirty(&ri, X, Y, Width, Height, Bpp);
 		result = 1;
 	}
 
@@ -3544,6 +3623,8 @@ static uae_u32 REGPARAM2 picasso_FillRect(TrapContext *ctx)
 				result = 1;
 			}
 		}
+		if (result)
+			mark_vram_dirty(&ri, X, Y, Width, Height, Bpp);
 	}
 	return result;
 }
@@ -3625,7 +3706,9 @@ STATIC_INLINE int BlitRectHelper(TrapContext *ctx)
 		dstri = ri;
 	}
 	/* Do our virtual frame-buffer memory first */
-	return do_blitrect_frame_buffer(ri, dstri, srcx, srcy, dstx, dsty, width, height, mask, opcode);
+	int v = do_blitrect_frame_buffer(ri, dstri, srcx, srcy, dstx, dsty, width, height, mask, opcode);
+	mark_vram_dirty(dstri, dstx, dsty, width, height, Bpp);
+	return v;
 }
 
 static int BlitRect(TrapContext *ctx, uaecptr ri, uaecptr dstri,
@@ -3928,6 +4011,7 @@ static uae_u32 REGPARAM2 picasso_BlitPattern (TrapContext *ctx)
 					}
 				}
 			}
+			mark_vram_dirty(&ri, X, Y, W, H, Bpp);
 			result = 1;
 			xfree(tmplbuf);
 		}
@@ -4114,6 +4198,7 @@ static uae_u32 REGPARAM2 picasso_BlitTemplate(TrapContext *ctx)
 					}
 				}
 			}
+			mark_vram_dirty(&ri, X, Y, W, H, Bpp);
 			result = 1;
 			xfree(tmpl_buffer);
 		}
@@ -4324,6 +4409,7 @@ static uae_u32 REGPARAM2 picasso_BlitPlanar2Chunky (TrapContext *ctx)
 			srcx, srcy, dstx, dsty, width, height, minterm, mask, local_bm.Depth));
 		P96TRACE((_T("P2C - BitMap has %d BPR, %d rows\n"), local_bm.BytesPerRow, local_bm.Rows));
 		PlanarToChunky (ctx, &local_ri, &local_bm, srcx, srcy, dstx, dsty, width, height, mask);
+		mark_vram_dirty(&local_ri, dstx, dsty, width, height, GetBytesPerPixel(local_ri.RGBFormat));
 		result = 1;
 	}
 	return result;
@@ -4528,6 +4614,7 @@ static uae_u32 REGPARAM2 picasso_BlitPlanar2Direct (TrapContext *ctx)
 		P96TRACE((_T("BlitPlanar2Direct(%d, %d, %d, %d, %d, %d) Minterm 0x%x, Mask 0x%x, Depth %d\n"),
 			srcx, srcy, dstx, dsty, width, height, minterm, Mask, local_bm.Depth));
 		PlanarToDirect(ctx, &local_ri, &local_bm, srcx, srcy, dstx, dsty, width, height, Mask, cim);
+		mark_vram_dirty(&local_ri, dstx, dsty, width, height, GetBytesPerPixel(local_ri.RGBFormat));
 		result = 1;
 	}
 	return result;
@@ -5585,6 +5672,10 @@ void picasso_flushpixels(int index, uae_u8 *src, int off, bool render)
 		}
 
 		if (vidinfo->full_refresh < 0 || overlay_updated) {
+#ifdef FSUAE
+			/* everything is copied, only reset the dirty pages */
+			vram_getwritewatch(index, src, src_start, src_end, &gwwcnt);
+#endif
 			gwwcnt = (src_end - src_start) / gwwpagesize[index] + 1;
 			vidinfo->full_refresh = 1;
 			for (int i = 0; i < gwwcnt; i++)
@@ -5593,6 +5684,11 @@ void picasso_flushpixels(int index, uae_u8 *src, int off, bool render)
 			ULONG ps;
 			gwwcnt = gwwbufsize[index];
 #ifdef FSUAE
+			if (vram_getwritewatch(index, src, src_start, src_end, &gwwcnt)) {
+				gwwcnt = (src_end - src_start) / gwwpagesize[index] + 1;
+				for (int i = 0; i < gwwcnt; i++)
+					gwwbuf[index][i] = src_start + i * gwwpagesize[index];
+			}
 #else
 			if (mman_GetWriteWatch(src_start, src_end - src_start, gwwbuf[index], &gwwcnt, &ps))
 				break;
@@ -21,6 +21,8 @@
 
 #include <cstring>
 #include <cstdio>
+#include <cstdlib>
+#include <chrono>
 
 #include "system/systhread.h"
 #include "system/arch/sysendian.h"
@@ -107,9 +109,115 @@ void PPCCALL ppc_cpu_do_dec(int val)
 static uint ops = 0;
 static int ppc_trace;
 
+/*
+ *	Decoded instruction cache. Each entry covers one host page of code and
+ *	remembers the raw word it decoded together with the resolved handler,
+ *	so a hit skips the group dispatch. Entries validate themselves against
+ *	the raw word in memory, so code modified by the PPC or the 68k is picked
+ *	up without explicit invalidation.
+ */
+#define PPC_DCACHE_ENTRIES	32
+#define PPC_DCACHE_WORDS	1024
+
+struct ppc_dcache_entry {
+	byte *page;
+	uint32 raw[PPC_DCACHE_WORDS];
+	ppc_opc_function fn[PPC_DCACHE_WORDS];
+};
+
+static ppc_dcache_entry ppc_dcache[PPC_DCACHE_ENTRIES];
+
+static bool ppc_stats;
+static uint64 ppc_stats_ops, ppc_stats_blocks;
+static std::chrono::steady_clock::time_point ppc_stats_time;
+
+static void ppc_dcache_flush()
+{
+	memset(ppc_dcache, 0, sizeof ppc_dcache);
+}
+
+static ppc_dcache_entry *ppc_dcache_select(byte *page)
+{
+	ppc_dcache_entry *e = &ppc_dcache[((uintptr_t)page >> 12) & (PPC_DCACHE_ENTRIES - 1)];
+	if (e->page != page) {
+		e->page = page;
+		memset(e->fn, 0, sizeof e->fn);
+	}
+	return e;
+}
+
+static void ppc_stats_report()
+{
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	double secs = std::chrono::duration<double>(now - ppc_stats_time).count();
+	ht_printf("PPC: %.2f Mops/s, %.1f ops per block\n",
+		secs > 0 ? ppc_stats_ops / secs / 1000000.0 : 0.0,
+		ppc_stats_blocks ? (double)ppc_stats_ops / ppc_stats_blocks : 0.0);
+	ppc_stats_time = now;
+	ppc_stats_ops = 0;
+	ppc_stats_blocks = 0;
+}
+
+/*
+ *	Runs up to max instructions from the current code page without going
+ *	back to the main loop, following branches as long as they stay on the
+ *	page. The time base and decrementer still advance per instruction and
+ *	the block ends as soon as a pending exception could be taken (or a stop
+ *	is requested), so the instruction at which an exception is taken is the
+ *	same as in the main loop. Only the debugger/pause check moves to the
+ *	end of the block.
+ *	Returns the number of instructions executed; gCPU.pc is left at the
+ *	last one and gCPU.npc at the next.
+ */
+static int ppc_cpu_run_block(int max)
+{
+	byte *page = gCPU.physical_code_page;
+	uint32 code_page = gCPU.effective_code_page;
+	ppc_dcache_entry *e = ppc_dcache_select(page);
+	uint32 pc = gCPU.pc;
+	int n = 0;
+	for (;;) {
+		uint32 idx = (pc & 0xfff) >> 2;
+		uint32 raw = ((uint32 *)page)[idx];
+		gCPU.pc = pc;
+		gCPU.npc = pc + 4;
+		gCPU.current_opc = ppc_word_from_BE(raw);
+		ppc_opc_function fn = e->fn[idx];
+		if (!fn || e->raw[idx] != raw) {
+			fn = ppc_dec_resolve(gCPU.current_opc);
+			e->raw[idx] = raw;
+			e->fn[idx] = fn;
+		}
+		fn();
+		n++;
+		gCPU.ptb++;
+		ppc_do_dec(1);
+		if (n == max
+		 || (gCPU.exception_pending && (gCPU.stop_exception || (gCPU.msr & MSR_EE)))
+		 || gCPU.effective_code_page != code_page
+		 || (gCPU.npc & ~0xfff) != code_page)
+			break;
+		pc = gCPU.npc;
+	}
+	ops += n;
+	if (ppc_stats) {
+		ppc_stats_ops += n;
+		ppc_stats_blocks++;
+		if (ppc_stats_ops >= 100000000)
+			ppc_stats_report();
+	}
+	return n;
+}
+
 void PPCCALL ppc_cpu_run_single(int count)
 {
 	while (count != 0) {
+		if ((gCPU.pc & ~0xfff) == gCPU.effective_code_page && !ppc_trace) {
+			int n = ppc_cpu_run_block(count > 0 ? count : 0x10000);
+			if (count > 0)
+				count -= n;
+			goto next;
+		}
 		if (count > 0)
 			count--;
 		gCPU.npc = gCPU.pc+4;
@@ -168,6 +276,7 @@ void PPCCALL ppc_cpu_run_single(int count)
 			}
 		}
 		
+next:
 		gCPU.pc = gCPU.npc;
 		
 		extern int debugger_active, pause_emulation;
@@ -332,6 +441,10 @@ bool PPCCALL ppc_cpu_init(uint32 pvr)
 	gCPU.msr = MSR_IP;
 	
 	ppc_dec_init();
+	gCPU.effective_code_page = 0xffffffff;
+	ppc_dcache_flush();
+	ppc_stats = getenv("FS_DEBUG_PPC_STATS") != NULL;
+	ppc_stats_time = std::chrono::steady_clock::now();
 	// initialize srs (mostly for prom)
 //	for (int i=0; i<16; i++) {
 //		gCPU.sr[i] = 0x2aa*i;
@@ -348,6 +461,7 @@ bool PPCCALL ppc_cpu_init(uint32 pvr)
 
 void PPCCALL ppc_cpu_free(void)
 {
+	ppc_dcache_flush();
 	sys_destroy_mutex(exception_mutex);
 }
 
@@ -97,41 +97,45 @@ static void ppc_opc_invalid()
 }
 
 // main opcode 19
-static void ppc_opc_group_1()
+static ppc_opc_function ppc_opc_resolve_group_1(uint32 opc)
 {
-	uint32 ext = PPC_OPC_EXT(gCPU.current_opc);
+	uint32 ext = PPC_OPC_EXT(opc);
 	if (ext & 1) {
 		// crxxx
 		if (ext <= 225) {
 			switch (ext) {
-				case 33: ppc_opc_crnor(); return;
-				case 129: ppc_opc_crandc(); return;
-				case 193: ppc_opc_crxor(); return;
-				case 225: ppc_opc_crnand(); return;
+				case 33: return ppc_opc_crnor;
+				case 129: return ppc_opc_crandc;
+				case 193: return ppc_opc_crxor;
+				case 225: return ppc_opc_crnand;
 			}
 		} else {
 			switch (ext) {
-				case 257: ppc_opc_crand(); return;
-				case 289: ppc_opc_creqv(); return;
-				case 417: ppc_opc_crorc(); return;
-				case 449: ppc_opc_cror(); return;
+				case 257: return ppc_opc_crand;
+				case 289: return ppc_opc_creqv;
+				case 417: return ppc_opc_crorc;
+				case 449: return ppc_opc_cror;
 			}
 		}
 	} else if (ext & (1<<9)) {
 		// bcctrx
 		if (ext == 528) {
-			ppc_opc_bcctrx(); 
-			return;
+			return ppc_opc_bcctrx;
 		}
 	} else {
 		switch (ext) {
-			case 16: ppc_opc_bclrx(); return;
-			case 0: ppc_opc_mcrf(); return;
-			case 50: ppc_opc_rfi(); return;
-			case 150: ppc_opc_isync(); return;
+			case 16: return ppc_opc_bclrx;
+			case 0: return ppc_opc_mcrf;
+			case 50: return ppc_opc_rfi;
+			case 150: return ppc_opc_isync;
 		}
 	}
-	ppc_opc_invalid();
+	return ppc_opc_invalid;
+}
+
+static void ppc_opc_group_1()
+{
+	ppc_opc_resolve_group_1(gCPU.current_opc)();
 }
 
 ppc_opc_function ppc_opc_table_group2[1015];
@@ -608,6 +612,21 @@ void FASTCALL ppc_exec_opc()
 	ppc_opc_table_main[mainopc]();
 }
 
+ppc_opc_function ppc_dec_resolve(uint32 opc)
+{
+	uint32 mainopc = PPC_OPC_MAIN(opc);
+	if (mainopc == 19) {
+		return ppc_opc_resolve_group_1(opc);
+	}
+	if (mainopc == 31) {
+		uint32 ext = PPC_OPC_EXT(opc);
+		if (ext < (sizeof ppc_opc_table_group2 / sizeof ppc_opc_table_group2[0])) {
+			return ppc_opc_table_group2[ext];
+		}
+	}
+	return ppc_opc_table_main[mainopc];
+}
+
 void ppc_dec_init()
 {
 	ppc_opc_init_group2();
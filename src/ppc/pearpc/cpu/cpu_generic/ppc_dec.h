@@ -28,6 +28,13 @@ void ppc_dec_init();
 
 typedef void (*ppc_opc_function)();
 
+/*
+ *	Returns the handler ppc_exec_opc() ends up calling for opc. Groups
+ *	whose dispatch depends on the MSR (FPU, AltiVec) return the group
+ *	handler itself.
+ */
+ppc_opc_function ppc_dec_resolve(uint32 opc);
+
 #define PPC_OPC_ASSERT(v)
 
 #define PPC_OPC_MAIN(opc)		(((opc)>>26)&0x3f)
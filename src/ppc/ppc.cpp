@@ -49,7 +49,49 @@ static CRITICAL_SECTION ppc_cs1, ppc_cs2;
 static bool ppc_cs_initialized;
 #else
 #include <glib.h>
+#if defined(__i386__) || defined(__x86_64__)
+#include <emmintrin.h>
+#endif
 static GMutex mutex, mutex2;
+
+/* Same idea as the critical section spin count on Windows: the lock is
+ * normally held only for a single I/O access, so spinning a little
+ * before sleeping in the kernel avoids a futex wait/wake per handoff. */
+#define MUTEX_SPIN_COUNT 5000
+
+static int spinlock_stats;
+static uae_u64 spinlock_stats_count, spinlock_stats_parked;
+static uae_s64 spinlock_stats_wait_ns, spinlock_stats_max_ns;
+
+static bool mutex_spin_lock(GMutex *m)
+{
+	for (int i = 0; i < MUTEX_SPIN_COUNT; i++) {
+		if (g_mutex_trylock(m))
+			return false;
+#if defined(__i386__) || defined(__x86_64__)
+		_mm_pause();
+#endif
+	}
+	g_mutex_lock(m);
+	return true;
+}
+
+static void spinlock_stats_update(uae_s64 started, bool parked)
+{
+	uae_s64 t = uae_time_ns() - started;
+	spinlock_stats_count++;
+	if (parked)
+		spinlock_stats_parked++;
+	spinlock_stats_wait_ns += t;
+	if (t > spinlock_stats_max_ns)
+		spinlock_stats_max_ns = t;
+	if ((spinlock_stats_count & 0xfffff) == 0) {
+		write_log(_T("PPC: spinlock %llu handoffs, %llu parked, avg %lld ns, max %lld ns\n"),
+			(unsigned long long) spinlock_stats_count, (unsigned long long) spinlock_stats_parked,
+			(long long) (spinlock_stats_wait_ns / spinlock_stats_count), (long long) spinlock_stats_max_ns);
+		spinlock_stats_max_ns = 0;
+	}
+}
 #endif
 
 void uae_ppc_spinlock_get(void)
@@ -61,11 +103,15 @@ void uae_ppc_spinlock_get(void)
 	ppc_spinlock_waiting = false;
 	LeaveCriticalSection(&ppc_cs2);
 #else
-	g_mutex_lock(&mutex2);
+	uae_s64 started = spinlock_stats ? uae_time_ns() : 0;
+	bool parked = mutex_spin_lock(&mutex2);
 	ppc_spinlock_waiting = true;
-	g_mutex_lock(&mutex);
+	parked |= mutex_spin_lock(&mutex);
 	ppc_spinlock_waiting = false;
 	g_mutex_unlock(&mutex2);
+	/* Updated with the lock held, so no atomics needed */
+	if (spinlock_stats)
+		spinlock_stats_update(started, parked);
 #endif
 #if SPINLOCK_DEBUG
 	if (spinlock_cnt != 0)
@@ -104,6 +150,8 @@ static void uae_ppc_spinlock_create(void)
 	spinlock_cnt = 0;
 #endif
 	ppc_cs_initialized = true;
+#else
+	spinlock_stats = getenv("FS_DEBUG_PPC_STATS") != NULL;
 #endif
 }
 
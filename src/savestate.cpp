@@ -201,10 +201,254 @@ struct staterecord
 	uae_u8 *data;
 	uae_u8 *end;
 	int inprecoffset;
+	/* RAM pages as they were at this record, changed before the next one */
+	uae_u8 *undo;
+	int undolen;
+	int undoalloc;
 };
 
 static struct staterecord **staterecords;
 
+/* Rewind RAM store
+
+   The newest capture keeps a full shadow copy of each RAM region (the
+   keyframe). Older records only hold the pages that changed between them
+   and the following record. Capture visits only the pages the memory bank
+   write handlers marked dirty, so both time and memory scale with the
+   number of pages touched instead of the RAM size.
+
+   The rewind history and the netplay rollback snapshots each have their
+   own store, using their own dirty page bit.
+*/
+
+#define REWIND_REGIONS 4
+
+struct rewind_region
+{
+	addrbank *bank;
+	uae_u8 *base;
+	uae_u32 size;
+	uae_u8 *shadow;
+};
+
+struct rewind_store
+{
+	struct rewind_region regions[REWIND_REGIONS];
+	bool keyframe_valid;
+	uae_u8 dirty_bit;
+};
+
+static struct rewind_store rewind_store = { { }, false, MEMORY_DIRTY_REWIND };
+static struct rewind_store rollback_store = { { }, false, MEMORY_DIRTY_ROLLBACK };
+
+/* Netplay rollback snapshots
+
+   A ring of snapshots keyed by netplay frame number, each taken at the
+   start of its frame. Records use the same format as the rewind history
+   and RAM goes to rollback_store, but nothing here depends on input
+   recording. Restoring uses the same reset path as rewind.
+*/
+
+#define ROLLBACK_SNAPSHOTS 32
+
+static struct staterecord *rollback_records[ROLLBACK_SNAPSHOTS];
+static int rollback_record_frames[ROLLBACK_SNAPSHOTS];
+static int rollback_newest = -1;
+static int rollback_capture_frame = -1;
+static int rollback_restore_frame = -1;
+
+
+static addrbank *rewind_region_bank (int num)
+{
+	switch (num)
+	{
+	case 0:
+		return &chipmem_bank;
+	case 1:
+		return &bogomem_bank;
+#ifdef AUTOCONFIG
+	case 2:
+		return &fastmem_bank[0];
+	case 3:
+		return &z3fastmem_bank[0];
+#endif
+	}
+	return NULL;
+}
+
+static uae_u32 rewind_page_len (struct rewind_region *rr, uae_u32 page)
+{
+	uae_u32 offset = page << MEMORY_DIRTY_PAGE_SHIFT;
+	if (rr->size - offset < MEMORY_DIRTY_PAGE_SIZE)
+		return rr->size - offset;
+	return MEMORY_DIRTY_PAGE_SIZE;
+}
+
+static void rewind_free (struct rewind_store *rs)
+{
+	for (int i = 0; i < REWIND_REGIONS; i++) {
+		struct rewind_region *rr = &rs->regions[i];
+		xfree (rr->shadow);
+		memset (rr, 0, sizeof (struct rewind_region));
+	}
+	rs->keyframe_valid = false;
+}
+
+/* true if RAM was reallocated or lost its write tracking since the keyframe */
+static bool rewind_changed (struct rewind_store *rs)
+{
+	if (!rs->keyframe_valid)
+		return true;
+	for (int i = 0; i < REWIND_REGIONS; i++) {
+		struct rewind_region *rr = &rs->regions[i];
+		addrbank *ab = rewind_region_bank (i);
+		uae_u8 *base = ab ? ab->baseaddr : NULL;
+		uae_u32 size = base ? ab->allocated_size : 0;
+		if (rr->base != base || rr->size != size)
+			return true;
+		if (size && !ab->dirty_pages)
+			return true;
+	}
+	return false;
+}
+
+static bool rewind_keyframe (struct rewind_store *rs)
+{
+	rewind_free (rs);
+	for (int i = 0; i < REWIND_REGIONS; i++) {
+		struct rewind_region *rr = &rs->regions[i];
+		addrbank *ab = rewind_region_bank (i);
+		if (!ab || !ab->baseaddr || !ab->allocated_size)
+			continue;
+		memory_dirty_enable (ab);
+		rr->shadow = xmalloc (uae_u8, ab->allocated_size);
+		if (!rr->shadow || !ab->dirty_pages) {
+			rewind_free (rs);
+			return false;
+		}
+		memcpy (rr->shadow, ab->baseaddr, ab->allocated_size);
+		for (uae_u32 page = 0; page < ab->dirty_pages_num; page++)
+			ab->dirty_pages[page] &= ~rs->dirty_bit;
+		rr->bank = ab;
+		rr->base = ab->baseaddr;
+		rr->size = ab->allocated_size;
+	}
+	rs->keyframe_valid = true;
+	return true;
+}
+
+static bool rewind_undo_add (struct staterecord *st, int region, uae_u32 page, uae_u8 *data, uae_u32 len)
+{
+	int need = st->undolen + 4 + len;
+	uae_u32 hdr = (region << 24) | page;
+
+	if (need > st->undoalloc) {
+		int alloc = st->undoalloc ? st->undoalloc : 16 * (4 + MEMORY_DIRTY_PAGE_SIZE);
+		while (alloc < need)
+			alloc *= 2;
+		uae_u8 *undo = xrealloc (uae_u8, st->undo, alloc);
+		if (!undo)
+			return false;
+		st->undo = undo;
+		st->undoalloc = alloc;
+	}
+	memcpy (st->undo + st->undolen, &hdr, 4);
+	memcpy (st->undo + st->undolen + 4, data, len);
+	st->undolen = need;
+	return true;
+}
+
+/* Update shadow copies to current RAM, old contents of changed pages
+   are stored in the previous (now second newest) record. */
+static bool rewind_capture (struct rewind_store *rs, struct staterecord *prev)
+{
+	bool reliable = memory_dirty_reliable ();
+
+	for (int i = 0; i < REWIND_REGIONS; i++) {
+		struct rewind_region *rr = &rs->regions[i];
+		if (!rr->shadow)
+			continue;
+		uae_u8 *dirty = rr->bank->dirty_pages;
+		uae_u32 pages = (rr->size + MEMORY_DIRTY_PAGE_SIZE - 1) >> MEMORY_DIRTY_PAGE_SHIFT;
+		for (uae_u32 page = 0; page < pages; page++) {
+			if (reliable && !(dirty[page] & rs->dirty_bit))
+				continue;
+			dirty[page] &= ~rs->dirty_bit;
+			uae_u32 offset = page << MEMORY_DIRTY_PAGE_SHIFT;
+			uae_u32 len = rewind_page_len (rr, page);
+			if (!memcmp (rr->shadow + offset, rr->base + offset, len))
+				continue;
+			if (prev && !rewind_undo_add (prev, i, page, rr->shadow + offset, len))
+				return false;
+			memcpy (rr->shadow + offset, rr->base + offset, len);
+		}
+	}
+	return true;
+}
+
+static void rewind_restore_page (struct rewind_store *rs, struct rewind_region *rr, uae_u32 page, uae_u8 *data)
+{
+	uae_u32 offset = page << MEMORY_DIRTY_PAGE_SHIFT;
+	memcpy (rr->base + offset, data, rewind_page_len (rr, page));
+	// other write tracking users must see the page as modified
+	rr->bank->dirty_pages[page] = MEMORY_DIRTY_ALL & ~rs->dirty_bit;
+}
+
+/* Return RAM to the state of the newest record */
+static void rewind_revert (struct rewind_store *rs)
+{
+	bool reliable = memory_dirty_reliable ();
+
+	for (int i = 0; i < REWIND_REGIONS; i++) {
+		struct rewind_region *rr = &rs->regions[i];
+		if (!rr->shadow)
+			continue;
+		uae_u8 *dirty = rr->bank->dirty_pages;
+		uae_u32 pages = (rr->size + MEMORY_DIRTY_PAGE_SIZE - 1) >> MEMORY_DIRTY_PAGE_SHIFT;
+		for (uae_u32 page = 0; page < pages; page++) {
+			if (reliable && !(dirty[page] & rs->dirty_bit))
+				continue;
+			dirty[page] &= ~rs->dirty_bit;
+			uae_u32 offset = page << MEMORY_DIRTY_PAGE_SHIFT;
+			if (memcmp (rr->shadow + offset, rr->base + offset, rewind_page_len (rr, page)))
+				rewind_restore_page (rs, rr, page, rr->shadow + offset);
+		}
+	}
+}
+
+/* Step RAM and shadow copies back from the record after st to st */
+static void rewind_undo (struct rewind_store *rs, struct staterecord *st)
+{
+	uae_u8 *p = st->undo;
+	uae_u8 *end = st->undo + st->undolen;
+
+	while (p < end) {
+		uae_u32 hdr;
+		memcpy (&hdr, p, 4);
+		p += 4;
+		struct rewind_region *rr = &rs->regions[hdr >> 24];
+		uae_u32 page = hdr & 0xffffff;
+		uae_u32 len = rewind_page_len (rr, page);
+		memcpy (rr->shadow + (page << MEMORY_DIRTY_PAGE_SHIFT), p, len);
+		rewind_restore_page (rs, rr, page, p);
+		p += len;
+	}
+	st->undolen = 0;
+}
+
+/* Older records can't be restored without their keyframe */
+static void rewind_drop_history (void)
+{
+	for (int i = 0; i < staterecords_max; i++) {
+		struct staterecord *st = staterecords[i];
+		if (!st)
+			continue;
+		st->inuse = 0;
+		st->undolen = 0;
+	}
+	staterecords_first = replaycounter;
+}
+
 static void state_incompatible_warn (void)
 {
 	static int warned;
@@ -498,9 +742,59 @@ TCHAR *restore_path_full_func(uae_u8 **dstp)
 }
 
 
+/* Background savestate writer: the emulation thread only collects copies
+ * of all chunks (including RAM), compression and file writes are done by
+ * a separate thread while emulation continues. The file format is exactly
+ * the same as for synchronous saves. */
+
+#define SAVESTATE_ASYNC_LEVEL 1 /* Z_BEST_SPEED */
+
+struct savestate_chunk
+{
+	struct savestate_chunk *next;
+	TCHAR name[5];
+	uae_u8 *data;
+	unsigned int len;
+	int compress;
+};
+
+struct savestate_writer
+{
+	struct savestate_chunk *first, *last;
+	struct zfile *f;
+	TCHAR filename[MAX_DPATH];
+	int slot;
+	size_t size;
+	uae_thread_id tid;
+	volatile int done;
+};
+
+static struct savestate_writer *savestate_collect;
+static struct savestate_writer *savestate_writer;
+static int savestate_async, savestate_async_slot = -1;
+
+static void savestate_writer_finish (void);
+
+static void savestate_collect_chunk (uae_u8 *chunk, unsigned int len, const TCHAR *name, int compress)
+{
+	struct savestate_chunk *c = xcalloc (struct savestate_chunk, 1);
+	if (name)
+		_tcsncpy (c->name, name, 4);
+	c->data = xmalloc (uae_u8, len);
+	memcpy (c->data, chunk, len);
+	c->len = len;
+	c->compress = compress;
+	if (savestate_collect->last)
+		savestate_collect->last->next = c;
+	else
+		savestate_collect->first = c;
+	savestate_collect->last = c;
+	savestate_collect->size += len;
+}
+
 /* read and write IFF-style hunks */
 
-static void save_chunk (struct zfile *f, uae_u8 *chunk, unsigned int len, const TCHAR *name, int compress)
+static void save_chunk_level (struct zfile *f, uae_u8 *chunk, unsigned int len, const TCHAR *name, int compress, int level)
 {
 	uae_u8 tmp[8], *dst;
 	uae_u8 zero[4]= { 0, 0, 0, 0 };
@@ -540,7 +834,7 @@ static void save_chunk (struct zfile *f, uae_u8 *chunk, unsigned int len, const
 		save_u32 (len);
 		opos = zfile_ftell (f);
 		zfile_fwrite (&tmp[0], 1, 4, f);
-		len = zfile_zcompress (f, chunk, len);
+		len = zfile_zcompress_level (f, chunk, len, level);
 		if (len > 0) {
 			zfile_fseek (f, pos, SEEK_SET);
 			dst = &tmp[0];
@@ -566,6 +860,17 @@ static void save_chunk (struct zfile *f, uae_u8 *chunk, unsigned int len, const
 	write_log (_T("Chunk '%s' chunk size %u (%u)\n"), name, chunklen, len);
 }
 
+static void save_chunk (struct zfile *f, uae_u8 *chunk, unsigned int len, const TCHAR *name, int compress)
+{
+	if (!chunk)
+		return;
+	if (savestate_collect) {
+		savestate_collect_chunk (chunk, len, name, compress);
+		return;
+	}
+	save_chunk_level (f, chunk, len, name, compress, -1 /* Z_DEFAULT_COMPRESSION */);
+}
+
 static uae_u8 *restore_chunk (struct zfile *f, TCHAR *name, unsigned int *len, unsigned int *totallen, size_t *filepos)
 {
 	uae_u8 tmp[6], dummy[4], *mem, *src;
@@ -718,6 +1023,7 @@ void restore_state (const TCHAR *filename)
 	int z3num, z2num;
 	bool end_found = false;
 
+	savestate_writer_finish ();
 	chunk = 0;
 	f = zfile_fopen (filename, _T("rb"), ZFD_NORMAL);
 	if (!f)
@@ -963,6 +1269,7 @@ void savestate_restore_finish (void)
 {
 	if (!isrestore ())
 		return;
+	bool rollback = savestate_state == STATE_ROLLBACK;
 #ifdef FSUAE
 	printf("savestate_restore_finish\n");
 #endif
@@ -993,7 +1300,8 @@ void savestate_restore_finish (void)
 	init_hz_normal();
 	audio_activate();
 #ifdef FSUAE
-    uae_callback(uae_on_restore_state_finished, savestate_fname);
+	if (!rollback)
+		uae_callback(uae_on_restore_state_finished, savestate_fname);
 #endif
 }
 
@@ -1303,7 +1611,7 @@ static int save_state_internal (struct zfile *f, const TCHAR *description, int c
 
 	/* add fake END tag, makes it easy to strip CONF and LOG hunks */
 	/* move this if you want to use CONF or LOG hunks when restoring state */
-	zfile_fwrite (endhunk, 1, 8, f);
+	save_chunk (f, endhunk, 8, NULL, -1);
 
 	dst = save_configuration (&len, false);
 	if (dst) {
@@ -1317,11 +1625,81 @@ static int save_state_internal (struct zfile *f, const TCHAR *description, int c
 		xfree (dst);
 	}
 
-	zfile_fwrite (endhunk, 1, 8, f);
+	save_chunk (f, endhunk, 8, NULL, -1);
 
 	return 1;
 }
 
+static void savestate_writer_free (struct savestate_writer *w)
+{
+	struct savestate_chunk *c = w->first;
+	while (c) {
+		struct savestate_chunk *next = c->next;
+		xfree (c->data);
+		xfree (c);
+		c = next;
+	}
+	xfree (w);
+}
+
+static void *savestate_writer_thread (void *arg)
+{
+	struct savestate_writer *w = (struct savestate_writer*)arg;
+	for (struct savestate_chunk *c = w->first; c; c = c->next)
+		save_chunk_level (w->f, c->data, c->len, c->name, c->compress, SAVESTATE_ASYNC_LEVEL);
+	w->done = 1;
+	return NULL;
+}
+
+/* Wait for a pending background save (if any) and finish it. Must be
+ * called from the emulation thread, zfile open/close is not thread safe. */
+static void savestate_writer_finish (void)
+{
+	struct savestate_writer *w = savestate_writer;
+	if (!w)
+		return;
+	savestate_writer = NULL;
+	if (w->tid) {
+		uae_wait_thread (w->tid);
+		uae_end_thread (&w->tid);
+	}
+	zfile_fclose (w->f);
+	write_log (_T("Save of '%s' complete (%d KB written in background)\n"),
+		w->filename, (int)(w->size / 1024));
+	DISK_history_add (w->filename, -1, HISTORY_STATEFILE, 0);
+#ifdef FSUAE
+	uae_callback (uae_on_save_state_finished, w->filename);
+	if (w->slot >= 0 && fsemu)
+		fsemu_savestate_update_slot (w->slot);
+#endif
+	savestate_writer_free (w);
+}
+
+static void savestate_writer_poll (void)
+{
+	if (savestate_writer && savestate_writer->done)
+		savestate_writer_finish ();
+}
+
+/* Collect all chunks in memory and hand them to the writer thread. */
+static int save_state_async (struct zfile *f, const TCHAR *filename, const TCHAR *description, int comp)
+{
+	struct savestate_writer *w = xcalloc (struct savestate_writer, 1);
+	w->f = f;
+	w->slot = savestate_async_slot;
+	_tcscpy (w->filename, filename);
+	savestate_collect = w;
+	int v = save_state_internal (f, description, comp, true);
+	savestate_collect = NULL;
+	savestate_writer = w;
+	if (!uae_start_thread (_T("savestate"), savestate_writer_thread, w, &w->tid)) {
+		w->tid = NULL;
+		savestate_writer_thread (w);
+		savestate_writer_finish ();
+	}
+	return v;
+}
+
 int save_state (const TCHAR *filename, const TCHAR *description)
 {
 #ifdef FSUAE
@@ -1329,7 +1707,10 @@ int save_state (const TCHAR *filename, const TCHAR *description)
 #endif
 	struct zfile *f;
 	int comp = savestate_docompress;
+	int async = savestate_async;
 
+	savestate_async = 0;
+	savestate_writer_finish ();
 	if (!savestate_specialdump && !savestate_nodialogs) {
 		state_incompatible_warn ();
 		if (!save_filesys_cando ()) {
@@ -1365,6 +1746,11 @@ int save_state (const TCHAR *filename, const TCHAR *description)
 		zfile_fclose (f);
 		return 1;
 	}
+	if (async) {
+		int v = save_state_async (f, filename, description, comp);
+		savestate_state = 0;
+		return v;
+	}
 	int v = save_state_internal (f, description, comp, true);
 	if (v)
 		write_log (_T("Save of '%s' complete\n"), filename);
@@ -1405,7 +1791,10 @@ void savestate_quick (int slot, int save)
 		savestate_docompress = g_amiga_savestate_docompress;
 #endif
 		savestate_nodialogs = 1;
+		savestate_async = 1;
+		savestate_async_slot = slot;
 		save_state (savestate_fname, _T(""));
+		savestate_async_slot = -1;
 	} else {
 		if (!zfile_exists (savestate_fname)) {
 			write_log (_T("staterestore, file '%s' not found\n"), savestate_fname);
@@ -1415,18 +1804,26 @@ void savestate_quick (int slot, int save)
 		write_log (_T("staterestore starting '%s'\n"), savestate_fname);
 	}
 #ifdef FSUAE
-	if (save && fsemu) {
+	if (save && fsemu && !savestate_writer) {
 		fsemu_savestate_update_slot(slot);
 	}
 #endif
 }
 
+static void savestate_rollback_capture (void);
+
 bool savestate_check (void)
 {
+	savestate_writer_poll ();
+	if (rollback_restore_frame >= 0 && !savestate_state) {
+		savestate_state = STATE_ROLLBACK;
+		return true;
+	}
 	if (vpos == 0 && !savestate_state) {
 		if (hsync_counter == 0 && input_play == INPREC_PLAY_NORMAL)
 			savestate_memorysave ();
 		savestate_capture (0);
+		savestate_rollback_capture ();
 	}
 	if (savestate_state == STATE_DORESTORE) {
 		savestate_state = STATE_RESTORE;
@@ -1493,31 +1890,11 @@ void savestate_listrewind (void)
 }
 #endif
 
-void savestate_rewind (void)
+/* Restore the non-RAM state written by save_state_record */
+static uae_u8 *restore_state_record (uae_u8 *p)
 {
-	int len, i, dummy;
-	uae_u8 *p, *p2;
-	struct staterecord *st;
-	int pos;
-	bool rewind = false;
+	int i;
 
-	if (hsync_counter % currprefs.statecapturerate <= 25 && rewindmode <= -2) {
-		pos = replaycounter - 2;
-		rewind = true;
-	} else {
-		pos = replaycounter - 1;
-	}
-	st = canrewind (pos);
-	if (!st) {
-		rewind = false;
-		pos = replaycounter - 1;
-		st = canrewind (pos);
-		if (!st)
-			return;
-	}
-	p = st->data;
-	p2 = st->end;
-	write_log (_T("rewinding %d -> %d\n"), replaycounter - 1, pos);
 	hsync_counter = restore_u32_func (&p);
 	vsync_counter = restore_u32_func (&p);
 	p = restore_cpu (p);
@@ -1557,20 +1934,6 @@ void savestate_rewind (void)
 #ifdef PICASSO96
 	if (restore_u32_func (&p))
 		p = restore_p96 (p);
-#endif
-	len = restore_u32_func (&p);
-	memcpy (chipmem_bank.baseaddr, p, currprefs.chipmem_size > len ? len : currprefs.chipmem_size);
-	p += len;
-	len = restore_u32_func (&p);
-	memcpy (save_bram (&dummy), p, currprefs.bogomem_size > len ? len : currprefs.bogomem_size);
-	p += len;
-#ifdef AUTOCONFIG
-	len = restore_u32_func (&p);
-	memcpy (save_fram (&dummy, 0), p, currprefs.fastmem[0].size > len ? len : currprefs.fastmem[0].size);
-	p += len;
-	len = restore_u32_func (&p);
-	memcpy (save_zram (&dummy, 0), p, currprefs.z3fastmem[0].size > len ? len : currprefs.z3fastmem[0].size);
-	p += len;
 #endif
 #ifdef ACTION_REPLAY
 	if (restore_u32_func (&p))
@@ -1601,6 +1964,41 @@ void savestate_rewind (void)
 			p = restore_gayle_ide (p);
 	}
 	p += 4;
+	return p;
+}
+
+void savestate_rewind (void)
+{
+	uae_u8 *p, *p2;
+	struct staterecord *st;
+	int pos;
+	bool rewind = false;
+
+	if (hsync_counter % currprefs.statecapturerate <= 25 && rewindmode <= -2) {
+		pos = replaycounter - 2;
+		rewind = true;
+	} else {
+		pos = replaycounter - 1;
+	}
+	st = canrewind (pos);
+	if (!st) {
+		rewind = false;
+		pos = replaycounter - 1;
+		st = canrewind (pos);
+		if (!st)
+			return;
+	}
+	if (rewind_changed (&rewind_store)) {
+		write_log (_T("can't rewind, memory configuration changed\n"));
+		return;
+	}
+	p = st->data;
+	p2 = st->end;
+	write_log (_T("rewinding %d -> %d\n"), replaycounter - 1, pos);
+	p = restore_state_record (p);
+	rewind_revert (&rewind_store);
+	if (rewind)
+		rewind_undo (&rewind_store, st);
 	if (p != p2) {
 		gui_message (_T("reload failure, address mismatch %p != %p"), p, p2);
 		uae_reset (0, 0);
@@ -1637,81 +2035,39 @@ void savestate_memorysave (void)
 		save_state_internal (staterecord_statefile, _T("rerecording"), 1, false);
 }
 
-void savestate_capture (int force)
+/* Write the non-RAM state into st, NULL if the buffer is too small */
+static uae_u8 *save_state_record (struct staterecord *st)
 {
-	uae_u8 *p, *p2, *p3, *dst;
-	int i, len, tlen, retrycnt;
-	struct staterecord *st;
-	bool firstcapture = false;
-
-#ifdef FILESYS
-	if (nr_units ())
-		return;
-#endif
-	if (!staterecords)
-		return;
-	if (!input_record)
-		return;
-	if (currprefs.statecapturerate && hsync_counter == 0 && input_record == INPREC_RECORD_START && savestate_first_capture > 0) {
-		// first capture
-		force = true;
-		firstcapture = true;
-	} else if (savestate_first_capture < 0) {
-		force = true;
-		firstcapture = false;
-	}
-	if (!force) {
-		if (currprefs.statecapturerate <= 0)
-			return;
-		if (hsync_counter % currprefs.statecapturerate)
-			return;
-	}
-	savestate_first_capture = false;
+	uae_u8 *p, *p3;
+	int i, len, tlen;
 
-	retrycnt = 0;
-retry2:
-	st = staterecords[replaycounter];
-	if (st == NULL) {
-		st = (struct staterecord*)xmalloc (uae_u8, statefile_alloc);
-		st->len = statefile_alloc;
-	} else if (retrycnt > 0) {
-		write_log (_T("realloc %d -> %d\n"), st->len, st->len + STATEFILE_ALLOC_SIZE);
-		st->len += STATEFILE_ALLOC_SIZE;
-		st = (struct staterecord*)xrealloc (uae_u8, st, st->len);
-	}
-	if (st->len > statefile_alloc)
-		statefile_alloc = st->len;
-	st->inuse = 0;
-	st->data = (uae_u8*)(st + 1);
-	staterecords[replaycounter] = st;
-	retrycnt++;
-	p = p2 = st->data;
+	p = st->data;
 	tlen = 0;
 	save_u32_func (&p, hsync_counter);
 	save_u32_func (&p, vsync_counter);
 	tlen += 8;
 
 	if (bufcheck (st, p, 0))
-		goto retry;
+		return NULL;
 	st->cpu = p;
 	save_cpu (&len, p);
 	tlen += len;
 	p += len;
 
 	if (bufcheck (st, p, 0))
-		goto retry;
+		return NULL;
 	save_cycles (&len, p);
 	tlen += len;
 	p += len;
 
 	if (bufcheck (st, p, 0))
-		goto retry;
+		return NULL;
 	save_cpu_extra (&len, p);
 	tlen += len;
 	p += len;
 
 	if (bufcheck (st, p, 0))
-		goto retry;
+		return NULL;
 	p3 = p;
 	save_u32_func (&p, 0);
 	tlen += 4;
@@ -1723,7 +2079,7 @@ retry2:
 
 #ifdef FPUEMU
 	if (bufcheck (st, p, 0))
-		goto retry;
+		return NULL;
 	p3 = p;
 	save_u32_func (&p, 0);
 	tlen += 4;
@@ -1735,7 +2091,7 @@ retry2:
 #endif
 	for (i = 0; i < 4; i++) {
 		if (bufcheck (st, p, 0))
-			goto retry;
+			return NULL;
 		save_disk (i, &len, p, true);
 		tlen += len;
 		p += len;
@@ -1750,25 +2106,25 @@ retry2:
 	}
 
 	if (bufcheck (st, p, 0))
-		goto retry;
+		return NULL;
 	save_floppy (&len, p);
 	tlen += len;
 	p += len;
 
 	if (bufcheck (st, p, 0))
-		goto retry;
+		return NULL;
 	save_custom (&len, p, 0);
 	tlen += len;
 	p += len;
 
 	if (bufcheck (st, p, 0))
-		goto retry;
+		return NULL;
 	save_custom_extra (&len, p);
 	tlen += len;
 	p += len;
 
 	if (bufcheck (st, p, 0))
-		goto retry;
+		return NULL;
 	p3 = p;
 	save_u32_func (&p, 0);
 	tlen += 4;
@@ -1779,19 +2135,19 @@ retry2:
 	}
 
 	if (bufcheck (st, p, 0))
-		goto retry;
+		return NULL;
 	save_blitter_new (&len, p);
 	tlen += len;
 	p += len;
 
 	if (bufcheck (st, p, 0))
-		goto retry;
+		return NULL;
 	save_custom_agacolors (&len, p);
 	tlen += len;
 	p += len;
 	for (i = 0; i < 8; i++) {
 		if (bufcheck (st, p, 0))
-			goto retry;
+			return NULL;
 		save_custom_sprite (i, &len, p);
 		tlen += len;
 		p += len;
@@ -1799,39 +2155,39 @@ retry2:
 
 	for (i = 0; i < 4; i++) {
 		if (bufcheck (st, p, 0))
-			goto retry;
+			return NULL;
 		save_audio (i, &len, p);
 		tlen += len;
 		p += len;
 	}
 
 	if (bufcheck (st, p, len))
-		goto retry;
+		return NULL;
 	save_cia (0, &len, p);
 	tlen += len;
 	p += len;
 
 	if (bufcheck (st, p, len))
-		goto retry;
+		return NULL;
 	save_cia (1, &len, p);
 	tlen += len;
 	p += len;
 
 	if (bufcheck (st, p, len))
-		goto retry;
+		return NULL;
 	save_keyboard (&len, p);
 	tlen += len;
 	p += len;
 
 	if (bufcheck (st, p, len))
-		goto retry;
+		return NULL;
 	save_inputstate (&len, p);
 	tlen += len;
 	p += len;
 
 #ifdef AUTOCONFIG
 	if (bufcheck (st, p, len))
-		goto retry;
+		return NULL;
 	save_expansion (&len, p);
 	tlen += len;
 	p += len;
@@ -1839,7 +2195,7 @@ retry2:
 
 #ifdef PICASSO96
 	if (bufcheck (st, p, 0))
-		goto retry;
+		return NULL;
 	p3 = p;
 	save_u32_func (&p, 0);
 	tlen += 4;
@@ -1850,39 +2206,9 @@ retry2:
 	}
 #endif
 
-	dst = save_cram (&len);
-	if (bufcheck (st, p, len))
-		goto retry;
-	save_u32_func (&p, len);
-	memcpy (p, dst, len);
-	tlen += len + 4;
-	p += len;
-	dst = save_bram (&len);
-	if (bufcheck (st, p, len))
-		goto retry;
-	save_u32_func (&p, len);
-	memcpy (p, dst, len);
-	tlen += len + 4;
-	p += len;
-#ifdef AUTOCONFIG
-	dst = save_fram (&len, 0);
-	if (bufcheck (st, p, len))
-		goto retry;
-	save_u32_func (&p, len);
-	memcpy (p, dst, len);
-	tlen += len + 4;
-	p += len;
-	dst = save_zram (&len, 0);
-	if (bufcheck (st, p, len))
-		goto retry;
-	save_u32_func (&p, len);
-	memcpy (p, dst, len);
-	tlen += len + 4;
-	p += len;
-#endif
 #ifdef ACTION_REPLAY
 	if (bufcheck (st, p, 0))
-		goto retry;
+		return NULL;
 	p3 = p;
 	save_u32_func (&p, 0);
 	tlen += 4;
@@ -1892,7 +2218,7 @@ retry2:
 		p += len;
 	}
 	if (bufcheck (st, p, 0))
-		goto retry;
+		return NULL;
 	p3 = p;
 	save_u32_func (&p, 0);
 	tlen += 4;
@@ -1904,7 +2230,7 @@ retry2:
 #endif
 #ifdef CD32
 	if (bufcheck (st, p, 0))
-		goto retry;
+		return NULL;
 	p3 = p;
 	save_u32_func (&p, 0);
 	tlen += 4;
@@ -1916,7 +2242,7 @@ retry2:
 #endif
 #ifdef CDTV
 	if (bufcheck (st, p, 0))
-		goto retry;
+		return NULL;
 	p3 = p;
 	save_u32_func (&p, 0);
 	tlen += 4;
@@ -1926,7 +2252,7 @@ retry2:
 		p += len;
 	}
 	if (bufcheck (st, p, 0))
-		goto retry;
+		return NULL;
 	p3 = p;
 	save_u32_func (&p, 0);
 	tlen += 4;
@@ -1938,7 +2264,7 @@ retry2:
 #endif
 #if 0
 	if (bufcheck (st, p, 0))
-		goto retry;
+		return NULL;
 	p3 = p;
 	save_u32_func (&p, 0);
 	tlen += 4;
@@ -1948,7 +2274,7 @@ retry2:
 		p += len;
 	}
 	if (bufcheck (st, p, 0))
-		goto retry;
+		return NULL;
 	p3 = p;
 	save_u32_func (&p, 0);
 	tlen += 4;
@@ -1959,7 +2285,7 @@ retry2:
 	}
 #endif
 	if (bufcheck (st, p, 0))
-		goto retry;
+		return NULL;
 	p3 = p;
 	save_u32_func (&p, 0);
 	tlen += 4;
@@ -1970,7 +2296,7 @@ retry2:
 	}
 	for (i = 0; i < 4; i++) {
 		if (bufcheck (st, p, 0))
-			goto retry;
+			return NULL;
 		p3 = p;
 		save_u32_func (&p, 0);
 		tlen += 4;
@@ -1981,6 +2307,74 @@ retry2:
 		}
 	}
 	save_u32_func (&p, tlen);
+	return p;
+}
+
+void savestate_capture (int force)
+{
+	uae_u8 *p;
+	int i, retrycnt;
+	struct staterecord *st, *prev;
+	bool firstcapture = false;
+
+#ifdef FILESYS
+	if (nr_units ())
+		return;
+#endif
+	if (!staterecords)
+		return;
+	if (!input_record)
+		return;
+	if (currprefs.statecapturerate && hsync_counter == 0 && input_record == INPREC_RECORD_START && savestate_first_capture > 0) {
+		// first capture
+		force = true;
+		firstcapture = true;
+	} else if (savestate_first_capture < 0) {
+		force = true;
+		firstcapture = false;
+	}
+	if (!force) {
+		if (currprefs.statecapturerate <= 0)
+			return;
+		if (hsync_counter % currprefs.statecapturerate)
+			return;
+	}
+	savestate_first_capture = false;
+
+	retrycnt = 0;
+retry2:
+	st = staterecords[replaycounter];
+	if (st == NULL) {
+		st = (struct staterecord*)xmalloc (uae_u8, statefile_alloc);
+		st->len = statefile_alloc;
+		st->undo = NULL;
+		st->undoalloc = 0;
+	} else if (retrycnt > 0) {
+		write_log (_T("realloc %d -> %d\n"), st->len, st->len + STATEFILE_ALLOC_SIZE);
+		st->len += STATEFILE_ALLOC_SIZE;
+		st = (struct staterecord*)xrealloc (uae_u8, st, st->len);
+	}
+	if (st->len > statefile_alloc)
+		statefile_alloc = st->len;
+	st->inuse = 0;
+	st->undolen = 0;
+	st->data = (uae_u8*)(st + 1);
+	staterecords[replaycounter] = st;
+	retrycnt++;
+	p = save_state_record (st);
+	if (!p)
+		goto retry;
+
+	// RAM goes to the rewind store, previous record receives the undo pages
+	prev = canrewind (replaycounter - 1);
+	if (rewind_changed (&rewind_store) || !rewind_capture (&rewind_store, prev)) {
+		rewind_drop_history ();
+		if (!rewind_keyframe (&rewind_store)) {
+			write_log (_T("can't save, out of memory for rewind keyframe\n"));
+			return;
+		}
+	}
+
 	st->end = p;
 	st->inuse = 1;
 	st->inprecoffset = inprec_getposition ();
@@ -2027,8 +2421,29 @@ retry:
 
 void savestate_free (void)
 {
+	savestate_writer_finish ();
+	if (staterecords) {
+		for (int i = 0; i < staterecords_max; i++) {
+			if (staterecords[i]) {
+				xfree (staterecords[i]->undo);
+				xfree (staterecords[i]);
+			}
+		}
+	}
 	xfree (staterecords);
 	staterecords = NULL;
+	rewind_free (&rewind_store);
+	for (int i = 0; i < ROLLBACK_SNAPSHOTS; i++) {
+		if (rollback_records[i]) {
+			xfree (rollback_records[i]->undo);
+			xfree (rollback_records[i]);
+			rollback_records[i] = NULL;
+		}
+	}
+	rollback_newest = -1;
+	rollback_capture_frame = -1;
+	rollback_restore_frame = -1;
+	rewind_free (&rollback_store);
 }
 
 void savestate_capture_request (void)
@@ -2036,6 +2451,140 @@ void savestate_capture_request (void)
 	savestate_first_capture = -1;
 }
 
+/* Netplay rollback snapshots, see rollback_records */
+
+static struct staterecord *rollback_record (int frame)
+{
+	if (frame < 0)
+		return NULL;
+	int slot = frame % ROLLBACK_SNAPSHOTS;
+	struct staterecord *st = rollback_records[slot];
+	if (!st || !st->inuse || rollback_record_frames[slot] != frame)
+		return NULL;
+	return st;
+}
+
+static void rollback_drop_history (void)
+{
+	for (int i = 0; i < ROLLBACK_SNAPSHOTS; i++) {
+		struct staterecord *st = rollback_records[i];
+		if (!st)
+			continue;
+		st->inuse = 0;
+		st->undolen = 0;
+	}
+	rollback_newest = -1;
+}
+
+int savestate_rollback_max_frames (void)
+{
+	return ROLLBACK_SNAPSHOTS - 1;
+}
+
+/* Snapshot at the next frame start (savestate_check) as frame */
+void savestate_rollback_capture_request (int frame)
+{
+	rollback_capture_frame = frame;
+}
+
+/* Return to the start of frame at the next frame start. Fails if any
+   snapshot from frame to the newest one is missing. */
+bool savestate_rollback_restore_request (int frame)
+{
+	if (frame < 0 || frame > rollback_newest || rollback_newest - frame >= ROLLBACK_SNAPSHOTS)
+		return false;
+	for (int f = frame; f <= rollback_newest; f++) {
+		if (!rollback_record (f))
+			return false;
+	}
+	rollback_restore_frame = frame;
+	rollback_capture_frame = -1;
+	return true;
+}
+
+static void savestate_rollback_capture (void)
+{
+	int frame = rollback_capture_frame;
+	rollback_capture_frame = -1;
+	if (frame < 0)
+		return;
+#ifdef FILESYS
+	if (nr_units ())
+		return;
+#endif
+	// snapshots must be consecutive, undo pages link each to the next
+	if (rollback_newest >= 0 && frame != rollback_newest + 1)
+		rollback_drop_history ();
+
+	int slot = frame % ROLLBACK_SNAPSHOTS;
+	struct staterecord *st = rollback_records[slot];
+	uae_u8 *p = NULL;
+	for (int retrycnt = 0; retrycnt < 10 && !p; retrycnt++) {
+		if (st == NULL) {
+			st = (struct staterecord*)xmalloc (uae_u8, STATEFILE_ALLOC_SIZE);
+			if (!st)
+				break;
+			st->len = STATEFILE_ALLOC_SIZE;
+			st->undo = NULL;
+			st->undoalloc = 0;
+		} else if (retrycnt > 0) {
+			st->len += STATEFILE_ALLOC_SIZE;
+			st = (struct staterecord*)xrealloc (uae_u8, st, st->len);
+			if (!st)
+				break;
+		}
+		st->inuse = 0;
+		st->undolen = 0;
+		st->data = (uae_u8*)(st + 1);
+		rollback_records[slot] = st;
+		p = save_state_record (st);
+	}
+	if (!p) {
+		write_log (_T("rollback: can't capture frame %d\n"), frame);
+		rollback_records[slot] = st;
+		rollback_drop_history ();
+		return;
+	}
+
+	struct staterecord *prev = rollback_record (frame - 1);
+	if (rewind_changed (&rollback_store) || !rewind_capture (&rollback_store, prev)) {
+		rollback_drop_history ();
+		if (!rewind_keyframe (&rollback_store)) {
+			write_log (_T("rollback: out of memory for keyframe\n"));
+			return;
+		}
+	}
+	st->end = p;
+	st->inuse = 1;
+	rollback_record_frames[slot] = frame;
+	rollback_newest = frame;
+}
+
+void savestate_rollback_restore (void)
+{
+	int frame = rollback_restore_frame;
+	rollback_restore_frame = -1;
+	struct staterecord *st = rollback_record (frame);
+	if (!st || rewind_changed (&rollback_store)) {
+		write_log (_T("rollback: can't restore frame %d\n"), frame);
+		rollback_drop_history ();
+		return;
+	}
+	uae_u8 *p = restore_state_record (st->data);
+	rewind_revert (&rollback_store);
+	for (int f = rollback_newest - 1; f >= frame; f--)
+		rewind_undo (&rollback_store, rollback_record (f));
+	for (int f = frame + 1; f <= rollback_newest; f++)
+		rollback_record (f)->inuse = 0;
+	rollback_newest = frame;
+	if (p != st->end) {
+		gui_message (_T("reload failure, address mismatch %p != %p"), p, st->end);
+		rollback_drop_history ();
+		uae_reset (0, 0);
+		return;
+	}
+}
+
 void savestate_init (void)
 {
 	savestate_free ();
@@ -1105,6 +1105,7 @@ void trap_put_bytes(TrapContext *ctx, const void *haddrp, uaecptr addr, int cnt)
 	} else {
 		if (real_address_allowed() && valid_address(addr, cnt)) {
 			memcpy(get_real_address(addr), haddr, cnt);
+			memory_dirty_mark_addr(addr, cnt);
 		} else {
 			for (int i = 0; i < cnt; i++) {
 				put_byte(addr, *haddr++);
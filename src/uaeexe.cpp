@@ -126,6 +126,7 @@ static uae_u32 REGPARAM2 uaeexe_server (TrapContext *ctx)
 
 	dst = (char*)get_real_address (ARG (0));
 	len = ARG (1);
+	memory_dirty_mark_addr (ARG (0), len);
 	s = ua (cmd);
 	strncpy (dst, s, len);
 	write_log (_T("Sending '%s' to remote cli\n"), cmd);
@@ -13,6 +13,7 @@
 #include "sysconfig.h"
 #include "sysdeps.h"
 
+#include "uae.h"
 #include "options.h"
 #include "zfile.h"
 #include "disk.h"
@@ -24,6 +25,7 @@
 #include "diskutil.h"
 #include "fdi2raw.h"
 #include "uae/io.h"
+#include "threaddep/thread.h"
 
 #include "archivers/zip/unzip.h"
 #include "archivers/dms/pfile.h"
@@ -38,9 +40,84 @@
 
 static struct zfile *zlist = 0;
 
+/* zfiles may be opened from the floppy prefetch thread. zlist_sem guards
+ * the open file list and unpack_sem serializes unpacking, since several
+ * decoders (DMS, archive plugins) keep global state. unpack_sem is
+ * recursive per thread because archive handlers can open nested files.
+ * The prefetch thread takes unpack_sem only for those decoders; gzip/xz
+ * run without it (see zfile_prefetch). The semaphores are created on
+ * first use, which always happens on the emulation thread before any
+ * worker thread is started. */
+static uae_sem_t zlist_sem, unpack_sem, zcache_sem;
+static bool zfile_sem_init;
+static uae_thread_id unpack_owner;
+static int unpack_depth;
+
+#ifdef A_7Z
+static void xz_init (void);
+#endif
+
+static void zfile_init_sem (void)
+{
+	if (zfile_sem_init)
+		return;
+	uae_sem_init (&zlist_sem, 0, 1);
+	uae_sem_init (&unpack_sem, 0, 1);
+	uae_sem_init (&zcache_sem, 0, 1);
+#ifdef A_7Z
+	xz_init ();
+#endif
+	zfile_sem_init = true;
+}
+
+static void zlist_lock (void)
+{
+	zfile_init_sem ();
+	uae_sem_wait (&zlist_sem);
+}
+
+static void zlist_unlock (void)
+{
+	uae_sem_post (&zlist_sem);
+}
+
+static void unpack_lock (void)
+{
+	uae_thread_id self = uae_thread_get_id ();
+	zfile_init_sem ();
+	if (unpack_depth > 0 && unpack_owner == self) {
+		unpack_depth++;
+		return;
+	}
+	uae_sem_wait (&unpack_sem);
+	unpack_owner = self;
+	unpack_depth = 1;
+}
+
+static bool unpack_held (void)
+{
+	return unpack_depth > 0 && unpack_owner == uae_thread_get_id ();
+}
+
+static void unpack_unlock (void)
+{
+	if (--unpack_depth > 0)
+		return;
+	unpack_owner = 0;
+	uae_sem_post (&unpack_sem);
+}
+
 const TCHAR *uae_archive_extensions[] = { _T("zip"), _T("rar"), _T("7z"), _T("lha"), _T("lzh"), _T("lzx"), _T("tar"), NULL };
 
-#define MAX_CACHE_ENTRIES 10
+/* Decoded image cache. Entries are keyed by (path, mtime, size, mask,
+ * index) and hold either a fully unpacked zfile image (archives, DMS, XZ,
+ * ...) or a set of decoded MFM tracks (FDI/IPF). Memory use is bounded
+ * by a byte budget with LRU eviction; evicted file images can optionally
+ * be spilled to disk and reloaded on the next hit. */
+
+#define ZCACHE_HASH_SIZE 64
+#define ZCACHE_MAX_ENTRIES 256
+#define ZCACHE_DEFAULT_BUDGET (64 * 1024 * 1024)
 
 struct zdisktrack
 {
@@ -55,32 +132,189 @@ struct zdiskimage
 struct zcache
 {
 	TCHAR *name;
+	uae_s64 mtime;
+	uae_s64 filesize;
+	int mask;
+	int index;
+	uae_u32 hash;
 	struct zdiskimage *zd;
-	void *data;
-	int size;
-	struct zcache *next;
-	time_t tm;
+	uae_u8 *data;
+	uae_s64 size;
+	TCHAR *resultname;
+	TCHAR *zipname;
+	TCHAR *originalname;
+	TCHAR *spillname;
+	uae_s64 bytes; // resident bytes accounted against the budget
+	int pinned;
+	struct zcache *hnext;
+	struct zcache *prev, *next; // LRU order, head is most recently used
 };
-static struct zcache *zcachedata;
 
-static struct zcache *cache_get (const TCHAR *name)
+static struct zcache *zcache_hash[ZCACHE_HASH_SIZE];
+static struct zcache *zcache_head, *zcache_tail;
+static int zcache_entries;
+static uae_s64 zcache_used;
+static uae_s64 zcache_budget = ZCACHE_DEFAULT_BUDGET;
+static TCHAR *zcache_spilldir;
+static int zcache_spillcnt;
+
+static struct {
+	int hits;
+	int misses;
+	int inserts;
+	int evictions;
+	int spills;
+	int reloads;
+	uae_s64 peak;
+} zcache_stats;
+
+/* Images the prefetch thread is decoding right now, guarded by zcache_sem.
+ * Other threads opening the same image wait for that decode to finish
+ * instead of starting a second one; unrelated opens are not affected. */
+struct zinflight
 {
-	struct zcache *zc = zcachedata;
-	while (zc) {
-		if (!_tcscmp (name, zc->name)) {
-			zc->tm = time (NULL);
-			return zc;
-		}
-		zc = zc->next;
+	TCHAR *name;
+	int mask;
+	int index;
+	struct zinflight *next;
+};
+static struct zinflight *zinflight_list;
+
+static void zcache_lock (void)
+{
+	zfile_init_sem ();
+	uae_sem_wait (&zcache_sem);
+}
+
+static void zcache_unlock (void)
+{
+	uae_sem_post (&zcache_sem);
+}
+
+static struct zinflight **zcache_inflight_find (const TCHAR *name, int mask, int index)
+{
+	struct zinflight **pp;
+	for (pp = &zinflight_list; *pp; pp = &(*pp)->next) {
+		struct zinflight *zi = *pp;
+		if (zi->mask == mask && zi->index == index && !_tcscmp (zi->name, name))
+			break;
 	}
-	return NULL;
+	return pp;
+}
+
+static bool zcache_inflight_begin (const TCHAR *name, int mask, int index)
+{
+	struct zinflight **pp;
+	bool ok = false;
+
+	zcache_lock ();
+	pp = zcache_inflight_find (name, mask, index);
+	if (!*pp) {
+		struct zinflight *zi = xcalloc (struct zinflight, 1);
+		zi->name = my_strdup (name);
+		zi->mask = mask;
+		zi->index = index;
+		*pp = zi;
+		ok = true;
+	}
+	zcache_unlock ();
+	return ok;
+}
+
+static void zcache_inflight_end (const TCHAR *name, int mask, int index)
+{
+	struct zinflight **pp, *zi;
+
+	zcache_lock ();
+	pp = zcache_inflight_find (name, mask, index);
+	zi = *pp;
+	if (zi) {
+		*pp = zi->next;
+		xfree (zi->name);
+		xfree (zi);
+	}
+	zcache_unlock ();
+}
+
+static void zcache_inflight_wait (const TCHAR *name, int mask, int index)
+{
+	for (;;) {
+		bool busy;
+		zcache_lock ();
+		busy = zinflight_list && *zcache_inflight_find (name, mask, index) != NULL;
+		zcache_unlock ();
+		if (!busy)
+			break;
+		sleep_millis (1);
+	}
+}
+
+static uae_u32 zcache_hashkey (const TCHAR *name, uae_s64 mtime, uae_s64 filesize, int mask, int index)
+{
+	uae_u32 h = 2166136261u;
+	while (*name) {
+		h ^= (uae_u32)*name++;
+		h *= 16777619u;
+	}
+	h ^= (uae_u32)mtime ^ (uae_u32)(mtime >> 32);
+	h *= 16777619u;
+	h ^= (uae_u32)filesize ^ (uae_u32)(filesize >> 32);
+	h *= 16777619u;
+	h ^= (uae_u32)mask;
+	h *= 16777619u;
+	h ^= (uae_u32)index;
+	h *= 16777619u;
+	return h;
+}
+
+/* Returns the modification time and size of the file backing name. For
+ * paths pointing inside an archive, the archive file itself is used. */
+static bool zcache_stat (const TCHAR *name, struct mystat *st)
+{
+	TCHAR tmp[MAX_DPATH];
+	int i;
+
+	if (my_stat (name, st))
+		return true;
+	_tcscpy (tmp, name);
+	for (i = _tcslen (tmp) - 1; i > 0; i--) {
+		if (tmp[i] != '/' && tmp[i] != '\\')
+			continue;
+		tmp[i] = 0;
+		if (my_stat (tmp, st))
+			return !(st->mode & FILEFLAG_DIR);
+	}
+	return false;
 }
 
-static void zcache_flush (void)
+static void zcache_unlink_lru (struct zcache *zc)
 {
+	if (zc->prev)
+		zc->prev->next = zc->next;
+	else
+		zcache_head = zc->next;
+	if (zc->next)
+		zc->next->prev = zc->prev;
+	else
+		zcache_tail = zc->prev;
+	zc->prev = zc->next = NULL;
+}
+
+static void zcache_touch (struct zcache *zc)
+{
+	if (zcache_head == zc)
+		return;
+	if (zc->prev || zc->next || zcache_tail == zc)
+		zcache_unlink_lru (zc);
+	zc->next = zcache_head;
+	if (zcache_head)
+		zcache_head->prev = zc;
+	zcache_head = zc;
+	if (!zcache_tail)
+		zcache_tail = zc;
 }
 
-static void zcache_free_data (struct zcache *zc)
+static void zcache_free_resident (struct zcache *zc)
 {
 	int i;
 	if (zc->zd) {
@@ -88,73 +322,264 @@ static void zcache_free_data (struct zcache *zc)
 			xfree (zc->zd->zdisktracks[i].data);
 		}
 		xfree (zc->zd);
+		zc->zd = NULL;
 	}
 	xfree (zc->data);
-	xfree (zc->name);
+	zc->data = NULL;
+	zcache_used -= zc->bytes;
+	zc->bytes = 0;
 }
 
 static void zcache_free (struct zcache *zc)
 {
-	struct zcache *pl = NULL;
-	struct zcache *l  = zcachedata;
-	struct zcache *nxt;
+	struct zcache **pp = &zcache_hash[zc->hash % ZCACHE_HASH_SIZE];
+	while (*pp && *pp != zc)
+		pp = &(*pp)->hnext;
+	if (*pp)
+		*pp = zc->hnext;
+	zcache_unlink_lru (zc);
+	zcache_free_resident (zc);
+	if (zc->spillname) {
+		_wunlink (zc->spillname);
+		xfree (zc->spillname);
+	}
+	xfree (zc->name);
+	xfree (zc->resultname);
+	xfree (zc->zipname);
+	xfree (zc->originalname);
+	xfree (zc);
+	zcache_entries--;
+}
+
+static bool zcache_spill (struct zcache *zc)
+{
+	TCHAR path[MAX_DPATH];
+	FILE *f;
+	bool ok;
 
-	while (l != zc) {
-		if (l == 0)
-			return;
-		pl = l;
-		l = l->next;
+	if (!zcache_spilldir || !zc->data)
+		return false;
+	if (!zc->spillname) {
+		_stprintf (path, _T("%s/zcache-%08x-%d.bin"), zcache_spilldir, zc->hash, zcache_spillcnt++);
+		f = uae_tfopen (path, _T("wb"));
+		if (!f)
+			return false;
+		ok = fwrite (zc->data, 1, zc->size, f) == (size_t) zc->size;
+		fclose (f);
+		if (!ok) {
+			_wunlink (path);
+			return false;
+		}
+		zc->spillname = my_strdup (path);
 	}
-	if (l)
-		nxt = l->next;
-	zcache_free_data (zc);
-	if (l == 0)
-		return;
-	if(!pl)
-		zcachedata = nxt;
-	else
-		pl->next = nxt;
+	xfree (zc->data);
+	zc->data = NULL;
+	zcache_used -= zc->bytes;
+	zc->bytes = 0;
+	zcache_stats.spills++;
+	return true;
 }
 
-static void zcache_close (void)
+/* Makes room for need bytes by evicting (or spilling) from the LRU tail. */
+static void zcache_evict (uae_s64 need)
 {
-	struct zcache *zc = zcachedata;
-	while (zc) {
-		struct zcache *n = zc->next;
-		zcache_free_data (zc);
-		xfree (n);
-		zc = n;
+	struct zcache *zc = zcache_tail;
+	while (zc && (zcache_used + need > zcache_budget || zcache_entries > ZCACHE_MAX_ENTRIES)) {
+		struct zcache *prev = zc->prev;
+		if (!zc->pinned) {
+			if (zcache_entries > ZCACHE_MAX_ENTRIES) {
+				zcache_free (zc);
+				zcache_stats.evictions++;
+			} else if (zc->bytes > 0) {
+				if (!zcache_spill (zc)) {
+					zcache_free (zc);
+				}
+				zcache_stats.evictions++;
+			}
+		}
+		zc = prev;
 	}
 }
 
-static void zcache_check (void)
+static struct zcache *zcache_find (const TCHAR *name, uae_s64 mtime, uae_s64 filesize, int mask, int index)
 {
-	int cnt = 0;
-	struct zcache *zc = zcachedata, *last = NULL;
+	uae_u32 hash = zcache_hashkey (name, mtime, filesize, mask, index);
+	struct zcache *zc = zcache_hash[hash % ZCACHE_HASH_SIZE];
 	while (zc) {
-		last = zc;
-		zc = zc->next;
-		cnt++;
+		if (zc->hash == hash && zc->mtime == mtime && zc->filesize == filesize &&
+			zc->mask == mask && zc->index == index && !_tcscmp (zc->name, name))
+			return zc;
+		zc = zc->hnext;
+	}
+	return NULL;
+}
+
+static bool zcache_reload (struct zcache *zc)
+{
+	FILE *f;
+	bool ok;
+
+	if (zc->data || zc->zd)
+		return true;
+	if (!zc->spillname)
+		return false;
+	zc->pinned++;
+	zcache_evict (zc->size);
+	zc->pinned--;
+	f = uae_tfopen (zc->spillname, _T("rb"));
+	if (!f)
+		return false;
+	zc->data = xmalloc (uae_u8, zc->size);
+	ok = fread (zc->data, 1, zc->size, f) == (size_t) zc->size;
+	fclose (f);
+	if (!ok) {
+		xfree (zc->data);
+		zc->data = NULL;
+		return false;
 	}
-	write_log (_T("CACHE: %d\n"), cnt);
-	if (cnt >= MAX_CACHE_ENTRIES && last)
-		zcache_free (last);
+	zc->bytes = zc->size;
+	zcache_used += zc->bytes;
+	if (zcache_used > zcache_stats.peak)
+		zcache_stats.peak = zcache_used;
+	zcache_stats.reloads++;
+	return true;
 }
 
-static struct zcache *zcache_put (const TCHAR *name, struct zdiskimage *data)
+static struct zcache *zcache_insert (const TCHAR *name, uae_s64 mtime, uae_s64 filesize, int mask, int index, uae_s64 bytes)
 {
 	struct zcache *zc;
-	
-	zcache_check ();
+	uae_u32 hash;
+
+	zc = zcache_find (name, mtime, filesize, mask, index);
+	if (zc && !zc->pinned)
+		zcache_free (zc);
+	zcache_evict (bytes);
+	hash = zcache_hashkey (name, mtime, filesize, mask, index);
 	zc = xcalloc (struct zcache, 1);
-	zc->next = zcachedata;
-	zcachedata = zc;
-	zc->zd = data;
 	zc->name = my_strdup (name);
-	zc->tm = time (NULL);
+	zc->mtime = mtime;
+	zc->filesize = filesize;
+	zc->mask = mask;
+	zc->index = index;
+	zc->hash = hash;
+	zc->bytes = bytes;
+	zc->hnext = zcache_hash[hash % ZCACHE_HASH_SIZE];
+	zcache_hash[hash % ZCACHE_HASH_SIZE] = zc;
+	zcache_touch (zc);
+	zcache_entries++;
+	zcache_used += bytes;
+	if (zcache_used > zcache_stats.peak)
+		zcache_stats.peak = zcache_used;
+	zcache_stats.inserts++;
 	return zc;
 }
 
+static void zcache_image_key (struct zfile *z, struct mystat *st)
+{
+	if (!zcache_stat (z->name, st)) {
+		st->mtime.tv_sec = 0;
+		st->size = zfile_size (z);
+	}
+}
+
+/* Returns cached decoded tracks for z, pinned until zcache_release. */
+static struct zcache *zcache_get_image (struct zfile *z)
+{
+	struct zcache *zc;
+	struct mystat st;
+
+	if (zcache_budget <= 0)
+		return NULL;
+	zcache_image_key (z, &st);
+	zcache_lock ();
+	zc = zcache_find (z->name, st.mtime.tv_sec, st.size, 0, -1);
+	if (zc && zc->zd) {
+		zcache_touch (zc);
+		zc->pinned++;
+		zcache_stats.hits++;
+	} else {
+		zc = NULL;
+		zcache_stats.misses++;
+	}
+	zcache_unlock ();
+	return zc;
+}
+
+/* Stores decoded tracks for z. The returned entry is pinned; when the
+ * cache is disabled or the image exceeds the budget, a private entry is
+ * returned and freed by zcache_release instead. */
+static struct zcache *zcache_put_image (struct zfile *z, struct zdiskimage *zd)
+{
+	struct zcache *zc;
+	struct mystat st;
+	uae_s64 bytes = sizeof (struct zdiskimage);
+	int i;
+
+	for (i = 0; i < zd->tracks; i++)
+		bytes += zd->zdisktracks[i].len;
+	if (bytes > zcache_budget / 4) {
+		zc = xcalloc (struct zcache, 1);
+		zc->zd = zd;
+		zc->pinned = -1;
+		return zc;
+	}
+	zcache_image_key (z, &st);
+	zcache_lock ();
+	zc = zcache_insert (z->name, st.mtime.tv_sec, st.size, 0, -1, bytes);
+	zc->zd = zd;
+	zc->pinned++;
+	zcache_unlock ();
+	return zc;
+}
+
+static void zcache_release (struct zcache *zc)
+{
+	if (zc->pinned < 0) {
+		zcache_free_resident (zc);
+		xfree (zc);
+		return;
+	}
+	zcache_lock ();
+	zc->pinned--;
+	zcache_evict (0);
+	zcache_unlock ();
+}
+
+void zfile_cache_configure (uae_s64 budget, const TCHAR *spilldir)
+{
+	zcache_lock ();
+	zcache_budget = budget;
+	xfree (zcache_spilldir);
+	zcache_spilldir = NULL;
+	if (spilldir && spilldir[0]) {
+		if (!my_existsdir (spilldir))
+			my_mkdir (spilldir);
+		zcache_spilldir = my_strdup (spilldir);
+	}
+	zcache_evict (0);
+	zcache_unlock ();
+	write_log (_T("ZCACHE: budget %lld bytes, spill %s\n"), (long long) budget,
+		zcache_spilldir ? zcache_spilldir : _T("disabled"));
+}
+
+bool zfile_cache_enabled (void)
+{
+	return zcache_budget > 0;
+}
+
+static void zcache_close (void)
+{
+	if (!zfile_sem_init)
+		return;
+	zcache_lock ();
+	write_log (_T("ZCACHE: %d hits, %d misses, %d inserts, %d evictions, %d spills, %d reloads, peak %lld bytes\n"),
+		zcache_stats.hits, zcache_stats.misses, zcache_stats.inserts, zcache_stats.evictions,
+		zcache_stats.spills, zcache_stats.reloads, (long long) zcache_stats.peak);
+	while (zcache_head)
+		zcache_free (zcache_head);
+	zcache_unlock ();
+}
+
 static void checkarchiveparent (struct zfile *z)
 {
 	// unpack completely if opened in PEEK mode
@@ -170,8 +595,10 @@ static struct zfile *zfile_create (struct zfile *prev, const TCHAR *originalname
 	if (!z)
 		return 0;
 	memset (z, 0, sizeof *z);
+	zlist_lock ();
 	z->next = zlist;
 	zlist = z;
+	zlist_unlock ();
 	z->opencnt = 1;
 	if (prev && prev->originalname)
 		z->originalname = my_strdup(prev->originalname);
@@ -202,6 +629,7 @@ static void zfile_free (struct zfile *f)
 void zfile_exit (void)
 {
 	struct zfile *l;
+	zcache_close ();
 	while ((l = zlist)) {
 		zlist = l->next;
 		zfile_free (l);
@@ -231,25 +659,24 @@ void zfile_fclose (struct zfile *f)
 		f->archiveparent = NULL;
 	}
 	struct zfile *pl = NULL;
-	struct zfile *nxt;
-	struct zfile *l  = zlist;
+	struct zfile *l;
+	zlist_lock ();
+	l = zlist;
 	while (l != f) {
 		if (l == 0) {
+			zlist_unlock ();
 			write_log (_T("zfile: tried to free already freed or nonexisting filehandle!\n"));
 			return;
 		}
 		pl = l;
 		l = l->next;
 	}
-	if (l)
-		nxt = l->next;
-	zfile_free (f);
-	if (l == 0)
-		return;
 	if(!pl)
-		zlist = nxt;
+		zlist = l->next;
 	else
-		pl->next = nxt;
+		pl->next = l->next;
+	zlist_unlock ();
+	zfile_free (f);
 }
 
 static void removeext (TCHAR *s, const TCHAR *ext)
@@ -789,7 +1216,7 @@ static struct zfile *fdi (struct zfile *z, int index, int *retcode)
 	if (index > 2)
 		return NULL;
 
-	zc = cache_get (z->name);
+	zc = zcache_get_image (z);
 	if (!zc) {
 		uae_u16 *mfm;
 		struct zdiskimage *zd;
@@ -814,7 +1241,7 @@ static struct zfile *fdi (struct zfile *z, int index, int *retcode)
 			zd->zdisktracks[i].len = len;
 		}
 		fdi2raw_header_free (fdi);
-		zc = zcache_put (z->name, zd);
+		zc = zcache_put_image (z, zd);
 	}
 
 	amigamfmbuffer = xcalloc (uae_u16, 32000 / 2);
@@ -883,6 +1310,7 @@ static struct zfile *fdi (struct zfile *z, int index, int *retcode)
 				zfile_fwrite (outbuf, 1, maxlen - len, zo);
 		}
 	}
+	zcache_release (zc);
 	zfile_fclose (z);
 	xfree (amigamfmbuffer);
 	xfree (outbuf);
@@ -890,6 +1318,7 @@ static struct zfile *fdi (struct zfile *z, int index, int *retcode)
 		truncate880k (zo);
 	return zo;
 end:
+	zcache_release (zc);
 	zfile_fclose (zo);
 	xfree (amigamfmbuffer);
 	xfree (outbuf);
@@ -924,7 +1353,7 @@ static struct zfile *ipf (struct zfile *z, int index, int *retcode)
 	if (index > 2)
 		return NULL;
 
-	zc = cache_get (z->name);
+	zc = zcache_get_image (z);
 	if (!zc) {
 		uae_u16 *mfm;
 		struct zdiskimage *zd;
@@ -949,7 +1378,7 @@ static struct zfile *ipf (struct zfile *z, int index, int *retcode)
 			zd->zdisktracks[i].len = len;
 		}
 		caps_unloadimage (0);
-		zc = zcache_put (z->name, zd);
+		zc = zcache_put_image (z, zd);
 	}
 
 	outbuf = xcalloc (uae_u8, 16384);
@@ -1023,6 +1452,7 @@ static struct zfile *ipf (struct zfile *z, int index, int *retcode)
 				zfile_fwrite (outbuf, 1, maxlen - len, zo);
 		}
 	}
+	zcache_release (zc);
 	zfile_fclose (z);
 	xfree (amigamfmbuffer);
 	xfree (outbuf);
@@ -1030,6 +1460,7 @@ static struct zfile *ipf (struct zfile *z, int index, int *retcode)
 		truncate880k (zo);
 	return zo;
 end:
+	zcache_release (zc);
 	zfile_fclose (zo);
 	xfree (amigamfmbuffer);
 	xfree (outbuf);
@@ -1156,11 +1587,15 @@ static void SzFree(void *p, void *address)
 {
 	xfree (address);
 }
+
+static void xz_init (void)
+{
+	CrcGenerateTable ();
+}
 #define XZ_OUT_SIZE 10000
 #define XZ_IN_SIZE 10000
 static struct zfile *xz (struct zfile *z, int *retcode)
 {
-	static bool iscrc;
 	ISzAlloc allocImp;
 	CXzUnpacker cx;
 	ECoderStatus status;
@@ -1172,9 +1607,6 @@ static struct zfile *xz (struct zfile *z, int *retcode)
 	memset (&cx, 0, sizeof cx);
 	allocImp.Alloc = SzAlloc;
 	allocImp.Free = SzFree;
-	if (!iscrc)
-		CrcGenerateTable ();
-	iscrc = true;
 //	if (XzUnpacker_Create (&cx, &allocImp) != SZ_OK)
 //		return NULL;
 	XzUnpacker_Construct (&cx, &allocImp);
@@ -1587,6 +2019,77 @@ struct zfile *zuncompress (struct znode *parent, struct zfile *z, int dodefault,
 	return NULL;
 }
 
+/* Classifies what zuncompress would do with z: 1 if only the gzip or xz
+ * decoder is involved, -1 if a decoder with global state (DMS, archives,
+ * raw disk formats) is needed, 0 if the file is used as it is. */
+static int zfile_unpack_kind (struct zfile *z, int mask)
+{
+	TCHAR *ext = z->name ? _tcsrchr (z->name, '.') : NULL;
+	uae_u8 header[32];
+
+	if (ext) {
+		ext++;
+		if (mask & ZFD_ARCHIVE) {
+			for (int i = 0; uae_archive_extensions[i]; i++) {
+				if (!strcasecmp (ext, uae_archive_extensions[i]))
+					return -1;
+			}
+		}
+		if (mask & ZFD_UNPACK) {
+			if (!strcasecmp (ext, _T("gz")) || !strcasecmp (ext, _T("adz")) ||
+				!strcasecmp (ext, _T("roz")) || !strcasecmp (ext, _T("hdz")))
+				return 1;
+#ifdef A_7Z
+			if (!strcasecmp (ext, _T("xz")))
+				return 1;
+#endif
+			if (!strcasecmp (ext, _T("dms")) || !strcasecmp (ext, _T("wrp")) || !strcasecmp (ext, _T("dsq")))
+				return -1;
+		}
+		if (mask & ZFD_RAWDISK) {
+			if (!strcasecmp (ext, _T("ipf")) || !strcasecmp (ext, _T("fdi")))
+				return -1;
+		}
+#if defined(ARCHIVEACCESS)
+		for (int i = 0; plugins_7z_x[i]; i++) {
+			if ((plugins_7z_t[i] & mask) && !strcasecmp (ext, plugins_7z[i]))
+				return -1;
+		}
+#endif
+	}
+	memset (header, 0, sizeof (header));
+	zfile_fseek (z, 0, SEEK_SET);
+	zfile_fread (header, sizeof (header), 1, z);
+	zfile_fseek (z, 0, SEEK_SET);
+	if (!memcmp (header, "conectix", 8))
+		return -1;
+	if (mask & ZFD_UNPACK) {
+		if (header[0] == 0x1f && header[1] == 0x8b)
+			return 1;
+#ifdef A_7Z
+		if (header[0] == 0xfd && header[1] == 0x37 && header[2] == 0x7a && header[3] == 0x58 && header[4] == 0x5a && header[5] == 0)
+			return 1;
+#endif
+		if (!memcmp (header, "DMS!", 4) || !memcmp (header, "PKD", 3))
+			return -1;
+	}
+	if (mask & ZFD_RAWDISK) {
+		if (!memcmp (header, "CAPS", 4) || !memcmp (header, "Formatte", 8) || !memcmp (header, "UAE-1ADF", 8))
+			return -1;
+	}
+	if (mask & ZFD_ARCHIVE) {
+		if ((header[0] == 'P' && header[1] == 'K') || !memcmp (header, "Rar!", 4) || !memcmp (header, "LZX", 3))
+			return -1;
+		if (header[2] == '-' && header[3] == 'l' && header[4] == 'h' && header[6] == '-')
+			return -1;
+	}
+	if (mask & ZFD_ADF) {
+		if (!memcmp (header, "DOS", 3) || !memcmp (header, "SFS", 3) || isfat (header))
+			return -1;
+	}
+	return 0;
+}
+
 
 #ifdef SINGLEFILE
 extern uae_u8 singlefile_data[];
@@ -1761,6 +2264,86 @@ int zfile_zopen (const TCHAR *name, zfile_callback zc, void *user)
 	return 1;
 }
 
+/* Returns a new in-memory zfile with the cached result of unpacking
+ * path with the given mask and index, or NULL on a cache miss. The disk
+ * history flag only controls side effects and is not part of the key. */
+static struct zfile *zcache_open (const TCHAR *path, int mask, int index, bool countmiss)
+{
+	struct zcache *zc;
+	struct zfile *l = NULL;
+	struct mystat st;
+
+	if (zcache_budget <= 0 || !zcache_stat (path, &st))
+		return NULL;
+	zcache_lock ();
+	zc = zcache_find (path, st.mtime.tv_sec, st.size, mask & ~ZFD_DISKHISTORY, index);
+	if (zc && !zc->zd && zcache_reload (zc)) {
+		zcache_touch (zc);
+		l = zfile_create (NULL, zc->originalname);
+		l->name = my_strdup (zc->resultname);
+		if (zc->zipname)
+			l->zipname = my_strdup (zc->zipname);
+		l->zfdmask = mask;
+		l->data = xmalloc (uae_u8, zc->size);
+		memcpy (l->data, zc->data, zc->size);
+		l->size = zc->size;
+		l->datasize = zc->size;
+		l->allocsize = zc->size;
+		zcache_stats.hits++;
+	} else {
+		if (zc && !zc->zd)
+			zcache_free (zc);
+		if (countmiss)
+			zcache_stats.misses++;
+	}
+	zcache_unlock ();
+	return l;
+}
+
+/* True if opening path needed a decoder last time. Decoders refuse write
+ * access (checkwrite), so such an image can only be opened read-only. */
+static bool zcache_decoded (const TCHAR *path, int mask, int index)
+{
+	struct zcache *zc;
+	struct mystat st;
+	bool found;
+
+	if (zcache_budget <= 0 || !zcache_stat (path, &st))
+		return false;
+	zcache_lock ();
+	zc = zcache_find (path, st.mtime.tv_sec, st.size, mask & ~ZFD_DISKHISTORY, index);
+	found = zc && !zc->zd;
+	zcache_unlock ();
+	return found;
+}
+
+/* Remembers the fully unpacked zfile l as the result of opening path. */
+static void zcache_store (const TCHAR *path, int mask, int index, struct zfile *l)
+{
+	struct zcache *zc;
+	struct mystat st;
+
+	if (zcache_budget <= 0)
+		return;
+	if (!l->data || l->f || l->archiveparent || l->useparent || l->zfileread)
+		return;
+	if (l->size <= 0 || l->datasize != l->size || l->size > zcache_budget / 4)
+		return;
+	if (!zcache_stat (path, &st))
+		return;
+	zcache_lock ();
+	zc = zcache_insert (path, st.mtime.tv_sec, st.size, mask & ~ZFD_DISKHISTORY, index, l->size);
+	zc->data = xmalloc (uae_u8, l->size);
+	memcpy (zc->data, l->data, l->size);
+	zc->size = l->size;
+	zc->resultname = my_strdup (l->name ? l->name : _T(""));
+	if (l->zipname)
+		zc->zipname = my_strdup (l->zipname);
+	if (l->originalname)
+		zc->originalname = my_strdup (l->originalname);
+	zcache_unlock ();
+}
+
 /*
 * fopen() for a compressed file
 */
@@ -1769,13 +2352,43 @@ static struct zfile *zfile_fopen_x (const TCHAR *name, const TCHAR *mode, int ma
 	int cnt = 10;
 	struct zfile *l, *l2;
 	TCHAR path[MAX_DPATH];
+	bool cacheable;
 
 	if (_tcslen (name) == 0)
 		return NULL;
 	manglefilename(name, path, sizeof(path) / sizeof(TCHAR));
+	cacheable = !(mask & ZFD_CHECKONLY);
+	if (cacheable) {
+		// the prefetch thread may need unpack_sem to finish, so a nested
+		// open that already holds it must not wait for the prefetch
+		if (!unpack_held ())
+			zcache_inflight_wait (path, mask & ~ZFD_DISKHISTORY, index);
+		if (writeneeded (mode)) {
+			// the decoder would fail with -1 anyway, let the caller fall
+			// back to read-only mode, which is served from the cache
+			if (zcache_decoded (path, mask, index))
+				return NULL;
+			cacheable = false;
+		} else {
+			l = zcache_open (path, mask, index, false);
+			if (l)
+				return l;
+		}
+	}
+	unpack_lock ();
+	if (cacheable) {
+		// another thread may have unpacked the same image meanwhile
+		l = zcache_open (path, mask, index, true);
+		if (l) {
+			unpack_unlock ();
+			return l;
+		}
+	}
 	l = zfile_fopen_2 (path, mode, mask);
-	if (!l)
+	if (!l) {
+		unpack_unlock ();
 		return 0;
+	}
 	l2 = NULL;
 	while (cnt-- > 0) {
 		int rc;
@@ -1784,6 +2397,7 @@ static struct zfile *zfile_fopen_x (const TCHAR *name, const TCHAR *mode, int ma
 		if (!l2) {
 			if (rc < 0) {
 				zfile_fclose (l);
+				unpack_unlock ();
 				return NULL;
 			}
 			zfile_fseek (l, 0, SEEK_SET);
@@ -1794,9 +2408,78 @@ static struct zfile *zfile_fopen_x (const TCHAR *name, const TCHAR *mode, int ma
 		}
 		l = l2;
 	}
+	// only results that had to be unpacked or decoded are worth caching
+	if (cacheable && cnt < 9)
+		zcache_store (path, mask, index, l);
+	unpack_unlock ();
 	return l;
 }
 
+/* Decodes name into the image cache from a background thread. gzip/xz
+ * images are decoded without unpack_sem, so the emulation thread is not
+ * held up by them; DMS, archives and other decoders with global state run
+ * under unpack_sem like a foreground open. Opens of the same image wait
+ * for the decode to finish (zcache_inflight_wait). Plain images are not
+ * cached, they are read once so that the insert comes from the OS file
+ * cache. */
+bool zfile_prefetch (const TCHAR *name, int mask)
+{
+	struct zfile *l, *l2;
+	TCHAR path[MAX_DPATH];
+	int cnt = 10;
+	bool locked = false;
+	bool ok = false;
+
+	if (zcache_budget <= 0 || _tcslen (name) == 0)
+		return false;
+	manglefilename (name, path, sizeof (path) / sizeof (TCHAR));
+	mask &= ~(ZFD_DISKHISTORY | ZFD_CHECKONLY);
+	if (zcache_decoded (path, mask, 0))
+		return true;
+	if (!zcache_inflight_begin (path, mask, 0))
+		return false;
+	l = zfile_fopen_2 (path, _T("rb"), mask);
+	while (l && cnt-- > 0) {
+		int kind = zfile_unpack_kind (l, mask);
+		int rc;
+		if (kind == 0)
+			break;
+		if (kind < 0 && !locked) {
+			unpack_lock ();
+			locked = true;
+		}
+		zfile_fseek (l, 0, SEEK_SET);
+		l2 = zuncompress (NULL, l, 0, mask, &rc, 0);
+		if (!l2) {
+			if (rc < 0) {
+				zfile_fclose (l);
+				l = NULL;
+			}
+			break;
+		}
+		if (l2->parent == l)
+			l->opencnt--;
+		l = l2;
+	}
+	if (l && cnt < 9) {
+		zcache_store (path, mask, 0, l);
+		ok = true;
+	}
+	if (locked)
+		unpack_unlock ();
+	zcache_inflight_end (path, mask, 0);
+	if (l && !ok) {
+		uae_u8 *buf = xmalloc (uae_u8, 65536);
+		zfile_fseek (l, 0, SEEK_SET);
+		while (zfile_fread (buf, 1, 65536, l) == 65536)
+			;
+		xfree (buf);
+		ok = true;
+	}
+	zfile_fclose (l);
+	return ok;
+}
+
 #ifdef _WIN32
 static int isinternetfile (const TCHAR *name)
 {
@@ -2458,14 +3141,14 @@ int zfile_zuncompress (void *dst, int dstsize, struct zfile *src, int srcsize)
 	return 0;
 }
 
-int zfile_zcompress (struct zfile *f, void *src, int size)
+int zfile_zcompress_level (struct zfile *f, void *src, int size, int level)
 {
 	int v;
 	z_stream zs;
 	uae_u8 outbuf[4096];
 
 	memset (&zs, 0, sizeof (zs));
-	if (deflateInit_ (&zs, Z_DEFAULT_COMPRESSION, ZLIB_VERSION, sizeof (z_stream)) != Z_OK)
+	if (deflateInit_ (&zs, level, ZLIB_VERSION, sizeof (z_stream)) != Z_OK)
 		return 0;
 	zs.next_in = (Bytef*)src;
 	zs.avail_in = size;
@@ -2481,6 +3164,11 @@ int zfile_zcompress (struct zfile *f, void *src, int size)
 	return zs.total_out;
 }
 
+int zfile_zcompress (struct zfile *f, void *src, int size)
+{
+	return zfile_zcompress_level (f, src, size, Z_DEFAULT_COMPRESSION);
+}
+
 TCHAR *zfile_getname (struct zfile *f)
 {
 	return f ? f->name : NULL;